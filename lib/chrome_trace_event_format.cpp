@@ -1,23 +1,32 @@
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <charconv>
 #include <chrono>
+#include <cmath>
 #include <cstddef> // IWYU pragma: keep
+#include <cstdint>
 #include <cxxtrace/chrome_trace_event_format.h>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/detail/iostream.h>
+#include <cxxtrace/detail/span_depth.h>
 #include <cxxtrace/detail/workarounds.h> // IWYU pragma: keep
+#include <cxxtrace/hardware_counters.h>
 #include <cxxtrace/sample.h>
 #include <cxxtrace/snapshot.h>
+#include <cxxtrace/span_argument.h>
 #include <cxxtrace/string.h>
 #include <cxxtrace/thread.h>
 #include <limits>
+#include <optional>
 #include <ostream>
 #include <string> // IWYU pragma: keep
 #include <string_view>
 #include <system_error>
 #include <type_traits>
-// IWYU pragma: no_include <vector>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
 namespace cxxtrace {
 chrome_trace_event_writer::chrome_trace_event_writer(
@@ -48,12 +57,102 @@ chrome_trace_event_writer::write_snapshot(const samples_snapshot& snapshot)
       *this->output << "\"}}";
     }
   }
+  // Enter samples of each thread's unfinished spans, innermost span last.
+  //
+  // A lossy storage might have discarded some enter or exit samples, so match
+  // enter and exit samples by depth: spans deeper than an exit sample were
+  // left open by discarded exit samples, and an exit sample has no enter
+  // sample if no open span has its depth.
+  auto open_spans = std::unordered_map<thread_id, std::vector<sample_ref>>{};
+  auto pop_open_spans_deeper_than = [](std::vector<sample_ref>& spans,
+                                       int depth) noexcept -> void {
+    while (!spans.empty() && spans.back().depth() > depth) {
+      spans.pop_back();
+    }
+  };
+  auto pop_open_span_at_depth =
+    [](std::vector<sample_ref>& spans,
+       int depth) noexcept -> std::optional<sample_ref> {
+    if (spans.empty() || spans.back().depth() != depth) {
+      return std::nullopt;
+    }
+    auto span = spans.back();
+    spans.pop_back();
+    return span;
+  };
   for (auto i = samples_snapshot::size_type{ 0 }; i < snapshot.size(); ++i) {
     if (should_output_comma) {
       *this->output << ',';
     }
     should_output_comma = true;
-    this->write_sample(snapshot.at(i));
+    auto sample = snapshot.at(i);
+    auto& thread_open_spans = open_spans[sample.thread_id()];
+    auto span_enter = std::optional<sample_ref>{};
+    switch (sample.kind()) {
+      case sample_kind::enter_span:
+        // Saturated depths don't distinguish nested spans from siblings.
+        if (sample.depth() < detail::max_recorded_span_depth) {
+          pop_open_spans_deeper_than(thread_open_spans, sample.depth() - 1);
+        }
+        thread_open_spans.emplace_back(sample);
+        break;
+      case sample_kind::exit_span:
+        pop_open_spans_deeper_than(thread_open_spans, sample.depth());
+        span_enter = pop_open_span_at_depth(thread_open_spans, sample.depth());
+        break;
+      case sample_kind::next_phase:
+        pop_open_spans_deeper_than(thread_open_spans, sample.depth());
+        if (auto phase_begin =
+              pop_open_span_at_depth(thread_open_spans, sample.depth())) {
+          this->write_phase_end(sample, *phase_begin);
+          *this->output << ',';
+        }
+        thread_open_spans.emplace_back(sample);
+        break;
+      case sample_kind::complete_span:
+      case sample_kind::instant:
+      case sample_kind::counter:
+      case sample_kind::async_begin:
+      case sample_kind::async_end:
+      case sample_kind::flow_start:
+      case sample_kind::flow_step:
+      case sample_kind::flow_end:
+        break;
+    }
+    this->write_sample(sample, span_enter ? &*span_enter : nullptr);
+  }
+  if (!snapshot.losses().empty()) {
+    // Discarded records are older than the kept samples from the same queue,
+    // so mark each loss at the oldest sample which might follow it.
+    auto first_timestamp = std::optional<time_point>{};
+    auto first_timestamp_by_thread =
+      std::unordered_map<thread_id, time_point>{};
+    for (auto i = samples_snapshot::size_type{ 0 }; i < snapshot.size(); ++i) {
+      auto sample = snapshot.at(i);
+      auto timestamp = sample.timestamp();
+      if (!first_timestamp || timestamp < *first_timestamp) {
+        first_timestamp = timestamp;
+      }
+      auto [it, inserted] =
+        first_timestamp_by_thread.try_emplace(sample.thread_id(), timestamp);
+      if (!inserted && timestamp < it->second) {
+        it->second = timestamp;
+      }
+    }
+    for (const auto& loss : snapshot.losses()) {
+      auto timestamp = first_timestamp;
+      if (loss.thread_id) {
+        auto it = first_timestamp_by_thread.find(*loss.thread_id);
+        timestamp = it == first_timestamp_by_thread.end()
+                      ? std::nullopt
+                      : std::optional<time_point>{ it->second };
+      }
+      if (should_output_comma) {
+        *this->output << ',';
+      }
+      should_output_comma = true;
+      this->write_loss(loss, timestamp);
+    }
   }
   *this->output << "]}";
 }
@@ -63,16 +162,42 @@ chrome_trace_event_writer::close() -> void
 {}
 
 auto
-chrome_trace_event_writer::write_sample(sample_ref sample) -> void
+chrome_trace_event_writer::write_sample(sample_ref sample,
+                                        const sample_ref* span_enter) -> void
 {
   *this->output << "{\"ph\": \"";
   switch (sample.kind()) {
     case sample_kind::enter_span:
+    case sample_kind::next_phase:
       *this->output << 'B';
       break;
     case sample_kind::exit_span:
       *this->output << 'E';
       break;
+    case sample_kind::complete_span:
+      *this->output << 'X';
+      break;
+    case sample_kind::instant:
+      *this->output << 'i';
+      break;
+    case sample_kind::counter:
+      *this->output << 'C';
+      break;
+    case sample_kind::async_begin:
+      *this->output << 'b';
+      break;
+    case sample_kind::async_end:
+      *this->output << 'e';
+      break;
+    case sample_kind::flow_start:
+      *this->output << 's';
+      break;
+    case sample_kind::flow_step:
+      *this->output << 't';
+      break;
+    case sample_kind::flow_end:
+      *this->output << 'f';
+      break;
   }
   *this->output << "\", \"cat\": \"";
   this->write_string_piece(sample.category());
@@ -81,19 +206,206 @@ chrome_trace_event_writer::write_sample(sample_ref sample) -> void
   *this->output << "\", \"tid\": ";
   this->write_number(sample.thread_id());
   *this->output << ", \"ts\": ";
-  auto timestamp_nanoseconds =
-    sample.timestamp().nanoseconds_since_reference().count();
-  assert(timestamp_nanoseconds >= 0);
-  this->write_number(timestamp_nanoseconds / 1000);
-  *this->output << ".";
-  this->output->width(3);
-  this->output->fill('0');
-  this->write_number(timestamp_nanoseconds % 1000);
+  this->write_microseconds(sample.timestamp().nanoseconds_since_reference());
+  if (auto thread_cpu_time = sample.thread_cpu_time()) {
+    *this->output << ", \"tts\": ";
+    this->write_microseconds(*thread_cpu_time);
+  }
+  auto end = std::optional<span_point>{};
+  if (auto end_timestamp = sample.end_timestamp()) {
+    end = span_point{ *end_timestamp,
+                      sample.end_counters(),
+                      sample.end_thread_cpu_time() };
+    *this->output << ", \"dur\": ";
+    this->write_microseconds(
+      std::max(end->timestamp.nanoseconds_since_reference() -
+                 sample.timestamp().nanoseconds_since_reference(),
+               std::chrono::nanoseconds::zero()));
+    auto thread_cpu_time = sample.thread_cpu_time();
+    if (thread_cpu_time && end->thread_cpu_time) {
+      *this->output << ", \"tdur\": ";
+      this->write_microseconds(
+        std::max(*end->thread_cpu_time - *thread_cpu_time,
+                 std::chrono::nanoseconds::zero()));
+    }
+  }
   // TODO(strager): Write a useful process ID.
   *this->output << ", \"pid\": 0";
+  if (auto event_id = sample.event_id()) {
+    *this->output << ", \"id\": ";
+    this->write_event_id(*event_id);
+  }
+  if (sample.kind() == sample_kind::instant) {
+    // Thread-scoped instant events are drawn on their thread's track.
+    *this->output << ", \"s\": \"t\"";
+  }
+  if (sample.kind() == sample_kind::flow_end) {
+    // Bind the flow to the enclosing span rather than the next span.
+    *this->output << ", \"bp\": \"e\"";
+  }
+  auto wrote_arg = false;
+  if (span_enter) {
+    this->write_span_args(
+      span_point::at(*span_enter), span_point::at(sample), wrote_arg);
+  }
+  if (end) {
+    this->write_span_args(span_point::at(sample), *end, wrote_arg);
+  }
+  this->write_sample_arguments(sample, wrote_arg);
+  if (wrote_arg) {
+    *this->output << "}";
+  }
+  *this->output << "}";
+}
+
+auto
+chrome_trace_event_writer::write_phase_end(sample_ref next_phase,
+                                           sample_ref phase_begin) -> void
+{
+  *this->output << "{\"ph\": \"E\", \"cat\": \"";
+  this->write_string_piece(phase_begin.category());
+  *this->output << "\", \"name\": \"";
+  this->write_string_piece(phase_begin.name());
+  *this->output << "\", \"tid\": ";
+  this->write_number(next_phase.thread_id());
+  *this->output << ", \"ts\": ";
+  this->write_microseconds(
+    next_phase.timestamp().nanoseconds_since_reference());
+  if (auto thread_cpu_time = next_phase.thread_cpu_time()) {
+    *this->output << ", \"tts\": ";
+    this->write_microseconds(*thread_cpu_time);
+  }
+  *this->output << ", \"pid\": 0";
+  auto wrote_arg = false;
+  this->write_span_args(
+    span_point::at(phase_begin), span_point::at(next_phase), wrote_arg);
+  if (wrote_arg) {
+    *this->output << "}";
+  }
   *this->output << "}";
 }
 
+auto
+chrome_trace_event_writer::write_loss(const sample_loss& loss,
+                                      std::optional<time_point> timestamp)
+  -> void
+{
+  *this->output << "{\"ph\": \"i\", \"cat\": \"cxxtrace\", \"name\": "
+                   "\"samples discarded\", \"tid\": ";
+  this->write_number(loss.thread_id.value_or(thread_id{ 0 }));
+  *this->output << ", \"ts\": ";
+  this->write_microseconds(timestamp
+                             ? timestamp->nanoseconds_since_reference()
+                             : std::chrono::nanoseconds::zero());
+  *this->output << ", \"pid\": 0, \"s\": \"" << (loss.thread_id ? 't' : 'g')
+                << '"';
+  auto wrote_arg = false;
+  this->write_arg_name("discarded_records", wrote_arg);
+  this->write_number(loss.discarded_record_count);
+  if (loss.processor_id) {
+    this->write_arg_name("processor_id", wrote_arg);
+    this->write_number(*loss.processor_id);
+  }
+  *this->output << "}}";
+}
+
+auto
+chrome_trace_event_writer::write_span_args(const span_point& enter,
+                                           const span_point& exit,
+                                           bool& wrote_arg) -> void
+{
+  if (enter.counters && exit.counters) {
+    auto deltas = *exit.counters - *enter.counters;
+    this->write_arg_name("cycles", wrote_arg);
+    this->write_number(deltas.cycles);
+    this->write_arg_name("instructions", wrote_arg);
+    this->write_number(deltas.instructions);
+    this->write_arg_name("llc_misses", wrote_arg);
+    this->write_number(deltas.llc_misses);
+  }
+
+  if (enter.thread_cpu_time && exit.thread_cpu_time) {
+    auto duration = exit.timestamp.nanoseconds_since_reference() -
+                    enter.timestamp.nanoseconds_since_reference();
+    auto on_cpu_time = *exit.thread_cpu_time - *enter.thread_cpu_time;
+    // The clocks might disagree slightly. Don't report negative times.
+    auto off_cpu_time =
+      std::max(duration - on_cpu_time, std::chrono::nanoseconds::zero());
+    this->write_arg_name("on_cpu_ns", wrote_arg);
+    this->write_number(on_cpu_time.count());
+    this->write_arg_name("off_cpu_ns", wrote_arg);
+    this->write_number(off_cpu_time.count());
+  }
+}
+
+auto
+chrome_trace_event_writer::write_sample_arguments(sample_ref sample,
+                                                  bool& wrote_arg) -> void
+{
+  for (const auto& argument : sample.arguments()) {
+    this->write_arg_name(argument.name, wrote_arg);
+    std::visit(
+      [this](const auto& value) -> void {
+        using value_type = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<value_type, std::string>) {
+          *this->output << '"';
+          this->write_string_piece(value.c_str());
+          *this->output << '"';
+        } else {
+          this->write_number(value);
+        }
+      },
+      argument.value);
+  }
+}
+
+auto
+chrome_trace_event_writer::write_arg_name(czstring name, bool& wrote_arg)
+  -> void
+{
+  *this->output << (wrote_arg ? ", \"" : ", \"args\": {\"");
+  wrote_arg = true;
+  this->write_string_piece(name);
+  *this->output << "\": ";
+}
+
+auto
+chrome_trace_event_writer::write_microseconds(std::chrono::nanoseconds time)
+  -> void
+{
+  auto nanoseconds = time.count();
+  assert(nanoseconds >= 0);
+  this->write_number(nanoseconds / 1000);
+  *this->output << ".";
+  this->output->width(3);
+  this->output->fill('0');
+  this->write_number(nanoseconds % 1000);
+}
+
+auto
+chrome_trace_event_writer::write_event_id(std::uint64_t id) -> void
+{
+  // Write IDs as strings, because trace viewers parse JSON numbers as doubles
+  // and would round large IDs.
+  auto buffer = std::array<char, 2 * sizeof(id)>{};
+  auto chars = zstring{ buffer.data() };
+  auto result = std::to_chars(chars, &chars[buffer.size()], id, 16);
+  assert(result.ec == std::errc{});
+  auto id_chars =
+    std::string_view{ chars, static_cast<std::size_t>(result.ptr - chars) };
+
+#if CXXTRACE_WORK_AROUND_LIBCXX_42166
+  {
+    auto non_zero_digit_index = id_chars.find_first_not_of('0');
+    if (non_zero_digit_index != id_chars.npos) {
+      id_chars.remove_prefix(non_zero_digit_index);
+    }
+  }
+#endif
+
+  *this->output << "\"0x" << id_chars << '"';
+}
+
 template<class T>
 auto
 chrome_trace_event_writer::write_number(T number)
@@ -121,6 +433,20 @@ chrome_trace_event_writer::write_number(T number)
   *this->output << number_chars;
 }
 
+auto
+chrome_trace_event_writer::write_number(double number) -> void
+{
+  if (!std::isfinite(number)) {
+    // JSON cannot represent infinities or NaNs.
+    *this->output << "null";
+    return;
+  }
+  auto old_precision =
+    this->output->precision(std::numeric_limits<double>::digits10);
+  *this->output << number;
+  this->output->precision(old_precision);
+}
+
 auto
 chrome_trace_event_writer::write_string_piece(czstring data) -> void
 {
@@ -1,11 +1,17 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/detail/have.h>
 #include <cxxtrace/uninitialized.h>
+#include <mutex>
 #include <ostream>
+#include <set>
 #include <sys/time.h>
+#include <thread>
 // IWYU pragma: no_include <ratio>
 
 #if CXXTRACE_HAVE_MACH_TIME
@@ -19,6 +25,256 @@
 #include <time.h>
 #endif
 
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+#include <optional>
+#endif
+
+#if defined(__x86_64__)
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#endif
+
+namespace {
+#if defined(__x86_64__)
+auto
+get_maximum_supported_basic_cpuid() noexcept -> std::uint32_t
+{
+  std::uint32_t eax;
+  asm("cpuid" : "=a"(eax) : "a"(0x00) : "ebx", "ecx", "edx");
+  // From Volume 2A:
+  // 0H: EAX: Maximum Input Value for Basic CPUID Information.
+  return eax;
+}
+
+auto
+get_maximum_supported_extended_cpuid() noexcept -> std::uint32_t
+{
+  std::uint32_t eax;
+  asm("cpuid" : "=a"(eax) : "a"(0x80000000) : "ebx", "ecx", "edx");
+  // From Volume 2A:
+  // 0H: EAX: Maximum Input Value for Extended Function CPUID Information.
+  return eax;
+}
+
+auto
+read_x86_tsc() noexcept -> std::uint64_t
+{
+  std::uint32_t eax;
+  std::uint32_t edx;
+  asm volatile("rdtsc" : "=a"(eax), "=d"(edx));
+  return (std::uint64_t{ edx } << 32) | std::uint64_t{ eax };
+}
+
+// Convert a TSC reading's nanosecond count to a time_point. Counts which do
+// not fit in std::chrono::nanoseconds (after about 292 years of uptime)
+// saturate instead of wrapping to negative times.
+template<class Nanoseconds>
+auto
+saturated_tsc_time_point(Nanoseconds nanoseconds) noexcept
+  -> cxxtrace::time_point
+{
+  using rep = std::chrono::nanoseconds::rep;
+  constexpr auto max_nanoseconds =
+    static_cast<Nanoseconds>(std::numeric_limits<rep>::max());
+  return cxxtrace::time_point{ std::chrono::nanoseconds{
+    static_cast<rep>(std::min(nanoseconds, max_nanoseconds)) } };
+}
+
+// Returns 0 if the processor does not enumerate its TSC frequency.
+auto
+get_x86_tsc_frequency_from_cpuid() noexcept -> std::uint64_t
+{
+  if (get_maximum_supported_basic_cpuid() < 0x15) {
+    return 0;
+  }
+  std::uint32_t eax;
+  std::uint32_t ebx;
+  std::uint32_t ecx;
+  asm("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx) : "a"(0x15), "c"(0) : "edx");
+  // From Volume 2A:
+  // 15H: EAX: Bits 31-00: An unsigned integer which is the denominator of the
+  // TSC/"core crystal clock" ratio.
+  // 15H: EBX: Bits 31-00: An unsigned integer which is the numerator of the
+  // TSC/"core crystal clock" ratio.
+  // 15H: ECX: Bits 31-00: An unsigned integer which is the nominal frequency
+  // of the core crystal clock in Hz.
+  if (eax == 0 || ebx == 0 || ecx == 0) {
+    return 0;
+  }
+  return std::uint64_t{ ecx } * ebx / eax;
+}
+
+auto
+measure_x86_tsc_frequency() noexcept -> std::uint64_t
+{
+  using reference_clock = std::chrono::steady_clock;
+  static constexpr auto calibration_duration = std::chrono::milliseconds{ 20 };
+
+  struct clock_pair
+  {
+    std::uint64_t tsc;
+    reference_clock::time_point reference;
+  };
+  auto query_clock_pair = []() noexcept->clock_pair
+  {
+    // Bracket the reference clock query with two TSC reads, and assume the
+    // reference clock was sampled half-way between them.
+    auto tsc_before = read_x86_tsc();
+    auto reference = reference_clock::now();
+    auto tsc_after = read_x86_tsc();
+    return clock_pair{ tsc_before + (tsc_after - tsc_before) / 2, reference };
+  };
+
+  auto begin = query_clock_pair();
+  auto end = begin;
+  do {
+    end = query_clock_pair();
+  } while (end.reference - begin.reference < calibration_duration);
+
+  auto elapsed_nanoseconds = std::uint64_t(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end.reference -
+                                                         begin.reference)
+      .count());
+  auto elapsed_ticks = end.tsc - begin.tsc;
+  return static_cast<std::uint64_t>(
+    static_cast<unsigned __int128>(elapsed_ticks) * 1'000'000'000 /
+    elapsed_nanoseconds);
+}
+
+auto
+get_x86_tsc_frequency() noexcept -> std::uint64_t
+{
+  static const auto frequency = []() noexcept->std::uint64_t
+  {
+    auto frequency = get_x86_tsc_frequency_from_cpuid();
+    if (frequency == 0) {
+      frequency = measure_x86_tsc_frequency();
+    }
+    assert(frequency != 0);
+    return frequency;
+  }
+  ();
+  return frequency;
+}
+#endif
+
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+// Convert a clock_gettime reading to a time_point. Readings which do not fit
+// in std::chrono::nanoseconds (about 292 years after the clock's epoch)
+// saturate instead of overflowing.
+auto
+time_point_from_timespec(const ::timespec& time) noexcept
+  -> cxxtrace::time_point
+{
+  using std::chrono::nanoseconds;
+  constexpr auto max_seconds =
+    std::chrono::duration_cast<std::chrono::seconds>(nanoseconds::max())
+      .count() -
+    1;
+  if (time.tv_sec > max_seconds) {
+    return cxxtrace::time_point{ nanoseconds::max() };
+  }
+  return cxxtrace::time_point{ std::chrono::seconds{ time.tv_sec } +
+                               nanoseconds{ time.tv_nsec } };
+}
+#endif
+
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+struct clock_gettime_measurement
+{
+  ::clockid_t clock_id;
+  std::chrono::nanoseconds resolution;
+  std::chrono::nanoseconds query_cost;
+};
+
+auto
+measure_clock_gettime(::clockid_t clock_id) noexcept
+  -> std::optional<clock_gettime_measurement>
+{
+  static constexpr auto query_count = 1000;
+
+  auto resolution = ::timespec{};
+  if (::clock_getres(clock_id, &resolution) != 0) {
+    return std::nullopt;
+  }
+  auto now = ::timespec{};
+  if (::clock_gettime(clock_id, &now) != 0) {
+    return std::nullopt;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  for (auto i = 0; i < query_count; ++i) {
+    ::clock_gettime(clock_id, &now);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return clock_gettime_measurement{
+    clock_id,
+    std::chrono::seconds{ resolution.tv_sec } +
+      std::chrono::nanoseconds{ resolution.tv_nsec },
+    (end - begin) / query_count,
+  };
+}
+
+auto
+choose_fastest_monotonic_clock_id() noexcept -> ::clockid_t
+{
+  using namespace std::chrono_literals;
+
+  // Candidates are listed in order of preference. A less-preferred candidate
+  // must be significantly cheaper to be chosen.
+  static constexpr ::clockid_t candidate_clock_ids[] = {
+    CLOCK_MONOTONIC,
+    CLOCK_MONOTONIC_RAW,
+    CLOCK_BOOTTIME,
+    CLOCK_MONOTONIC_COARSE,
+  };
+  static constexpr auto maximum_fine_resolution = 1us;
+  static constexpr auto maximum_acceptable_query_cost = 250ns;
+
+  auto is_significantly_cheaper = [](const clock_gettime_measurement& candidate,
+                                     const std::optional<
+                                       clock_gettime_measurement>& best) {
+    return !best || candidate.query_cost * 4 < best->query_cost * 3;
+  };
+
+  auto cheapest = std::optional<clock_gettime_measurement>{};
+  auto cheapest_fine = std::optional<clock_gettime_measurement>{};
+  for (auto clock_id : candidate_clock_ids) {
+    auto measurement = measure_clock_gettime(clock_id);
+    if (!measurement) {
+      continue;
+    }
+    if (is_significantly_cheaper(*measurement, cheapest)) {
+      cheapest = measurement;
+    }
+    if (measurement->resolution <= maximum_fine_resolution &&
+        is_significantly_cheaper(*measurement, cheapest_fine)) {
+      cheapest_fine = measurement;
+    }
+  }
+
+  if (cheapest_fine &&
+      cheapest_fine->query_cost <= maximum_acceptable_query_cost) {
+    return cheapest_fine->clock_id;
+  }
+  if (cheapest) {
+    return cheapest->clock_id;
+  }
+  return CLOCK_MONOTONIC;
+}
+
+auto
+get_fastest_monotonic_clock_id() noexcept -> ::clockid_t
+{
+  static auto clock_id = choose_fastest_monotonic_clock_id();
+  return clock_id;
+}
+#endif
+}
+
 namespace cxxtrace {
 time_point::time_point(uninitialized_t) noexcept
   : time_point{ std::chrono::nanoseconds::zero() }
@@ -34,6 +290,17 @@ time_point::nanoseconds_since_reference() const
   return this->time_since_reference;
 }
 
+auto
+wall_clock_anchor::wall_time_of(time_point time) const noexcept
+  -> std::chrono::system_clock::time_point
+{
+  auto time_since_anchor = time.nanoseconds_since_reference() -
+                           this->clock_time.nanoseconds_since_reference();
+  return this->wall_time +
+         std::chrono::duration_cast<std::chrono::system_clock::duration>(
+           time_since_anchor);
+}
+
 auto
 operator<<(std::ostream& out, const time_point& time) -> std::ostream&
 {
@@ -105,6 +372,20 @@ apple_absolute_time_clock::make_time_point(const sample& sample) -> time_point
   return time_point{ std::chrono::nanoseconds{ sample } };
 }
 
+auto
+apple_absolute_time_clock::make_time_points(const sample* samples,
+                                            time_point* out,
+                                            std::size_t count) -> void
+{
+  if (this->time_base.numer != this->time_base.denom) {
+    // TODO(strager): Support different time bases.
+    throw std::runtime_error{ "Apple time bases not yet implemented" };
+  }
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    out[i] = time_point{ std::chrono::nanoseconds{ samples[i] } };
+  }
+}
+
 apple_approximate_time_clock::apple_approximate_time_clock() noexcept(false) =
   default;
 
@@ -120,6 +401,14 @@ apple_approximate_time_clock::make_time_point(const sample& sample)
 {
   return this->absolute_time_clock_.make_time_point(sample);
 }
+
+auto
+apple_approximate_time_clock::make_time_points(const sample* samples,
+                                               time_point* out,
+                                               std::size_t count) -> void
+{
+  this->absolute_time_clock_.make_time_points(samples, out, count);
+}
 #endif
 
 auto
@@ -153,6 +442,14 @@ operator!=(posix_clock_gettime_clock_sample x,
 }
 }
 
+template<::clockid_t ClockID>
+auto
+posix_clock_gettime_clock<ClockID>::supported() noexcept -> bool
+{
+  auto now = ::timespec{};
+  return ::clock_gettime(ClockID, &now) == 0;
+}
+
 template<::clockid_t ClockID>
 auto
 posix_clock_gettime_clock<ClockID>::query() -> sample
@@ -170,12 +467,168 @@ auto
 posix_clock_gettime_clock<ClockID>::make_time_point(const sample& sample)
   -> time_point
 {
-  // TODO(strager): Handle overflow.
-  return time_point{ std::chrono::seconds{ sample.time.tv_sec } +
-                     std::chrono::nanoseconds{ sample.time.tv_nsec } };
+  return time_point_from_timespec(sample.time);
 }
 
 template class posix_clock_gettime_clock<CLOCK_MONOTONIC>;
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+template class posix_clock_gettime_clock<CLOCK_BOOTTIME>;
+template class posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>;
+template class posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>;
+#endif
+
+template<::clockid_t ClockID>
+auto
+compact_posix_clock_gettime_clock<ClockID>::supported() noexcept -> bool
+{
+  return posix_clock_gettime_clock<ClockID>::supported();
+}
+
+template<::clockid_t ClockID>
+compact_posix_clock_gettime_clock<
+  ClockID>::compact_posix_clock_gettime_clock() noexcept
+{
+  auto now = ::timespec{};
+  [[maybe_unused]] auto rc = ::clock_gettime(ClockID, &now);
+  assert(rc == 0);
+  this->epoch_seconds = now.tv_sec;
+}
+
+template<::clockid_t ClockID>
+auto
+compact_posix_clock_gettime_clock<ClockID>::query() -> sample
+{
+  auto now = ::timespec{};
+  [[maybe_unused]] auto rc = ::clock_gettime(ClockID, &now);
+  assert(rc == 0);
+  return sample{ now.tv_sec - this->epoch_seconds } * 1'000'000'000 +
+         sample{ now.tv_nsec };
+}
+
+template<::clockid_t ClockID>
+auto
+compact_posix_clock_gettime_clock<ClockID>::make_time_point(
+  const sample& sample) -> time_point
+{
+  return time_point{ std::chrono::seconds{ this->epoch_seconds } +
+                     std::chrono::nanoseconds{ sample } };
+}
+
+template<::clockid_t ClockID>
+auto
+compact_posix_clock_gettime_clock<ClockID>::make_time_points(
+  const sample* samples,
+  time_point* out,
+  std::size_t count) -> void
+{
+  auto epoch = std::chrono::nanoseconds{ std::chrono::seconds{
+    this->epoch_seconds } };
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    out[i] = time_point{ epoch + std::chrono::nanoseconds{ samples[i] } };
+  }
+}
+
+template class compact_posix_clock_gettime_clock<CLOCK_MONOTONIC>;
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+template class compact_posix_clock_gettime_clock<CLOCK_BOOTTIME>;
+template class compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>;
+template class compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>;
+#endif
+#endif
+
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+fastest_monotonic_clock::fastest_monotonic_clock() noexcept
+  : clock_id_{ get_fastest_monotonic_clock_id() }
+{}
+
+auto
+fastest_monotonic_clock::query() -> sample
+{
+  auto now = sample{};
+  [[maybe_unused]] auto rc = ::clock_gettime(this->clock_id_, &now.time);
+  assert(rc == 0);
+  return now;
+}
+
+auto
+fastest_monotonic_clock::make_time_point(const sample& sample) -> time_point
+{
+  return time_point_from_timespec(sample.time);
+}
+
+auto
+fastest_monotonic_clock::clock_id() const noexcept -> ::clockid_t
+{
+  return this->clock_id_;
+}
+#endif
+
+#if defined(__x86_64__)
+auto
+x86_tsc_clock::supported() noexcept -> bool
+{
+  if (get_maximum_supported_extended_cpuid() < 0x80000007) {
+    return false;
+  }
+  std::uint32_t edx;
+  asm("cpuid" : "=d"(edx) : "a"(0x80000007) : "ebx", "ecx");
+  // From Volume 2A:
+  // 80000007H: EDX: Bit 08: Invariant TSC available if 1.
+  return edx & (1 << 8);
+}
+
+x86_tsc_clock::x86_tsc_clock() noexcept(false)
+{
+  if (!supported()) {
+    throw std::runtime_error{ "Invariant TSC is not supported" };
+  }
+  auto frequency = get_x86_tsc_frequency();
+  this->nanoseconds_per_tick =
+    (std::uint64_t{ 1'000'000'000 } << nanoseconds_per_tick_shift) / frequency;
+}
+
+auto
+x86_tsc_clock::make_time_point(const sample& sample) -> time_point
+{
+  auto nanoseconds =
+    (static_cast<unsigned __int128>(sample) * this->nanoseconds_per_tick) >>
+    nanoseconds_per_tick_shift;
+  return saturated_tsc_time_point(nanoseconds);
+}
+
+auto
+x86_tsc_clock::make_time_points(const sample* samples,
+                                time_point* out,
+                                std::size_t count) -> void
+{
+  auto nanoseconds_per_tick = this->nanoseconds_per_tick;
+  if (nanoseconds_per_tick > std::numeric_limits<std::uint32_t>::max()) {
+    for (auto i = std::size_t{ 0 }; i < count; ++i) {
+      out[i] = this->make_time_point(samples[i]);
+    }
+    return;
+  }
+
+  // nanoseconds_per_tick fits in 32 bits (i.e. the TSC ticks faster than
+  // 1 GHz), so split each sample into 32-bit halves:
+  //
+  //   (ticks * nanoseconds_per_tick) >> 32
+  //   == high * nanoseconds_per_tick + ((low * nanoseconds_per_tick) >> 32)
+  //
+  // Unlike make_time_point's 64x64-bit multiplication, the 32x32-bit
+  // multiplications vectorize (pmuludq or vpmuludq). The sum cannot wrap:
+  // high * nanoseconds_per_tick is at most 2^64 - 2^33 + 1, and the low term
+  // is less than 2^32.
+  static_assert(nanoseconds_per_tick_shift == 32);
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    auto ticks = samples[i];
+    auto high = ticks >> 32;
+    auto low = ticks & std::uint64_t{ 0xffffffff };
+    auto nanoseconds =
+      high * nanoseconds_per_tick + ((low * nanoseconds_per_tick) >> 32);
+    out[i] = saturated_tsc_time_point(nanoseconds);
+  }
+}
 #endif
 
 auto
@@ -195,6 +648,167 @@ posix_gettimeofday_clock::make_time_point(const sample& sample) -> time_point
                      std::chrono::microseconds{ sample.time.tv_usec } };
 }
 
+compact_posix_gettimeofday_clock::compact_posix_gettimeofday_clock() noexcept
+{
+  auto now = ::timeval{};
+  [[maybe_unused]] auto rc = ::gettimeofday(&now, nullptr);
+  assert(rc == 0);
+  this->epoch_seconds = now.tv_sec;
+}
+
+auto
+compact_posix_gettimeofday_clock::query() -> sample
+{
+  auto now = ::timeval{};
+  [[maybe_unused]] auto rc = ::gettimeofday(&now, nullptr);
+  assert(rc == 0);
+  return sample{ now.tv_sec - this->epoch_seconds } * 1'000'000'000 +
+         sample{ now.tv_usec } * 1'000;
+}
+
+auto
+compact_posix_gettimeofday_clock::make_time_point(const sample& sample)
+  -> time_point
+{
+  return time_point{ std::chrono::seconds{ this->epoch_seconds } +
+                     std::chrono::nanoseconds{ sample } };
+}
+
+auto
+compact_posix_gettimeofday_clock::make_time_points(const sample* samples,
+                                                   time_point* out,
+                                                   std::size_t count) -> void
+{
+  auto epoch = std::chrono::nanoseconds{ std::chrono::seconds{
+    this->epoch_seconds } };
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    out[i] = time_point{ epoch + std::chrono::nanoseconds{ samples[i] } };
+  }
+}
+
+namespace detail {
+ticker_published_time ticker_approximate_time{};
+}
+
+namespace {
+// The thread which publishes detail::ticker_approximate_time.
+//
+// The thread runs while at least one ticker_approximate_time_clock exists, and
+// ticks at the shortest period requested by those clocks.
+class shared_ticker
+{
+public:
+  static auto instance() noexcept(false) -> shared_ticker&
+  {
+    // Leak the ticker so clocks with static storage duration can outlive it.
+    static auto* ticker = new shared_ticker{};
+    return *ticker;
+  }
+
+  auto add_clock(std::chrono::nanoseconds period) noexcept(false) -> void
+  {
+    {
+      auto lock = std::lock_guard<std::mutex>{ this->mutex };
+      auto period_it = this->periods.insert(period);
+      if (this->periods.size() == 1) {
+        this->publish_current_time();
+        try {
+          this->thread = std::thread{ [this, generation = this->generation] {
+            this->run(generation);
+          } };
+        } catch (...) {
+          this->periods.erase(period_it);
+          throw;
+        }
+        return;
+      }
+      if (period_it != this->periods.begin()) {
+        return;
+      }
+    }
+    // Wake the thread so it ticks at the new, shorter period.
+    this->ticker_changed.notify_all();
+  }
+
+  auto remove_clock(std::chrono::nanoseconds period) noexcept -> void
+  {
+    auto stopped_thread = std::thread{};
+    {
+      auto lock = std::lock_guard<std::mutex>{ this->mutex };
+      this->periods.erase(this->periods.find(period));
+      if (this->periods.empty()) {
+        // A clock might be added before the thread notices it should stop.
+        // The generation keeps the old thread from ticking alongside the new
+        // thread.
+        this->generation += 1;
+        stopped_thread = std::move(this->thread);
+      }
+    }
+    if (stopped_thread.joinable()) {
+      this->ticker_changed.notify_all();
+      stopped_thread.join();
+    }
+  }
+
+private:
+  explicit shared_ticker() noexcept = default;
+
+  auto run(std::uint64_t generation) noexcept -> void
+  {
+    auto lock = std::unique_lock<std::mutex>{ this->mutex };
+    auto stop_requested = [&] { return this->generation != generation; };
+    while (!stop_requested()) {
+      auto period = *this->periods.begin();
+      auto woken = this->ticker_changed.wait_for(lock, period, [&] {
+        return stop_requested() || *this->periods.begin() < period;
+      });
+      if (!woken) {
+        this->publish_current_time();
+      }
+    }
+  }
+
+  // Publishing while holding mutex keeps published times in order.
+  auto publish_current_time() noexcept -> void
+  {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    detail::ticker_approximate_time.nanoseconds.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(),
+      std::memory_order_relaxed);
+  }
+
+  std::mutex mutex;
+  std::condition_variable ticker_changed;
+  // Protected by mutex.
+  std::multiset<std::chrono::nanoseconds> periods;
+  std::uint64_t generation{ 0 };
+  std::thread thread;
+};
+}
+
+ticker_approximate_time_clock::ticker_approximate_time_clock() noexcept(false)
+  : ticker_approximate_time_clock{ std::chrono::milliseconds{ 1 } }
+{}
+
+ticker_approximate_time_clock::ticker_approximate_time_clock(
+  std::chrono::nanoseconds period) noexcept(false)
+  : period{ period }
+{
+  shared_ticker::instance().add_clock(this->period);
+}
+
+ticker_approximate_time_clock::~ticker_approximate_time_clock() noexcept
+{
+  shared_ticker::instance().remove_clock(this->period);
+}
+
+auto
+ticker_approximate_time_clock::make_time_point(const sample& sample)
+  -> time_point
+{
+  return time_point{ std::chrono::nanoseconds{ sample } };
+}
+
 fake_clock::fake_clock() noexcept
   : next_sample{ std::chrono::nanoseconds{ 1 }.count() }
   , query_increment{ std::chrono::nanoseconds{ 1 }.count() }
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/detail/clock_skew.h>
+#include <cxxtrace/detail/have.h>
+#include <cxxtrace/detail/processor.h>
+#include <cxxtrace/detail/snapshot_sample.h>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#if CXXTRACE_HAVE_SCHED_SETAFFINITY
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace cxxtrace {
+namespace detail {
+namespace {
+#if CXXTRACE_HAVE_SCHED_SETAFFINITY
+struct processor_clock_offset
+{
+  processor_id id;
+  std::chrono::nanoseconds offset;
+};
+
+auto
+get_allowed_cpus() noexcept -> std::vector<int>
+{
+  auto cpus = std::vector<int>{};
+  auto cpu_set = ::cpu_set_t{};
+  CPU_ZERO(&cpu_set);
+  if (::sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    return cpus;
+  }
+  for (auto cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      cpus.emplace_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+auto
+pin_current_thread_to_cpu(int cpu) noexcept -> bool
+{
+  auto cpu_set = ::cpu_set_t{};
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  auto rc =
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set);
+  return rc == 0;
+}
+
+class clock_offset_exchange
+{
+public:
+  static constexpr auto round_count = 100;
+
+  explicit clock_offset_exchange(
+    void* clock,
+    clock_skew_query_function query,
+    void* get_processor_id_context,
+    clock_skew_get_processor_id_function get_processor_id) noexcept
+    : clock{ clock }
+    , query{ query }
+    , get_processor_id_context{ get_processor_id_context }
+    , get_processor_id{ get_processor_id }
+  {}
+
+  // Measure the offset of remote_cpu's clock relative to the current thread's
+  // clock. The current thread must be pinned.
+  auto measure(int remote_cpu) noexcept(false)
+    -> std::optional<processor_clock_offset>
+  {
+    this->request.store(not_ready, std::memory_order_relaxed);
+    this->response.store(not_ready, std::memory_order_relaxed);
+    this->remote_error = nullptr;
+
+    auto remote_thread = std::thread{ [&] { this->respond(remote_cpu); } };
+    auto remote_thread_joiner = remote_thread_guard{ *this, remote_thread };
+
+    auto remote_status = this->wait_for_response(ready);
+    if (remote_status == failed) {
+      remote_thread_joiner.join();
+      this->rethrow_remote_error();
+      return std::nullopt;
+    }
+
+    auto best_offset = std::chrono::nanoseconds{};
+    auto best_round_trip = std::optional<std::chrono::nanoseconds>{};
+    for (auto round = 0; round < round_count; ++round) {
+      auto before = this->query(this->clock);
+      this->request.store(round, std::memory_order_release);
+      remote_status = this->wait_for_response(round);
+      if (remote_status == failed) {
+        remote_thread_joiner.join();
+        this->rethrow_remote_error();
+        return std::nullopt;
+      }
+      auto after = this->query(this->clock);
+
+      auto before_ns = before.nanoseconds_since_reference();
+      auto after_ns = after.nanoseconds_since_reference();
+      auto remote_ns = this->remote_time.nanoseconds_since_reference();
+      auto round_trip = after_ns - before_ns;
+      if (!best_round_trip || round_trip < *best_round_trip) {
+        best_round_trip = round_trip;
+        best_offset = remote_ns - (before_ns + round_trip / 2);
+      }
+    }
+    remote_thread_joiner.join();
+    return processor_clock_offset{ this->remote_processor_id, best_offset };
+  }
+
+private:
+  static constexpr auto not_ready = -1;
+  static constexpr auto ready = -2;
+  static constexpr auto failed = -3;
+  static constexpr auto cancelled = -4;
+
+  // Join the remote thread when measure returns or throws. (Destroying a
+  // joinable std::thread terminates the program.)
+  class remote_thread_guard
+  {
+  public:
+    explicit remote_thread_guard(clock_offset_exchange& exchange,
+                                 std::thread& thread) noexcept
+      : exchange{ exchange }
+      , thread{ thread }
+    {}
+
+    remote_thread_guard(const remote_thread_guard&) = delete;
+    remote_thread_guard& operator=(const remote_thread_guard&) = delete;
+
+    ~remote_thread_guard() { this->join(); }
+
+    auto join() noexcept -> void
+    {
+      if (this->thread.joinable()) {
+        // Stop the remote thread if it is waiting for a round which will
+        // never be requested.
+        this->exchange.request.store(cancelled, std::memory_order_release);
+        this->thread.join();
+      }
+    }
+
+  private:
+    clock_offset_exchange& exchange;
+    std::thread& thread;
+  };
+
+  auto respond(int cpu) noexcept -> void
+  {
+    if (!pin_current_thread_to_cpu(cpu)) {
+      this->response.store(failed, std::memory_order_release);
+      return;
+    }
+    try {
+      this->remote_processor_id =
+        this->get_processor_id(this->get_processor_id_context);
+      this->response.store(ready, std::memory_order_release);
+
+      for (auto round = 0; round < round_count; ++round) {
+        for (;;) {
+          auto request = this->request.load(std::memory_order_acquire);
+          if (request == round) {
+            break;
+          }
+          if (request == cancelled) {
+            return;
+          }
+        }
+        this->remote_time = this->query(this->clock);
+        this->response.store(round, std::memory_order_release);
+      }
+    } catch (...) {
+      this->remote_error = std::current_exception();
+      this->response.store(failed, std::memory_order_release);
+    }
+  }
+
+  auto rethrow_remote_error() noexcept(false) -> void
+  {
+    if (this->remote_error) {
+      std::rethrow_exception(this->remote_error);
+    }
+  }
+
+  auto wait_for_response(int expected) noexcept -> int
+  {
+    for (;;) {
+      auto value = this->response.load(std::memory_order_acquire);
+      if (value == expected || value == failed) {
+        return value;
+      }
+    }
+  }
+
+  void* clock;
+  clock_skew_query_function query;
+  void* get_processor_id_context;
+  clock_skew_get_processor_id_function get_processor_id;
+
+  alignas(64) std::atomic<int> request{ not_ready };
+  alignas(64) std::atomic<int> response{ not_ready };
+  time_point remote_time{ uninitialized };
+  processor_id remote_processor_id{ 0 };
+  std::exception_ptr remote_error{};
+};
+#endif
+}
+
+auto
+measure_processor_clock_offsets(
+  [[maybe_unused]] void* clock,
+  [[maybe_unused]] clock_skew_query_function query,
+  [[maybe_unused]] void* get_processor_id_context,
+  [[maybe_unused]] clock_skew_get_processor_id_function get_processor_id,
+  processor_id maximum_processor_id) noexcept(false)
+  -> std::vector<std::chrono::nanoseconds>
+{
+  auto offsets =
+    std::vector<std::chrono::nanoseconds>(maximum_processor_id + 1);
+
+#if CXXTRACE_HAVE_SCHED_SETAFFINITY
+  auto cpus = get_allowed_cpus();
+  if (cpus.size() < 2) {
+    return offsets;
+  }
+
+  // Measure from a separate thread so the caller's affinity is left alone.
+  auto error = std::exception_ptr{};
+  auto reference_thread = std::thread{ [&] {
+    try {
+      auto reference_cpu = cpus.front();
+      if (!pin_current_thread_to_cpu(reference_cpu)) {
+        return;
+      }
+      auto exchange = clock_offset_exchange{
+        clock, query, get_processor_id_context, get_processor_id
+      };
+      for (auto cpu : cpus) {
+        if (cpu == reference_cpu) {
+          continue;
+        }
+        auto offset = exchange.measure(cpu);
+        if (offset && offset->id <= maximum_processor_id) {
+          offsets[offset->id] = offset->offset;
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+  } };
+  reference_thread.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+#endif
+
+  return offsets;
+}
+
+auto
+subtract_clock_offset(snapshot_sample* begin,
+                      snapshot_sample* end,
+                      std::chrono::nanoseconds offset) noexcept -> void
+{
+  for (auto* sample = begin; sample != end; ++sample) {
+    sample->timestamp =
+      time_point{ sample->timestamp.nanoseconds_since_reference() - offset };
+  }
+}
+
+auto
+merge_processor_samples(std::vector<snapshot_sample>& samples,
+                        std::size_t processor_samples_begin,
+                        std::chrono::nanoseconds clock_offset) noexcept -> void
+{
+  auto less_by_timestamp =
+    [](const snapshot_sample& x, const snapshot_sample& y) noexcept->bool {
+    return x.timestamp < y.timestamp;
+  };
+  if (clock_offset != std::chrono::nanoseconds{ 0 }) {
+    subtract_clock_offset(samples.data() + processor_samples_begin,
+                          samples.data() + samples.size(),
+                          clock_offset);
+  }
+  // A processor's samples are in the order they were added, which is not
+  // necessarily timestamp order. For example, a complete span is added when it
+  // exits, after any spans nested within it, but its timestamp is the time it
+  // was entered.
+  std::stable_sort(samples.begin() + processor_samples_begin,
+                   samples.end(),
+                   less_by_timestamp);
+  std::inplace_merge(samples.begin(),
+                     samples.begin() + processor_samples_begin,
+                     samples.end(),
+                     less_by_timestamp);
+}
+}
+}
@@ -0,0 +1,135 @@
+#include <cxxtrace/detail/have.h>
+#include <cxxtrace/hardware_counters.h>
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+#include <atomic>
+#include <cstdint>
+#include <cxxtrace/detail/perf_event.h>
+#include <linux/perf_event.h>
+#include <optional>
+#include <system_error>
+#include <utility>
+#endif
+
+namespace cxxtrace {
+auto
+operator-(const hardware_counters& x, const hardware_counters& y) noexcept
+  -> hardware_counters
+{
+  if (!x.available() || !y.available()) {
+    return unavailable_hardware_counters;
+  }
+  return hardware_counters{
+    x.cycles - y.cycles,
+    x.instructions - y.instructions,
+    x.llc_misses - y.llc_misses,
+  };
+}
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+namespace {
+auto
+rdpmc(std::uint32_t counter) noexcept -> std::uint64_t
+{
+  std::uint32_t eax;
+  std::uint32_t edx;
+  asm volatile("rdpmc" : "=a"(eax), "=d"(edx) : "c"(counter));
+  return (std::uint64_t{ edx } << 32) | std::uint64_t{ eax };
+}
+
+auto
+read_counter(detail::thread_perf_event& event) noexcept(false) -> std::uint64_t
+{
+  // See the documentation of perf_event_mmap_page in <linux/perf_event.h> for
+  // this protocol.
+  const auto* page = event.page();
+  for (;;) {
+    auto sequence = page->lock;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    auto index = page->index;
+    auto count = static_cast<std::uint64_t>(page->offset);
+    auto can_rdpmc = page->cap_user_rdpmc && index != 0;
+    if (can_rdpmc) {
+      auto width = page->pmc_width;
+      auto counter = static_cast<std::int64_t>(rdpmc(index - 1));
+      counter <<= 64 - width;
+      counter >>= 64 - width;
+      count += static_cast<std::uint64_t>(counter);
+    }
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (page->lock != sequence) {
+      continue;
+    }
+    if (!can_rdpmc) {
+      return event.read_with_system_call();
+    }
+    return count;
+  }
+}
+
+class thread_perf_event_counters
+{
+public:
+  explicit thread_perf_event_counters() noexcept(false)
+    : cycles{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, nullptr }
+    , instructions{ PERF_TYPE_HARDWARE,
+                    PERF_COUNT_HW_INSTRUCTIONS,
+                    &this->cycles }
+    , llc_misses{ PERF_TYPE_HARDWARE,
+                  PERF_COUNT_HW_CACHE_MISSES,
+                  &this->cycles }
+  {}
+
+  auto read() noexcept(false) -> hardware_counters
+  {
+    return hardware_counters{
+      read_counter(this->cycles),
+      read_counter(this->instructions),
+      read_counter(this->llc_misses),
+    };
+  }
+
+private:
+  detail::thread_perf_event cycles;
+  detail::thread_perf_event instructions;
+  detail::thread_perf_event llc_misses;
+};
+
+auto
+open_thread_perf_event_counters() noexcept
+  -> std::optional<thread_perf_event_counters>
+{
+  try {
+    return std::optional<thread_perf_event_counters>{ std::in_place };
+  } catch (const std::system_error&) {
+    return std::nullopt;
+  }
+}
+
+// Return nullptr if the current thread's counters could not be opened. The
+// failure is remembered, so perf_event_open is not retried on every read.
+auto
+get_thread_perf_event_counters() noexcept -> thread_perf_event_counters*
+{
+  thread_local auto counters = open_thread_perf_event_counters();
+  return counters.has_value() ? &*counters : nullptr;
+}
+}
+
+auto
+perf_event_counter_reader::supported() noexcept -> bool
+{
+  return get_thread_perf_event_counters() != nullptr;
+}
+
+auto
+perf_event_counter_reader::read() noexcept(false) -> hardware_counters
+{
+  auto* counters = get_thread_perf_event_counters();
+  if (!counters) {
+    return unavailable_hardware_counters;
+  }
+  return counters->read();
+}
+#endif
+}
@@ -1,9 +1,14 @@
 #ifndef CXXTRACE_CHROME_TRACE_EVENT_FORMAT_H
 #define CXXTRACE_CHROME_TRACE_EVENT_FORMAT_H
 
+#include <chrono>
+#include <cstdint>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/hardware_counters.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/string.h>
 #include <iosfwd>
+#include <optional>
 #include <type_traits>
 
 namespace cxxtrace {
@@ -37,10 +42,44 @@ public:
   auto close() -> void;
 
 private:
-  auto write_sample(sample_ref) -> void;
+  // A thread's state when a span was entered or exited.
+  struct span_point
+  {
+    static auto at(sample_ref sample) -> span_point
+    {
+      return span_point{ sample.timestamp(),
+                         sample.counters(),
+                         sample.thread_cpu_time() };
+    }
+
+    time_point timestamp;
+    std::optional<hardware_counters> counters;
+    std::optional<std::chrono::nanoseconds> thread_cpu_time;
+  };
+
+  // If sample is a span's exit, span_enter points to the span's enter sample.
+  auto write_sample(sample_ref, const sample_ref* span_enter) -> void;
+  // Write the end of the phase which began with phase_begin and ended with
+  // next_phase.
+  auto write_phase_end(sample_ref next_phase, sample_ref phase_begin) -> void;
+  // Write an instant event marking records discarded by a lossy storage.
+  auto write_loss(const sample_loss&, std::optional<time_point> timestamp)
+    -> void;
+
+  // Write members of an event's "args" object, opening the object unless
+  // wrote_arg is true. The caller must close the object if wrote_arg is true.
+  auto write_span_args(const span_point& enter,
+                       const span_point& exit,
+                       bool& wrote_arg) -> void;
+  auto write_sample_arguments(sample_ref, bool& wrote_arg) -> void;
+  auto write_arg_name(czstring name, bool& wrote_arg) -> void;
+
+  auto write_microseconds(std::chrono::nanoseconds) -> void;
+  auto write_event_id(std::uint64_t) -> void;
 
   template<class T>
   auto write_number(T number) -> std::enable_if_t<std::is_integral_v<T>, void>;
+  auto write_number(double number) -> void;
 
   auto write_string_piece(czstring data) -> void;
 
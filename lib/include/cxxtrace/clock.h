@@ -3,13 +3,14 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cxxtrace/detail/have.h>
 #include <cxxtrace/uninitialized.h>
 #include <iosfwd>
 #include <sys/time.h>
 
 #if CXXTRACE_HAVE_MACH_TIME
-#include <cstdint>
 #include <mach/mach_time.h>
 #endif
 
@@ -83,6 +84,8 @@ public:
   auto query() -> sample;
 
   auto make_time_point(const sample&) -> time_point;
+  auto make_time_points(const sample*, time_point*, std::size_t count)
+    -> void;
 
 private:
   ::mach_timebase_info_data_t time_base;
@@ -111,6 +114,8 @@ public:
   auto query() -> sample;
 
   auto make_time_point(const sample&) -> time_point;
+  auto make_time_points(const sample*, time_point*, std::size_t count)
+    -> void;
 
 private:
   apple_absolute_time_clock absolute_time_clock_;
@@ -132,6 +137,37 @@ posix_clock_gettime_clock<CLOCK_MONOTONIC>() noexcept -> clock_traits
   };
 }
 
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+template<>
+inline constexpr auto
+posix_clock_gettime_clock<CLOCK_BOOTTIME>() noexcept -> clock_traits
+{
+  return clock_traits{
+    .monotonicity = clock_monotonicity::non_decreasing_per_thread,
+  };
+}
+
+// CLOCK_MONOTONIC_COARSE is updated once per scheduler tick (typically every 1
+// to 10 milliseconds).
+template<>
+inline constexpr auto
+posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>() noexcept -> clock_traits
+{
+  return clock_traits{
+    .monotonicity = clock_monotonicity::non_decreasing_per_thread,
+  };
+}
+
+template<>
+inline constexpr auto
+posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>() noexcept -> clock_traits
+{
+  return clock_traits{
+    .monotonicity = clock_monotonicity::non_decreasing_per_thread,
+  };
+}
+#endif
+
 struct posix_clock_gettime_clock_sample
 {
   ::timespec time;
@@ -152,12 +188,144 @@ public:
   inline static constexpr auto traits =
     detail::posix_clock_gettime_clock<ClockID>();
 
+  static auto supported() noexcept -> bool;
+
   auto query() -> sample;
 
   auto make_time_point(const sample&) -> time_point;
 };
 
 extern template class posix_clock_gettime_clock<CLOCK_MONOTONIC>;
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+extern template class posix_clock_gettime_clock<CLOCK_BOOTTIME>;
+extern template class posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>;
+extern template class posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>;
+#endif
+
+// compact_posix_clock_gettime_clock is like posix_clock_gettime_clock, but
+// samples are 8 bytes instead of 16 bytes.
+//
+// A sample is a number of nanoseconds relative to an epoch chosen when the
+// clock is constructed. A sample must be converted with the clock which
+// queried it.
+template<::clockid_t ClockID>
+class compact_posix_clock_gettime_clock : public clock_base
+{
+public:
+  using sample = std::int64_t;
+
+  inline static constexpr auto traits =
+    detail::posix_clock_gettime_clock<ClockID>();
+
+  static auto supported() noexcept -> bool;
+
+  explicit compact_posix_clock_gettime_clock() noexcept;
+
+  auto query() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+  auto make_time_points(const sample*, time_point*, std::size_t count)
+    -> void;
+
+private:
+  ::time_t epoch_seconds;
+};
+
+extern template class compact_posix_clock_gettime_clock<CLOCK_MONOTONIC>;
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+extern template class compact_posix_clock_gettime_clock<CLOCK_BOOTTIME>;
+extern template class compact_posix_clock_gettime_clock<
+  CLOCK_MONOTONIC_COARSE>;
+extern template class compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>;
+#endif
+#endif
+
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+namespace detail {
+inline constexpr auto
+fastest_monotonic_clock_traits() noexcept -> clock_traits
+{
+  return clock_traits{
+    .monotonicity = clock_monotonicity::non_decreasing_per_thread,
+  };
+}
+}
+
+// fastest_monotonic_clock queries one of CLOCK_MONOTONIC, CLOCK_MONOTONIC_RAW,
+// CLOCK_BOOTTIME, or CLOCK_MONOTONIC_COARSE, whichever is cheapest on this
+// machine.
+//
+// The first fastest_monotonic_clock constructed in a process measures the
+// resolution and query cost of each candidate. The cheapest candidate with
+// microsecond (or better) resolution wins, unless it is expensive (e.g. because
+// the kernel cannot read the clock source from the vDSO), in which case the
+// cheapest candidate wins regardless of resolution.
+class fastest_monotonic_clock : public clock_base
+{
+public:
+  using sample = detail::posix_clock_gettime_clock_sample;
+
+  inline static constexpr auto traits =
+    detail::fastest_monotonic_clock_traits();
+
+  explicit fastest_monotonic_clock() noexcept;
+
+  auto query() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+
+  auto clock_id() const noexcept -> ::clockid_t;
+
+private:
+  ::clockid_t clock_id_;
+};
+#endif
+
+#if defined(__x86_64__)
+namespace detail {
+inline constexpr auto
+x86_tsc_clock_traits() noexcept -> clock_traits
+{
+  return clock_traits{
+    .monotonicity = clock_monotonicity::non_decreasing_per_thread,
+  };
+}
+}
+
+// x86_tsc_clock reads the processor's timestamp counter with the rdtsc
+// instruction.
+//
+// x86_tsc_clock requires an invariant TSC (i.e. a timestamp counter which ticks
+// at a constant rate regardless of power state). The TSC's frequency is
+// calibrated once per process.
+//
+// query_serialized is like query, but the rdtsc instruction is fenced with
+// lfence so the processor does not execute it early or late relative to
+// neighboring instructions. query_serialized is slower than query.
+class x86_tsc_clock : public clock_base
+{
+public:
+  using sample = std::uint64_t;
+
+  inline static constexpr auto traits = detail::x86_tsc_clock_traits();
+
+  static auto supported() noexcept -> bool;
+
+  explicit x86_tsc_clock() noexcept(false);
+
+  auto query() -> sample;
+  auto query_serialized() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+  auto make_time_points(const sample*, time_point*, std::size_t count)
+    -> void;
+
+private:
+  // nanoseconds = (ticks * nanoseconds_per_tick) >> nanoseconds_per_tick_shift
+  static constexpr auto nanoseconds_per_tick_shift = 32;
+
+  std::uint64_t nanoseconds_per_tick;
+};
 #endif
 
 namespace detail {
@@ -189,6 +357,86 @@ public:
   auto make_time_point(const sample&) -> time_point;
 };
 
+// compact_posix_gettimeofday_clock is like posix_gettimeofday_clock, but
+// samples are 8 bytes instead of 16 bytes.
+//
+// A sample is a number of nanoseconds relative to an epoch chosen when the
+// clock is constructed. A sample must be converted with the clock which
+// queried it.
+class compact_posix_gettimeofday_clock : public clock_base
+{
+public:
+  using sample = std::int64_t;
+
+  inline static constexpr auto traits =
+    detail::posix_gettimeofday_clock_traits();
+
+  explicit compact_posix_gettimeofday_clock() noexcept;
+
+  auto query() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+  auto make_time_points(const sample*, time_point*, std::size_t count)
+    -> void;
+
+private:
+  ::time_t epoch_seconds;
+};
+
+namespace detail {
+inline constexpr auto
+ticker_approximate_time_clock_traits() noexcept -> clock_traits
+{
+  return clock_traits{
+    .monotonicity = clock_monotonicity::non_decreasing_per_thread,
+  };
+}
+
+// Aligned and padded to avoid false sharing with other data.
+struct alignas(64) ticker_published_time
+{
+  std::atomic<std::int64_t> nanoseconds;
+};
+
+// The time most recently published by the ticker of every
+// ticker_approximate_time_clock.
+extern ticker_published_time ticker_approximate_time;
+}
+
+// ticker_approximate_time_clock is a cheap, low-sensitivity clock, similar to
+// apple_approximate_time_clock.
+//
+// While any ticker_approximate_time_clock exists, one background thread
+// samples std::chrono::steady_clock once per period and publishes the result.
+// If clocks ask for different periods (one millisecond by default), the
+// shortest wins. query reads the most recently published time with a single
+// relaxed atomic load.
+class ticker_approximate_time_clock : public clock_base
+{
+public:
+  using sample = std::int64_t;
+
+  inline static constexpr auto traits =
+    detail::ticker_approximate_time_clock_traits();
+
+  explicit ticker_approximate_time_clock() noexcept(false);
+  explicit ticker_approximate_time_clock(
+    std::chrono::nanoseconds period) noexcept(false);
+
+  ticker_approximate_time_clock(const ticker_approximate_time_clock&) = delete;
+  ticker_approximate_time_clock& operator=(
+    const ticker_approximate_time_clock&) = delete;
+
+  ~ticker_approximate_time_clock() noexcept;
+
+  auto query() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+
+private:
+  std::chrono::nanoseconds period;
+};
+
 namespace detail {
 inline constexpr auto
 fake_clock_traits() noexcept -> clock_traits
@@ -222,6 +470,61 @@ private:
   sample query_increment;
 };
 
+namespace detail {
+// Convert count samples into time points, as if by calling
+// clock.make_time_point for each sample.
+//
+// If Clock has a make_time_points member function, make_time_points calls it.
+// Clocks should implement make_time_points if converting many samples at once
+// is cheaper than converting each sample individually (e.g. because the
+// conversion can be vectorized).
+template<class Clock>
+auto
+make_time_points(Clock&,
+                 const typename Clock::sample*,
+                 time_point*,
+                 std::size_t count) -> void;
+
+// Query clock, as if by calling clock.query.
+//
+// If Clock has a query_serialized member function, query_serialized calls it.
+// Clocks should implement query_serialized if query can be reordered with
+// neighboring instructions (e.g. rdtsc).
+template<class Clock>
+auto
+query_serialized(Clock&) -> typename Clock::sample;
+}
+
+// A pair of simultaneous readings of a trace clock and the system's wall clock
+// (std::chrono::system_clock, i.e. CLOCK_REALTIME on POSIX).
+//
+// Anchors let consumers convert trace time points into absolute times, e.g. to
+// merge traces from several processes.
+struct wall_clock_anchor
+{
+  auto wall_time_of(time_point) const noexcept
+    -> std::chrono::system_clock::time_point;
+
+  time_point clock_time;
+  std::chrono::system_clock::time_point wall_time;
+};
+
+inline constexpr auto default_wall_clock_anchor_bracket_count = 8;
+
+// Read Clock and the wall clock at approximately the same time.
+//
+// measure_wall_clock_anchor brackets bracket_count wall clock readings with
+// serialized Clock readings (see detail::query_serialized). The bracket with
+// the smallest delay wins, and the anchor's clock_time is that bracket's
+// midpoint. A single bracket is often inflated by a cache miss or an
+// interrupt; the tightest of several usually is not.
+template<class Clock>
+auto
+measure_wall_clock_anchor(
+  Clock&,
+  int bracket_count = default_wall_clock_anchor_bracket_count) noexcept(false)
+  -> wall_clock_anchor;
+
 using default_clock =
 #if CXXTRACE_HAVE_MACH_TIME
   apple_absolute_time_clock
@@ -6,6 +6,18 @@
   "Include <cxxtrace/clock.h> instead of including <cxxtrace/clock_impl.h> directly."
 #endif
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cxxtrace/uninitialized.h>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <cstdint>
+#endif
+
 namespace cxxtrace {
 constexpr auto
 clock_traits::is_strictly_increasing_per_thread() const noexcept -> bool
@@ -30,6 +42,123 @@ clock_traits::is_non_decreasing_per_thread() const noexcept -> bool
       return false;
   }
 }
+
+namespace detail {
+template<class Clock, class = void>
+struct clock_has_make_time_points : std::false_type
+{};
+
+template<class Clock>
+struct clock_has_make_time_points<
+  Clock,
+  std::void_t<decltype(std::declval<Clock&>().make_time_points(
+    std::declval<const typename Clock::sample*>(),
+    std::declval<time_point*>(),
+    std::size_t{}))>> : std::true_type
+{};
+
+template<class Clock>
+auto
+make_time_points(Clock& clock,
+                 const typename Clock::sample* samples,
+                 time_point* out,
+                 std::size_t count) -> void
+{
+  if constexpr (clock_has_make_time_points<Clock>::value) {
+    clock.make_time_points(samples, out, count);
+  } else {
+    for (auto i = std::size_t{ 0 }; i < count; ++i) {
+      out[i] = clock.make_time_point(samples[i]);
+    }
+  }
+}
+}
+
+namespace detail {
+template<class Clock, class = void>
+struct clock_has_query_serialized : std::false_type
+{};
+
+template<class Clock>
+struct clock_has_query_serialized<
+  Clock,
+  std::void_t<decltype(std::declval<Clock&>().query_serialized())>>
+  : std::true_type
+{};
+
+template<class Clock>
+auto
+query_serialized(Clock& clock) -> typename Clock::sample
+{
+  if constexpr (clock_has_query_serialized<Clock>::value) {
+    return clock.query_serialized();
+  } else {
+    return clock.query();
+  }
+}
+}
+
+template<class Clock>
+auto
+measure_wall_clock_anchor(Clock& clock, int bracket_count) noexcept(false)
+  -> wall_clock_anchor
+{
+  assert(bracket_count > 0);
+
+  auto best_delay = std::chrono::nanoseconds::max();
+  auto best_anchor = wall_clock_anchor{ time_point{ uninitialized }, {} };
+  for (auto i = 0; i < bracket_count; ++i) {
+    auto before = detail::query_serialized(clock);
+    auto wall_time = std::chrono::system_clock::now();
+    auto after = detail::query_serialized(clock);
+
+    auto before_time =
+      clock.make_time_point(before).nanoseconds_since_reference();
+    auto after_time =
+      clock.make_time_point(after).nanoseconds_since_reference();
+    auto delay = after_time - before_time;
+    if (delay < best_delay) {
+      best_delay = delay;
+      best_anchor = wall_clock_anchor{ time_point{ before_time + delay / 2 },
+                                       wall_time };
+    }
+  }
+  return best_anchor;
+}
+
+inline auto
+ticker_approximate_time_clock::query() -> sample
+{
+  return detail::ticker_approximate_time.nanoseconds.load(
+    std::memory_order_relaxed);
+}
+
+#if defined(__x86_64__)
+inline auto
+x86_tsc_clock::query() -> sample
+{
+  std::uint32_t eax;
+  std::uint32_t edx;
+  asm volatile("rdtsc" : "=a"(eax), "=d"(edx));
+  return (sample{ edx } << 32) | sample{ eax };
+}
+
+inline auto
+x86_tsc_clock::query_serialized() -> sample
+{
+  std::uint32_t eax;
+  std::uint32_t edx;
+  // The first lfence waits for earlier instructions to finish. The second
+  // lfence keeps later instructions from starting before rdtsc reads.
+  asm volatile("lfence\n"
+               "rdtsc\n"
+               "lfence"
+               : "=a"(eax), "=d"(edx)
+               :
+               : "memory");
+  return (sample{ edx } << 32) | sample{ eax };
+}
+#endif
 }
 
 #endif
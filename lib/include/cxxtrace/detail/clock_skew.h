@@ -0,0 +1,76 @@
+#ifndef CXXTRACE_DETAIL_CLOCK_SKEW_H
+#define CXXTRACE_DETAIL_CLOCK_SKEW_H
+
+#include <chrono>
+#include <cstddef>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/detail/processor.h>
+#include <cxxtrace/detail/snapshot_sample.h>
+#include <vector>
+
+namespace cxxtrace {
+namespace detail {
+using clock_skew_query_function = auto (*)(void* clock) -> time_point;
+using clock_skew_get_processor_id_function = auto (*)(void* context)
+  -> processor_id;
+
+auto
+measure_processor_clock_offsets(
+  void* clock,
+  clock_skew_query_function,
+  void* get_processor_id_context,
+  clock_skew_get_processor_id_function,
+  processor_id maximum_processor_id) noexcept(false)
+  -> std::vector<std::chrono::nanoseconds>;
+
+// Estimate the offset of each processor's clock relative to the clock of a
+// reference processor.
+//
+// measure_processor_clock_offsets pins a thread to each processor in turn and
+// exchanges messages with a thread pinned to the reference processor. Each
+// exchange yields an estimate of the offset (assuming the message latency is
+// symmetric), and the estimate from the fastest exchange wins.
+//
+// get_processor_id is called on each pinned thread and should return the ID of
+// the current processor (i.e. the ID used to index the result).
+//
+// The result has maximum_processor_id+1 entries. Processors which could not be
+// measured (e.g. because this process is not allowed to run on them) have an
+// offset of zero.
+template<class Clock, class GetProcessorID>
+auto
+measure_processor_clock_offsets(Clock& clock,
+                                processor_id maximum_processor_id,
+                                GetProcessorID get_processor_id) noexcept(false)
+  -> std::vector<std::chrono::nanoseconds>
+{
+  auto query = [](void* opaque_clock) -> time_point {
+    auto& clock = *static_cast<Clock*>(opaque_clock);
+    return clock.make_time_point(clock.query());
+  };
+  auto get_id = [](void* opaque_get_processor_id) -> processor_id {
+    return (*static_cast<GetProcessorID*>(opaque_get_processor_id))();
+  };
+  return measure_processor_clock_offsets(
+    &clock, query, &get_processor_id, get_id, maximum_processor_id);
+}
+
+auto
+subtract_clock_offset(snapshot_sample* begin,
+                      snapshot_sample* end,
+                      std::chrono::nanoseconds offset) noexcept -> void;
+
+// Subtract clock_offset from the timestamps of the samples taken from one
+// processor (samples[processor_samples_begin] onward), sort them by timestamp,
+// then merge them with the samples before them.
+//
+// The samples before processor_samples_begin must be sorted by timestamp.
+// Samples with equal timestamps keep their relative order.
+auto
+merge_processor_samples(std::vector<snapshot_sample>& samples,
+                        std::size_t processor_samples_begin,
+                        std::chrono::nanoseconds clock_offset) noexcept -> void;
+}
+}
+
+#endif
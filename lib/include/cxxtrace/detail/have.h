@@ -134,12 +134,42 @@
 #define CXXTRACE_HAVE_CLOCK_GETTIME 1
 #endif
 
+#if defined(__linux__) && defined(_GNU_SOURCE)
+// ::clock_getres
+// <time.h>
+// CLOCK_BOOTTIME
+// CLOCK_MONOTONIC_COARSE
+// CLOCK_MONOTONIC_RAW
+#define CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS 1
+#endif
+
 #if defined(__linux__) && defined(_GNU_SOURCE)
 // ::sched_getcpu(...)
 // <sched.h>
 #define CXXTRACE_HAVE_SCHED_GETCPU 1
 #endif
 
+#if defined(__linux__) && defined(_GNU_SOURCE)
+// ::pthread_setaffinity_np(...)
+// ::sched_getaffinity(...)
+// <pthread.h>
+// <sched.h>
+// CPU_ISSET
+// CPU_SET
+// CPU_SETSIZE
+// CPU_ZERO
+#define CXXTRACE_HAVE_SCHED_SETAFFINITY 1
+#endif
+
+#if defined(__linux__) && defined(__x86_64__)
+// ::syscall(SYS_perf_event_open, ...)
+// <linux/perf_event.h>
+// <sys/mman.h>
+// <sys/syscall.h>
+// rdpmc
+#define CXXTRACE_HAVE_LINUX_PERF_EVENT 1
+#endif
+
 // ::abi::cxa_demangle(...)
 // <cxxabi.h>
 #define CXXTRACE_HAVE_CXA_DEMANGLE 1
@@ -2,150 +2,210 @@
 #define CXXTRACE_DETAIL_MPSC_RING_QUEUE_H
 
 #include <algorithm>
-#include <array>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cxxtrace/detail/add.h>
 #include <cxxtrace/detail/debug_source_location.h>
 #include <cxxtrace/detail/molecular.h>
 #include <cxxtrace/detail/real_synchronization.h>
+#include <cxxtrace/detail/ring_buffer.h>
+#include <cxxtrace/ring_queue_overflow_policy.h>
 #include <limits>
 #include <optional>
-#include <type_traits> // IWYU pragma: keep
+#include <type_traits>
 #include <utility>
 
 namespace cxxtrace {
 namespace detail {
-enum class mpsc_ring_queue_push_result : bool
-{
-  not_pushed_due_to_contention = false,
-  pushed = true,
-};
-
-// A special-purpose, lossy, bounded, MPSC FIFO container optimized for
-// uncontended writes.
+// A special-purpose, lossy, bounded, MPSC FIFO container whose writers never
+// wait for each other.
 //
 // Special-purpose: Items in a mpsc_ring_queue must be trivial. Constructors and
 // destructors are not called on a mpsc_ring_queue's items.
 //
-// Lossy: If a writer pushes too many items, older items are discarded.
+// Lossy: If a writer pushes too many items, older items are discarded. If
+// Overflow is ring_queue_overflow_policy::drop_newest, the pushed items are
+// discarded instead. pop_all_into reports how many items were discarded.
 //
 // Bounded: The maximum number of items allowed in a mpsc_ring_queue is fixed.
-// Operations on a mpsc_ring_queue will never allocate memory.
+// If Capacity is dynamic_capacity, the maximum is chosen when the
+// mpsc_ring_queue is constructed. Operations on a mpsc_ring_queue will
+// never allocate memory.
 //
 // MPSC: Zero or more threads can push items ("Multiple Producer"), and one
 // thread can pop items ("Single Consumer").
 //
 // FIFO: Items are read First In, First Out.
 //
-// TODO(strager): Add an API for the reader to detect when items are discarded.
+// If Overflow is overwrite_oldest, push is wait-free: a writer reserves items
+// with a single fetch_add, then claims and commits each item's slot through a
+// per-slot sequence number. (If Overflow is drop_newest, push is lock-free.)
+// The reader stops at the first item which has not been committed yet, so a
+// writer which is preempted in the middle of a push delays only the reader
+// (and only for items pushed after its own), never other writers. If a writer
+// is so slow that other writers wrap around the entire queue during its push,
+// a push which would overwrite the slow writer's items drops all of its items
+// (never only some of them), and the reader counts the dropped items as
+// discarded.
+//
+// Index counts every item ever pushed, and pushing aborts the program if the
+// count would overflow Index. The default, std::uint64_t, lets a writer push
+// a billion items per second for centuries.
 //
 // @see processor_local_mpsc_ring_queue
 // @see ring_queue
 // @see spsc_ring_queue
 template<class T,
          std::size_t Capacity,
-         class Index = int,
-         class Sync = real_synchronization>
+         class Index = std::uint64_t,
+         class Sync = real_synchronization,
+         ring_queue_overflow_policy Overflow =
+           ring_queue_overflow_policy::overwrite_oldest>
 class mpsc_ring_queue
 {
 public:
-  static_assert(Capacity > 0);
   static_assert(std::is_integral_v<Index>, "Index must be an integral type");
   static_assert(
-    std::numeric_limits<Index>::max() >= Capacity - 1,
+    Capacity == dynamic_capacity ||
+      std::numeric_limits<Index>::max() >= Capacity - 1,
     "Index must be able to contain non-negative integers less than Capacity");
   static_assert(std::is_trivial_v<T>, "T must be a trivial type");
 
   using size_type = Index;
   using value_type = T;
-  using push_result = mpsc_ring_queue_push_result;
 
+  // The maximum number of items, or dynamic_capacity if the capacity is chosen
+  // at run time.
+  //
+  // @see get_capacity
   static inline constexpr const auto capacity = size_type{ Capacity };
 
+  template<std::size_t C = Capacity,
+           class = std::enable_if_t<C != dynamic_capacity>>
+  mpsc_ring_queue() noexcept
+  {
+    this->reset_slot_sequences();
+  }
+
+  // Create a queue which holds at least minimum_capacity items, rounded up to
+  // a power of two. Capacity must be dynamic_capacity.
+  template<std::size_t C = Capacity,
+           class = std::enable_if_t<C == dynamic_capacity>>
+  explicit mpsc_ring_queue(size_type minimum_capacity) noexcept(
+    false)
+    : storage{ static_cast<std::size_t>(minimum_capacity) }
+    , slot_sequences{ static_cast<std::size_t>(minimum_capacity) }
+    , skipped_sequences{ static_cast<std::size_t>(minimum_capacity) }
+  {
+    assert(this->storage.capacity() - 1 <=
+           static_cast<std::size_t>(std::numeric_limits<size_type>::max()));
+    this->reset_slot_sequences();
+  }
+
+  auto get_capacity() const noexcept -> size_type
+  {
+    return static_cast<size_type>(this->storage.capacity());
+  }
+
   auto reset() noexcept -> void
   {
     this->read_vindex.store(0, CXXTRACE_HERE);
-    this->write_begin_vindex.store(0, CXXTRACE_HERE);
     this->write_end_vindex.store(0, CXXTRACE_HERE);
+    this->cached_read_vindex.store(0, CXXTRACE_HERE);
+    this->dropped_item_count.store(0, CXXTRACE_HERE);
+    this->reported_dropped_item_count.store(0, CXXTRACE_HERE);
+    this->reset_slot_sequences();
   }
 
+  // If Overflow is drop_newest and the queue is full, or if another writer
+  // owns any of the items' slots, push discards all of the items without
+  // calling write.
   template<class WriterFunction>
-  auto try_push(size_type count, WriterFunction&& write) noexcept -> push_result
+  auto push(size_type count, WriterFunction&& write) noexcept -> void
   {
-    auto vindexes = this->begin_push(count);
-    if (!vindexes.has_value()) {
-      return push_result::not_pushed_due_to_contention;
+    auto begin_vindex = this->begin_push(count);
+    if (!begin_vindex.has_value()) {
+      // begin_push dropped the items.
+      return;
     }
-    auto [begin_vindex, end_vindex] = *vindexes;
-    write(push_handle{ this->storage, begin_vindex });
-    this->end_push(end_vindex);
-    return push_result::pushed;
+    if (!this->claim_slots(*begin_vindex, count)) {
+      this->release_slots(*begin_vindex, count);
+      return;
+    }
+    write(push_handle{ *this, *begin_vindex });
+    this->end_push(*begin_vindex, count);
   }
 
+  // Move all committed items into output, and return the number of items
+  // which were discarded (i.e. overwritten by writers before they could be
+  // popped, dropped by writers which lost a race for their slots, or dropped
+  // because the queue was full) since the previous call to pop_all_into or
+  // reset.
+  //
+  // pop_all_into stops at the first item whose writer has not committed it
+  // yet. Later calls to pop_all_into return the remaining items.
   template<class Sink>
-  auto pop_all_into(Sink&& output) -> void
+  auto pop_all_into(Sink&& output) -> size_type
   {
-    // TODO(strager): Consolidate duplication with spsc_ring_queue.
+    if constexpr (Overflow == ring_queue_overflow_policy::drop_newest) {
+      return this->pop_all_without_overwrites_into(output);
+    }
+
     // TODO(strager): Relax memory ordering as appropriate.
     auto read_vindex = this->read_vindex.load(CXXTRACE_HERE);
+    const auto write_end_vindex = this->write_end_vindex.load(CXXTRACE_HERE);
+    assert(read_vindex <= write_end_vindex);
 
-    auto get_begin_vindex = [&read_vindex](
-                              size_type write_end_vindex) noexcept->size_type
-    {
-      if (write_end_vindex > capacity) {
-        return std::max(static_cast<size_type>(write_end_vindex - capacity),
+    auto capacity = this->get_capacity();
+    auto vindex = read_vindex;
+    if (write_end_vindex > capacity) {
+      vindex = std::max(static_cast<size_type>(write_end_vindex - capacity),
                         read_vindex);
-      } else {
-        return read_vindex;
-      }
-    };
-
-    auto begin_vindex = size_type{};
-    auto end_vindex = size_type{};
-    {
-      const auto write_begin_vindex =
-        this->write_begin_vindex.load(CXXTRACE_HERE);
-      const auto write_end_vindex = this->write_end_vindex.load(CXXTRACE_HERE);
-      assert(read_vindex <= write_end_vindex);
-      assert(write_begin_vindex <= write_end_vindex);
-
-      begin_vindex = get_begin_vindex(write_end_vindex);
-      end_vindex = write_begin_vindex;
-      output.reserve_back(end_vindex - begin_vindex);
-      for (auto i = begin_vindex; i < end_vindex; ++i) {
-        output.push_back(this->storage[i % this->capacity].load(CXXTRACE_HERE));
-      }
     }
-    auto output_item_count = end_vindex - begin_vindex;
-
-    if (output_item_count > 0) {
-      // FIXME(strager): This fence (and the fence in begin_push) should be
-      // redundant. Why does
-      // ring_queue_overflow_drops_some_but_not_all_items_relacy_test fail with
-      // CDSChecker without this fence? Doesn't the implicitly-seq_cst
-      // compare_exchange_strong enforce acq_rel ordering already?
-      Sync::atomic_thread_fence(std::memory_order_acq_rel, CXXTRACE_HERE);
-
-      {
-        const auto write_end_vindex =
-          this->write_end_vindex.load(CXXTRACE_HERE);
-        if (write_end_vindex != end_vindex) {
-          // push was called concurrently. Undo potentially-corrupted reads in
-          // the output.
-          auto new_begin_vindex = get_begin_vindex(write_end_vindex);
-          assert(new_begin_vindex >= begin_vindex);
-          auto items_to_unoutput =
-            std::min(new_begin_vindex - begin_vindex, output_item_count);
-          output.pop_front_n(items_to_unoutput);
+    auto discarded_item_count = static_cast<size_type>(vindex - read_vindex);
+    auto output_item_count = size_type{ 0 };
+    output.reserve_back(write_end_vindex - vindex);
+    for (; vindex < write_end_vindex; ++vindex) {
+      auto& slot = this->slot_sequences[vindex];
+      auto sequence = slot.load(std::memory_order_acquire, CXXTRACE_HERE);
+      if (sequence == committed_sequence(vindex)) {
+        auto item = this->storage[vindex].load(CXXTRACE_HERE);
+        // Pairs with the fence in claim_slots. If a writer of a newer item
+        // overwrote the item while we read it, we see that writer's claim
+        // below.
+        Sync::atomic_thread_fence(std::memory_order_acquire, CXXTRACE_HERE);
+        sequence = slot.load(std::memory_order_relaxed, CXXTRACE_HERE);
+        if (sequence == committed_sequence(vindex)) {
+          output.push_back(std::move(item));
+          output_item_count += 1;
+          continue;
         }
       }
+      if (sequence == released_sequence(vindex)) {
+        // The item's writer failed to claim another slot of its push, so it
+        // dropped the item.
+        discarded_item_count += 1;
+      } else if (sequence > committed_sequence(vindex)) {
+        // A writer claimed this slot for a newer item, so this item and the
+        // items before it were overwritten.
+        output.pop_front_n(output_item_count);
+        discarded_item_count += output_item_count + 1;
+        output_item_count = 0;
+      } else if (this->is_skipped(vindex)) {
+        // The item's writer lost the race for the slot and dropped the item.
+        discarded_item_count += 1;
+      } else {
+        // The item's writer has not committed it yet.
+        break;
+      }
     }
 
-    this->read_vindex.store(end_vindex, CXXTRACE_HERE);
+    this->read_vindex.store(vindex, CXXTRACE_HERE);
+    return discarded_item_count;
   }
 
 private:
@@ -154,60 +214,327 @@ private:
   template<class U>
   using nonatomic = typename Sync::template nonatomic<U>;
 
+  // Align storage like value_type so items which tile cache lines (such as
+  // sample_record-s) are not split across cache lines.
+  using storage_type =
+    ring_buffer<molecular<value_type, Sync>, Capacity, alignof(value_type)>;
+
+  // The state of a slot in storage:
+  //
+  // * 0: No item has been written into the slot.
+  // * writing_sequence(vindex): A writer claimed the slot for the item at
+  //   vindex, and might be writing the item.
+  // * released_sequence(vindex): A writer claimed the slot for the item at
+  //   vindex, but dropped the item without writing it.
+  // * committed_sequence(vindex): The item at vindex has been written.
+  //
+  // A slot's sequence only increases, except when the queue is reset.
+  using slot_sequence = std::uint64_t;
+
+  // Slot sequences are stored separately from items so items which tile cache
+  // lines keep doing so.
+  using slot_sequences_type = ring_buffer<atomic<slot_sequence>, Capacity>;
+
+  // For each slot, writing_sequence(vindex) of the newest item which was
+  // dropped because its writer could not claim the slot, or 0.
+  using skipped_sequences_type = ring_buffer<atomic<slot_sequence>, Capacity>;
+
   class push_handle
   {
   public:
     auto set(size_type index, T value) noexcept -> void
     {
-      this->storage[(this->write_begin_vindex + index) % capacity].store(
-        std::move(value), CXXTRACE_HERE);
+      auto vindex = static_cast<size_type>(this->write_begin_vindex + index);
+      this->queue.storage[vindex].store(std::move(value), CXXTRACE_HERE);
     }
 
   private:
-    explicit push_handle(
-      std::array<molecular<value_type, Sync>, capacity>& storage,
-      size_type write_begin_vindex) noexcept
-      : storage{ storage }
+    explicit push_handle(mpsc_ring_queue& queue,
+                         size_type write_begin_vindex) noexcept
+      : queue{ queue }
       , write_begin_vindex{ write_begin_vindex }
     {}
 
-    std::array<molecular<value_type, Sync>, capacity>& storage;
+    mpsc_ring_queue& queue;
     size_type write_begin_vindex{ 0 };
 
     friend class mpsc_ring_queue;
   };
 
-  auto begin_push(size_type count) noexcept
-    -> std::optional<std::pair<size_type, size_type>>
+  static auto writing_sequence(size_type vindex) noexcept -> slot_sequence
+  {
+    return static_cast<slot_sequence>(vindex) * 3 + 1;
+  }
+
+  static auto released_sequence(size_type vindex) noexcept -> slot_sequence
+  {
+    return static_cast<slot_sequence>(vindex) * 3 + 2;
+  }
+
+  static auto committed_sequence(size_type vindex) noexcept -> slot_sequence
+  {
+    return static_cast<slot_sequence>(vindex) * 3 + 3;
+  }
+
+  static auto is_writing(slot_sequence sequence) noexcept -> bool
+  {
+    return sequence % 3 == 1;
+  }
+
+  // Reserve count items and return the first item's vindex.
+  //
+  // If Overflow is drop_newest and the reader has not popped enough items to
+  // make room, count the items as dropped and return nullopt.
+  auto begin_push(size_type count) noexcept -> std::optional<size_type>
   {
     assert(count > 0);
-    assert(count < this->capacity);
+    assert(count < this->get_capacity());
 
-    auto write_begin_vindex =
-      this->write_begin_vindex.load(std::memory_order_seq_cst, CXXTRACE_HERE);
-    auto maybe_new_write_end_vindex = add(write_begin_vindex, count);
-    if (!maybe_new_write_end_vindex.has_value()) {
-      this->abort_due_to_overflow();
+    if constexpr (Overflow == ring_queue_overflow_policy::drop_newest) {
+      // Reserving and checking for room must happen atomically, so retry if
+      // another writer reserved items first. Unlike a lock, a failed
+      // compare_exchange means some writer made progress.
+      auto write_begin_vindex =
+        this->write_end_vindex.load(std::memory_order_relaxed, CXXTRACE_HERE);
+      for (;;) {
+        auto new_write_end_vindex = add(write_begin_vindex, count);
+        if (!new_write_end_vindex.has_value()) {
+          this->abort_due_to_overflow();
+        }
+        if (!this->has_room_for(*new_write_end_vindex)) {
+          this->dropped_item_count.fetch_add(
+            count, std::memory_order_relaxed, CXXTRACE_HERE);
+          return std::nullopt;
+        }
+        if (this->write_end_vindex.compare_exchange_strong(
+              write_begin_vindex,
+              *new_write_end_vindex,
+              std::memory_order_relaxed,
+              std::memory_order_relaxed,
+              CXXTRACE_HERE)) {
+          return write_begin_vindex;
+        }
+      }
+    } else {
+      auto write_begin_vindex =
+        this->write_end_vindex.fetch_add(count, CXXTRACE_HERE);
+      if (!add(write_begin_vindex, count).has_value()) {
+        this->abort_due_to_overflow();
+      }
+      return write_begin_vindex;
     }
-    if (!this->write_end_vindex.compare_exchange_strong(
-          write_begin_vindex, *maybe_new_write_end_vindex, CXXTRACE_HERE)) {
-      return std::nullopt;
+  }
+
+  // Return whether the reader has popped enough items for the queue to hold
+  // every item before new_write_end_vindex.
+  //
+  // The reader's index is cached, so has_room_for usually does not touch the
+  // reader's cache line.
+  auto has_room_for(size_type new_write_end_vindex) noexcept -> bool
+  {
+    auto capacity = this->get_capacity();
+    // Writers publish cached_read_vindex with release semantics, so a writer
+    // which uses another writer's cached index also sees the reader's pops.
+    auto cached_read_vindex =
+      this->cached_read_vindex.load(std::memory_order_acquire, CXXTRACE_HERE);
+    if (new_write_end_vindex - cached_read_vindex <= capacity) {
+      return true;
+    }
+    cached_read_vindex =
+      this->read_vindex.load(std::memory_order_acquire, CXXTRACE_HERE);
+    // A racing writer might store an older index. That is harmless: an older
+    // index only makes has_room_for reload read_vindex sooner.
+    this->cached_read_vindex.store(
+      cached_read_vindex, std::memory_order_release, CXXTRACE_HERE);
+    return new_write_end_vindex - cached_read_vindex <= capacity;
+  }
+
+  // Claim the slots for count items starting at write_begin_vindex, and
+  // return whether every slot was claimed. If not, the caller must release the
+  // slots which were claimed.
+  auto claim_slots(size_type write_begin_vindex, size_type count) noexcept
+    -> bool
+  {
+    if constexpr (Overflow == ring_queue_overflow_policy::drop_newest) {
+      // begin_push made room, so no other writer uses these slots.
+      static_cast<void>(write_begin_vindex);
+      static_cast<void>(count);
+      return true;
+    } else {
+      // Keep claiming after a failure, so each slot is either claimed (and
+      // later committed or released) or left to another writer.
+      auto claimed_all_slots = true;
+      for (auto i = size_type{ 0 }; i < count; ++i) {
+        auto vindex = static_cast<size_type>(write_begin_vindex + i);
+        if (!this->try_claim(vindex)) {
+          claimed_all_slots = false;
+        }
+      }
+
+      // Pairs with the fence in pop_all_into. If the reader reads an item we
+      // write, it will see our claim and discard the item it read.
+      Sync::atomic_thread_fence(std::memory_order_acq_rel, CXXTRACE_HERE);
+
+      return claimed_all_slots;
+    }
+  }
+
+  auto end_push(size_type write_begin_vindex, size_type count) noexcept
+    -> void
+  {
+    // Commit the first item last. If the reader sees the first item, it sees
+    // the rest of the push too.
+    for (auto i = count; i > 0; --i) {
+      auto vindex = static_cast<size_type>(write_begin_vindex + i - 1);
+      this->slot_sequences[vindex].store(committed_sequence(vindex),
+                                         std::memory_order_release,
+                                         CXXTRACE_HERE);
+    }
+  }
+
+  // Drop the items of a push which failed to claim some of its slots. Slots
+  // which were claimed are handed back without being written, so the reader
+  // steps past them and later writers can claim them.
+  auto release_slots(size_type write_begin_vindex, size_type count) noexcept
+    -> void
+  {
+    for (auto i = size_type{ 0 }; i < count; ++i) {
+      auto vindex = static_cast<size_type>(write_begin_vindex + i);
+      if (this->is_claimed(vindex)) {
+        this->slot_sequences[vindex].store(released_sequence(vindex),
+                                           std::memory_order_release,
+                                           CXXTRACE_HERE);
+      }
+    }
+  }
+
+  // Claim the slot for the item at vindex, unless a writer of a newer item
+  // claimed the slot first or another writer is still writing into the slot.
+  //
+  // Claiming prevents a slow writer from overwriting a newer item. It never
+  // waits, so a push which loses a race for a slot drops that item. If the
+  // slot still holds an older item, the dropped item is marked as skipped so
+  // the reader does not wait for it.
+  auto try_claim(size_type vindex) noexcept -> bool
+  {
+    auto& sequence = this->slot_sequences[vindex];
+    // Usually, the slot holds the item pushed one lap earlier. If that item was
+    // released instead, the compare_exchange below fails once and retries.
+    auto capacity = this->get_capacity();
+    auto old_sequence =
+      vindex >= capacity
+        ? committed_sequence(static_cast<size_type>(vindex - capacity))
+        : slot_sequence{ 0 };
+    // Each retry sees a newer sequence, so this loop ends after a few
+    // iterations.
+    for (;;) {
+      if (sequence.compare_exchange_strong(old_sequence,
+                                           writing_sequence(vindex),
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed,
+                                           CXXTRACE_HERE)) {
+        return true;
+      }
+      if (old_sequence > writing_sequence(vindex)) {
+        // The reader sees the newer item's sequence and discards our item.
+        return false;
+      }
+      if (is_writing(old_sequence)) {
+        this->mark_skipped(vindex);
+        return false;
+      }
+    }
+  }
+
+  // Record that the item at vindex was dropped. A writer which failed to claim
+  // the slot for a newer item might have marked the slot already, so keep the
+  // newer mark.
+  auto mark_skipped(size_type vindex) noexcept -> void
+  {
+    auto& skipped_sequence = this->skipped_sequences[vindex];
+    auto old_skipped_sequence =
+      skipped_sequence.load(std::memory_order_relaxed, CXXTRACE_HERE);
+    // Each retry sees a newer mark, so this loop ends after a few iterations.
+    while (old_skipped_sequence < writing_sequence(vindex)) {
+      if (skipped_sequence.compare_exchange_strong(old_skipped_sequence,
+                                                   writing_sequence(vindex),
+                                                   std::memory_order_relaxed,
+                                                   std::memory_order_relaxed,
+                                                   CXXTRACE_HERE)) {
+        break;
+      }
     }
+  }
+
+  // Return whether the reader should step past the item at vindex instead of
+  // waiting for its writer to commit it.
+  //
+  // A mark for a newer item means that a writer lapped the item at vindex, so
+  // the item is stale even if its writer commits it later.
+  auto is_skipped(size_type vindex) const noexcept -> bool
+  {
+    return this->skipped_sequences[vindex].load(std::memory_order_relaxed,
+                                                CXXTRACE_HERE) >=
+           writing_sequence(vindex);
+  }
+
+  // Return whether the calling writer claimed the slot for the item at
+  // vindex. Only the claiming writer can change a claimed slot's sequence.
+  auto is_claimed(size_type vindex) const noexcept -> bool
+  {
+    return this->slot_sequences[vindex].load(std::memory_order_relaxed,
+                                             CXXTRACE_HERE) ==
+           writing_sequence(vindex);
+  }
 
-    // FIXME(strager): This fence (and the fence in pop_all_into) should be
-    // redundant. Why does
-    // ring_queue_overflow_drops_some_but_not_all_items_relacy_test fail with
-    // CDSChecker without this fence? Doesn't the implicitly-seq_cst
-    // compare_exchange_strong enforce acq_rel ordering already?
-    Sync::atomic_thread_fence(std::memory_order_acq_rel, CXXTRACE_HERE);
+  auto is_committed(size_type vindex) const noexcept -> bool
+  {
+    return this->slot_sequences[vindex].load(std::memory_order_acquire,
+                                             CXXTRACE_HERE) ==
+           committed_sequence(vindex);
+  }
 
-    return std::pair{ write_begin_vindex, *maybe_new_write_end_vindex };
+  // Like reset, slot sequences must not be reset while other threads use the
+  // queue.
+  auto reset_slot_sequences() noexcept -> void
+  {
+    for (auto i = std::size_t{ 0 }; i < this->slot_sequences.capacity(); ++i) {
+      this->slot_sequences[i].store(
+        0, std::memory_order_relaxed, CXXTRACE_HERE);
+      this->skipped_sequences[i].store(
+        0, std::memory_order_relaxed, CXXTRACE_HERE);
+    }
   }
 
-  auto end_push(size_type write_end_vindex) noexcept -> void
+  // Like pop_all_into, but for queues whose writers never overwrite items
+  // which have not been popped.
+  template<class Sink>
+  auto pop_all_without_overwrites_into(Sink& output) -> size_type
   {
-    this->write_begin_vindex.store(
-      write_end_vindex, std::memory_order_release, CXXTRACE_HERE);
+    auto read_vindex = this->read_vindex.load(CXXTRACE_HERE);
+    auto write_end_vindex =
+      this->write_end_vindex.load(std::memory_order_relaxed, CXXTRACE_HERE);
+    assert(read_vindex <= write_end_vindex);
+    output.reserve_back(write_end_vindex - read_vindex);
+    auto end_vindex = read_vindex;
+    for (; end_vindex < write_end_vindex; ++end_vindex) {
+      if (!this->is_committed(end_vindex)) {
+        break;
+      }
+      output.push_back(this->storage[end_vindex].load(CXXTRACE_HERE));
+    }
+    // Release the popped items' slots to writers.
+    this->read_vindex.store(
+      end_vindex, std::memory_order_release, CXXTRACE_HERE);
+
+    auto dropped_item_count =
+      this->dropped_item_count.load(std::memory_order_relaxed, CXXTRACE_HERE);
+    auto reported_dropped_item_count =
+      this->reported_dropped_item_count.load(CXXTRACE_HERE);
+    auto discarded_item_count =
+      static_cast<size_type>(dropped_item_count - reported_dropped_item_count);
+    this->reported_dropped_item_count.store(dropped_item_count, CXXTRACE_HERE);
+    return discarded_item_count;
   }
 
   [[noreturn]] auto abort_due_to_overflow() const noexcept -> void
@@ -217,12 +544,18 @@ private:
   }
 
   // 'vindex' is an abbreviation for 'virtual index'.
-  nonatomic<size_type> read_vindex{ 0 };
-  atomic<size_type> write_begin_vindex{ 0 };
+  atomic<size_type> read_vindex{ 0 };
   atomic<size_type> write_end_vindex{ 0 };
 
-  std::array<molecular<value_type, Sync>, capacity> storage
-    /* uninitialized */;
+  // Used only if Overflow is drop_newest. reported_dropped_item_count is
+  // accessed only by the reader.
+  atomic<size_type> cached_read_vindex{ 0 };
+  atomic<size_type> dropped_item_count{ 0 };
+  nonatomic<size_type> reported_dropped_item_count{ 0 };
+
+  storage_type storage;
+  slot_sequences_type slot_sequences;
+  skipped_sequences_type skipped_sequences;
 };
 }
 }
@@ -0,0 +1,45 @@
+#ifndef CXXTRACE_DETAIL_PERF_EVENT_H
+#define CXXTRACE_DETAIL_PERF_EVENT_H
+
+#include <cstdint>
+#include <cxxtrace/detail/file_descriptor.h>
+#include <cxxtrace/detail/have.h>
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+struct perf_event_mmap_page;
+#endif
+
+namespace cxxtrace {
+namespace detail {
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+// A Linux perf event counting for the current thread, with the event's
+// perf_event_mmap_page mapped into memory.
+class thread_perf_event
+{
+public:
+  // Count the event identified by type and config (see perf_event_attr in
+  // <linux/perf_event.h>) in user mode. If group_leader is given, the event is
+  // scheduled onto the processor together with group_leader.
+  explicit thread_perf_event(std::uint32_t type,
+                             std::uint64_t config,
+                             const thread_perf_event* group_leader) noexcept(
+    false);
+
+  thread_perf_event(const thread_perf_event&) = delete;
+  thread_perf_event& operator=(const thread_perf_event&) = delete;
+
+  ~thread_perf_event() noexcept;
+
+  auto page() const noexcept -> const ::perf_event_mmap_page*;
+
+  auto read_with_system_call() noexcept(false) -> std::uint64_t;
+
+private:
+  file_descriptor event{};
+  ::perf_event_mmap_page* page_{ nullptr };
+};
+#endif
+}
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef CXXTRACE_DETAIL_RING_BUFFER_H
+#define CXXTRACE_DETAIL_RING_BUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cxxtrace/dynamic_capacity.h>
+#include <limits>
+#include <memory>
+#include <new>
+
+namespace cxxtrace {
+namespace detail {
+// Storage for a ring queue's items, indexed by virtual index (an index which
+// wraps around the end of the storage).
+//
+// If Capacity is dynamic_capacity, the storage is allocated on the heap when
+// the ring_buffer is constructed, and its capacity is rounded up to a power of
+// two so a virtual index can be wrapped with a mask instead of a division.
+// Otherwise, the storage is stored inline.
+//
+// Item storage is aligned to at least Alignment bytes.
+template<class T, std::size_t Capacity, std::size_t Alignment = alignof(T)>
+class ring_buffer
+{
+public:
+  static_assert(Capacity > 0);
+
+  auto capacity() const noexcept -> std::size_t { return Capacity; }
+
+  auto operator[](std::size_t vindex) noexcept -> T&
+  {
+    return this->storage[vindex % Capacity];
+  }
+
+  auto operator[](std::size_t vindex) const noexcept -> const T&
+  {
+    return this->storage[vindex % Capacity];
+  }
+
+private:
+  alignas(Alignment) alignas(T) std::array<T, Capacity> storage
+    /* uninitialized */;
+};
+
+template<class T, std::size_t Alignment>
+class ring_buffer<T, dynamic_capacity, Alignment>
+{
+public:
+  static constexpr auto alignment = std::max(Alignment, alignof(T));
+
+  // Allocate storage for at least minimum_capacity items.
+  explicit ring_buffer(std::size_t minimum_capacity) noexcept(false)
+    : mask{ round_up_to_power_of_two(minimum_capacity) - 1 }
+    , storage{ allocate(this->capacity()) }
+  {}
+
+  ~ring_buffer() noexcept
+  {
+    std::destroy_n(this->storage, this->capacity());
+    ::operator delete(this->storage, std::align_val_t{ alignment });
+  }
+
+  ring_buffer(const ring_buffer&) = delete;
+  ring_buffer& operator=(const ring_buffer&) = delete;
+  ring_buffer(ring_buffer&&) = delete;
+  ring_buffer& operator=(ring_buffer&&) = delete;
+
+  auto capacity() const noexcept -> std::size_t { return this->mask + 1; }
+
+  auto operator[](std::size_t vindex) noexcept -> T&
+  {
+    return this->storage[vindex & this->mask];
+  }
+
+  auto operator[](std::size_t vindex) const noexcept -> const T&
+  {
+    return this->storage[vindex & this->mask];
+  }
+
+private:
+  static auto round_up_to_power_of_two(std::size_t n) noexcept -> std::size_t
+  {
+    assert(n > 0);
+    assert(n <= std::numeric_limits<std::size_t>::max() / 2 + 1);
+    auto result = std::size_t{ 1 };
+    while (result < n) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  static auto allocate(std::size_t capacity) noexcept(false) -> T*
+  {
+    auto* storage = static_cast<T*>(
+      ::operator new(capacity * sizeof(T), std::align_val_t{ alignment }));
+    std::uninitialized_default_construct_n(storage, capacity);
+    return storage;
+  }
+
+  std::size_t mask;
+  T* storage;
+};
+}
+}
+
+#endif
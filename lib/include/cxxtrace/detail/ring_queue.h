@@ -2,14 +2,15 @@
 #define CXXTRACE_DETAIL_RING_QUEUE_H
 
 #include <algorithm>
-#include <array>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cxxtrace/detail/add.h>
+#include <cxxtrace/detail/ring_buffer.h>
 #include <limits>
-#include <type_traits> // IWYU pragma: keep
+#include <type_traits>
 #include <utility>
 
 namespace cxxtrace {
@@ -20,33 +21,60 @@ namespace detail {
 // destructors are not called on a ring_queue's items.
 //
 // Lossy: If a writer pushes too many items, older items are discarded.
+// pop_all_into reports how many items were discarded.
 //
 // Bounded: The maximum number of items allowed in a ring_queue is fixed.
-// Operations on a ring_queue will never allocate memory.
+// If Capacity is dynamic_capacity, the maximum is chosen when the
+// ring_queue is constructed. Operations on a ring_queue will never allocate
+// memory.
 //
 // FIFO: Items are read First In, First Out.
 //
-// ring_queue is not thread-safe.
+// Index counts every item ever pushed, and pushing aborts the program if the
+// count would overflow Index. The default, std::uint64_t, lets a writer push
+// a billion items per second for centuries.
 //
-// TODO(strager): Add an API for the reader to detect when items are discarded.
+// ring_queue is not thread-safe.
 //
 // @see spsc_ring_queue
-template<class T, std::size_t Capacity, class Index = int>
+template<class T, std::size_t Capacity, class Index = std::uint64_t>
 class ring_queue
 {
 public:
-  static_assert(Capacity > 0);
   static_assert(std::is_integral_v<Index>, "Index must be an integral type");
   static_assert(
-    std::numeric_limits<Index>::max() >= Capacity - 1,
+    Capacity == dynamic_capacity ||
+      std::numeric_limits<Index>::max() >= Capacity - 1,
     "Index must be able to contain non-negative integers less than Capacity");
   static_assert(std::is_trivial_v<T>, "T must be a trivial type");
 
   using size_type = Index;
   using value_type = T;
 
+  // The maximum number of items, or dynamic_capacity if the capacity is chosen
+  // at run time.
+  //
+  // @see get_capacity
   static inline constexpr const auto capacity = size_type{ Capacity };
 
+  ring_queue() noexcept = default;
+
+  // Create a queue which holds at least minimum_capacity items, rounded up to
+  // a power of two. Capacity must be dynamic_capacity.
+  template<std::size_t C = Capacity,
+           class = std::enable_if_t<C == dynamic_capacity>>
+  explicit ring_queue(size_type minimum_capacity) noexcept(false)
+    : storage{ static_cast<std::size_t>(minimum_capacity) }
+  {
+    assert(this->storage.capacity() - 1 <=
+           static_cast<std::size_t>(std::numeric_limits<size_type>::max()));
+  }
+
+  auto get_capacity() const noexcept -> size_type
+  {
+    return static_cast<size_type>(this->storage.capacity());
+  }
+
   template<class WriterFunction>
   auto push(size_type count, WriterFunction&& write) noexcept -> void
   {
@@ -60,11 +88,15 @@ public:
     this->write_vindex = 0;
   }
 
+  // Move all items into output, and return the number of items which were
+  // discarded (i.e. overwritten by writers before they could be popped) since
+  // the previous call to pop_all_into or reset.
   template<class Sink>
-  auto pop_all_into(Sink&& output) -> void
+  auto pop_all_into(Sink&& output) -> size_type
   {
     assert(this->read_vindex <= this->write_vindex);
 
+    auto capacity = this->get_capacity();
     auto begin_vindex = size_type{};
     if (this->write_vindex > capacity) {
       begin_vindex =
@@ -75,30 +107,36 @@ public:
     }
     auto end_vindex = this->write_vindex;
 
+    auto discarded_item_count =
+      static_cast<size_type>(begin_vindex - this->read_vindex);
+
     output.reserve_back(end_vindex - begin_vindex);
     for (auto i = begin_vindex; i < end_vindex; ++i) {
-      output.push_back(this->storage[i % this->capacity]);
+      output.push_back(this->storage[i]);
     }
     this->read_vindex = end_vindex;
+    return discarded_item_count;
   }
 
 private:
+  using storage_type = ring_buffer<value_type, Capacity>;
+
   class push_handle
   {
   public:
     auto set(size_type index, T value) noexcept -> void
     {
-      this->storage[(this->write_vindex + index) % capacity] = std::move(value);
+      this->storage[this->write_vindex + index] = std::move(value);
     }
 
   private:
-    explicit push_handle(std::array<value_type, capacity>& storage,
+    explicit push_handle(storage_type& storage,
                          size_type write_vindex) noexcept
       : storage{ storage }
       , write_vindex{ write_vindex }
     {}
 
-    std::array<value_type, capacity>& storage;
+    storage_type& storage;
     size_type write_vindex{ 0 };
 
     friend class ring_queue;
@@ -107,7 +145,7 @@ private:
   auto begin_push(size_type count) noexcept -> size_type
   {
     assert(count > 0);
-    assert(count < this->capacity);
+    assert(count < this->get_capacity());
 
     auto old_write_vindex = this->write_vindex;
 
@@ -130,8 +168,7 @@ private:
   size_type read_vindex{ 0 };
   size_type write_vindex{ 0 };
 
-  std::array<value_type, capacity> storage
-    /* uninitialized */;
+  storage_type storage;
 };
 }
 }
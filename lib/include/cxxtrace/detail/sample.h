@@ -1,33 +1,628 @@
 #ifndef CXXTRACE_DETAIL_SAMPLE_H
 #define CXXTRACE_DETAIL_SAMPLE_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/detail/span_depth.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/sample.h>
+#include <cxxtrace/span_argument.h>
 #include <cxxtrace/string.h>
-#include <cxxtrace/thread.h>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 namespace cxxtrace {
 namespace detail {
-struct sample_site_local_data
+// The site of a sample, as stored in each sample.
+//
+// Only a pointer to the sample_site is stored, keeping samples small. The
+// category, name, and kind are resolved when a snapshot is read.
+class sample_site_local_data
 {
-  czstring category;
-  czstring name;
-  sample_kind kind;
+public:
+  sample_site_local_data() noexcept = default;
+
+  static auto from_index(sample_site_index index) noexcept
+    -> sample_site_local_data
+  {
+    return sample_site_local_data{ &lookup_sample_site(index) };
+  }
+
+  /* implicit */ sample_site_local_data(const sample_site* site) noexcept
+    : site_{ site }
+  {}
+
+  // Look up the sample_site for category, name, and kind (with no source
+  // location), creating it if necessary.
+  //
+  // This is slower than using a sample_site_cache, and each distinct category
+  // and name creates a sample_site_set which is never destroyed. The
+  // constructor is explicit so that this cost is visible at call sites.
+  explicit sample_site_local_data(czstring category,
+                                  czstring name,
+                                  sample_kind kind) noexcept(false)
+    : site_{ intern_sample_site_set(category, name, nullptr, 0).at(kind) }
+  {}
+
+  auto site() const noexcept -> const sample_site& { return *this->site_; }
+  auto index() const noexcept -> sample_site_index
+  {
+    return this->site_->index;
+  }
+  auto category() const noexcept -> czstring { return this->site_->category; }
+  auto name() const noexcept -> czstring { return this->site_->name; }
+  auto kind() const noexcept -> sample_kind { return this->site_->kind; }
+
+private:
+  const sample_site* site_;
 };
+static_assert(std::is_trivial_v<sample_site_local_data>);
+static_assert(sizeof(sample_site_local_data) == sizeof(void*));
 
+// A sample in a shared or processor-local storage (or a sample decoded from a
+// thread-local storage).
+//
+// The sample's thread and site are stored in its record's header (see
+// sample_record::thread and sample_record::site_index), so the record's payload
+// holds only the time point. A global_sample with a 64-bit clock fits in a
+// 16-byte record.
 template<class ClockSample>
 struct global_sample
 {
+  using clock_sample = ClockSample;
+
+  static constexpr auto site_in_record_header = true;
+
+  // The size of global_sample if it has no padding.
+  static constexpr auto packed_size =
+    sizeof(sample_site_local_data) + sizeof(ClockSample);
+
   sample_site_local_data site;
-  cxxtrace::thread_id thread_id;
   ClockSample time_point;
 };
 
+// Whether thread-local storages store ClockSample-s as 32-bit differences from
+// a periodically-recorded base time point. (See sample_record.)
 template<class ClockSample>
+inline constexpr auto is_delta_encodable_clock_sample =
+  std::is_integral_v<ClockSample> && sizeof(ClockSample) <= 8;
+
+template<class ClockSample, class = void>
 struct thread_local_sample
 {
+  using clock_sample = ClockSample;
+
+  static constexpr auto site_in_record_header = false;
+
+  // The size of thread_local_sample if it has no padding.
+  static constexpr auto packed_size =
+    sizeof(sample_site_local_data) + sizeof(ClockSample);
+
   sample_site_local_data site;
   ClockSample time_point;
 };
+
+// A thread_local_sample whose time point is delta-encoded in its record's
+// header (see sample_record::time_delta).
+template<class ClockSample>
+struct thread_local_sample<
+  ClockSample,
+  std::enable_if_t<is_delta_encodable_clock_sample<ClockSample>>>
+{
+  using clock_sample = ClockSample;
+
+  static constexpr auto site_in_record_header = false;
+
+  static constexpr auto packed_size = sizeof(sample_site_local_data);
+
+  sample_site_local_data site;
+};
+
+// The arguments, event ID, and end time of one sample, as passed to a
+// storage's add_sample.
+template<class ClockSample>
+struct sample_arguments
+{
+  auto begin() const noexcept -> const span_argument* { return this->data; }
+  auto end() const noexcept -> const span_argument*
+  {
+    return this->data + this->size;
+  }
+
+  const span_argument* data{ nullptr };
+  std::size_t size{ 0 };
+  // The ID of an async or flow sample.
+  std::optional<std::uint64_t> event_id{};
+  // The time a complete_span sample's span exited. (The sample's own time
+  // point is when the span was entered.)
+  std::optional<ClockSample> end_time_point{};
+  // The number of spans which enclose the sample on its thread.
+  recorded_span_depth depth{ 0 };
+  // The sample's category and name, if they are not its sample_site's. (See
+  // sample_sites.)
+  czstring dynamic_category{ nullptr };
+  czstring dynamic_name{ nullptr };
+};
+
+enum class sample_record_kind : std::uint8_t
+{
+  sample,
+  argument,
+  argument_value,
+  argument_bytes,
+  event_id,
+  end_time_point,
+  dynamic_category,
+  dynamic_name,
+  // A time point which later delta-encoded samples are relative to.
+  time_base,
+  // A record which readers should skip, such as a delta-encoded sample whose
+  // time_base record was lost. Records following a discarded record are
+  // orphaned until the next sample record.
+  discarded,
+};
+
+union sample_argument_value
+{
+  std::int64_t integer;
+  double floating;
+};
+
+struct sample_argument_header
+{
+  czstring name;
+  sample_argument_value value;
+};
+
+struct sample_argument_name
+{
+  czstring name;
+};
+
+// The size of the fields of a sample_record which precede its payload.
+inline constexpr auto sample_record_header_size = std::size_t{ 8 };
+
+// Round a sample_record's size up to 16, 32, or 64 bytes. Return 0 if
+// minimum_size is larger than 64 bytes.
+//
+// A record of one of these sizes, aligned to its size, never straddles a cache
+// line, and copying it does not copy padding.
+constexpr auto
+round_up_sample_record_size(std::size_t minimum_size) noexcept -> std::size_t
+{
+  for (auto size = std::size_t{ 16 }; size <= 64; size *= 2) {
+    if (minimum_size <= size) {
+      return size;
+    }
+  }
+  return 0;
+}
+
+// The part of a Sample which a sample record's payload holds.
+template<class Sample>
+using stored_sample = std::conditional_t<Sample::site_in_record_header,
+                                         typename Sample::clock_sample,
+                                         Sample>;
+
+template<class Sample>
+inline constexpr auto sample_record_size = round_up_sample_record_size(
+  sample_record_header_size + std::max({ sizeof(stored_sample<Sample>),
+                                         sizeof(typename Sample::clock_sample),
+                                         sizeof(std::uint64_t) }));
+
+// One item in a storage's queue.
+//
+// A sample with arguments is stored as several consecutive records: a sample
+// record, an event_id record (if the sample has an event ID), an end_time_point
+// record (if the sample is a complete span), dynamic_category and dynamic_name
+// records (if the sample's category or name is not its sample_site's), then an
+// argument record for each argument. If a record's payload is too small to hold
+// both an argument's name and value, a number argument's value follows its
+// argument record in an argument_value record. A string argument's characters
+// follow its argument record in argument_bytes records.
+//
+// Records are pushed into ring queues together, but a lossy queue can discard
+// a prefix of a sample's records. Readers must ignore argument records which
+// do not follow a sample record.
+//
+// Thread-local storages delta-encode integral time points: a sample record
+// holds the difference between its time point and the time point of the
+// preceding time_base record with the same time_base_generation. Other
+// storages store each sample's thread_index and sample_site_index in its sample
+// record's header.
+//
+// A sample_record is exactly 16, 32, or 64 bytes (see
+// round_up_sample_record_size). The payload fills the rest of the record, so
+// larger records hold more bytes of a string argument.
+template<class Sample>
+struct alignas(sample_record_size<Sample>) sample_record
+{
+  using clock_sample = typename Sample::clock_sample;
+
+  static_assert(sizeof(Sample) == Sample::packed_size,
+                "Sample should not contain padding");
+  static_assert(sample_record_size<Sample> != 0,
+                "Sample should fit in a 64-byte sample_record");
+
+  static constexpr auto size = sample_record_size<Sample>;
+  static constexpr auto payload_size = size - sample_record_header_size;
+  static constexpr auto inline_argument_values =
+    payload_size >= sizeof(sample_argument_header);
+
+  using argument_header = std::conditional_t<inline_argument_values,
+                                             sample_argument_header,
+                                             sample_argument_name>;
+
+  static auto from_sample(const Sample& sample) noexcept -> sample_record
+  {
+    sample_record record;
+    record.kind = sample_record_kind::sample;
+    record.set_sample(sample);
+    return record;
+  }
+
+  static auto from_sample(const Sample& sample, thread_index thread) noexcept
+    -> sample_record
+  {
+    auto record = from_sample(sample);
+    record.thread = thread;
+    return record;
+  }
+
+  // Convert a sample_record<thread_local_sample<ClockSample>> into a
+  // sample_record<global_sample<ClockSample>>. Delta-encoded samples are not
+  // supported.
+  //
+  // @see thread_local_record_decoder
+  template<class OtherSample>
+  static auto from_thread_local_record(
+    const sample_record<OtherSample>& other,
+    thread_index thread) noexcept -> sample_record
+  {
+    sample_record record;
+    record.kind = other.kind;
+    record.thread = thread;
+    record.argument_type = other.argument_type;
+    record.string_size = other.string_size;
+    switch (other.kind) {
+      case sample_record_kind::sample:
+        if constexpr (is_delta_encodable_clock_sample<
+                        typename OtherSample::clock_sample>) {
+          // Delta-encoded samples must be decoded by
+          // thread_local_record_decoder.
+          record.kind = sample_record_kind::discarded;
+        } else {
+          auto sample = other.get_sample();
+          record.set_sample(Sample{ sample.site, sample.time_point });
+        }
+        break;
+      case sample_record_kind::argument:
+        record.argument.name = other.argument.name;
+        if constexpr (inline_argument_values) {
+          if constexpr (sample_record<OtherSample>::inline_argument_values) {
+            record.argument.value = other.argument.value;
+          } else {
+            // The value follows in an argument_value record.
+            record.argument.value = sample_argument_value{};
+          }
+        }
+        break;
+      case sample_record_kind::argument_value:
+        record.argument_value = other.argument_value;
+        break;
+      case sample_record_kind::argument_bytes:
+        static_assert(sizeof(record.bytes) >= sizeof(other.bytes));
+        std::memcpy(record.bytes, other.bytes, sizeof(other.bytes));
+        break;
+      case sample_record_kind::event_id:
+        record.event_id = other.event_id;
+        break;
+      case sample_record_kind::end_time_point:
+        record.end_time_point = other.end_time_point;
+        break;
+      case sample_record_kind::dynamic_category:
+        record.dynamic_category = other.dynamic_category;
+        break;
+      case sample_record_kind::dynamic_name:
+        record.dynamic_name = other.dynamic_name;
+        break;
+      case sample_record_kind::time_base:
+      case sample_record_kind::discarded:
+        record.kind = sample_record_kind::discarded;
+        break;
+    }
+    return record;
+  }
+
+  // For sample records.
+  auto set_sample(const Sample& sample) noexcept -> void
+  {
+    if constexpr (Sample::site_in_record_header) {
+      this->site_index = sample.site.index();
+      this->sample = sample.time_point;
+    } else {
+      this->sample = sample;
+    }
+  }
+
+  // For sample records.
+  auto get_sample() const noexcept -> Sample
+  {
+    if constexpr (Sample::site_in_record_header) {
+      return Sample{ sample_site_local_data::from_index(this->site_index),
+                     this->sample };
+    } else {
+      return this->sample;
+    }
+  }
+
+  sample_record_kind kind;
+  union
+  {
+    // For argument records.
+    span_argument_type argument_type;
+    // For sample records.
+    recorded_span_depth depth;
+  };
+  union
+  {
+    // For delta-encoded sample records and for time_base records in
+    // thread-local storages.
+    std::uint16_t time_base_generation;
+    // For sample records in other storages.
+    thread_index thread;
+  };
+  union
+  {
+    // For delta-encoded sample records.
+    std::uint32_t time_delta;
+    // For string argument records, the size of the string. For argument_bytes
+    // records, the number of bytes in the record.
+    std::uint32_t string_size;
+    // For sample records of Samples with site_in_record_header.
+    sample_site_index site_index;
+  };
+  union
+  {
+    // For sample records. Use get_sample to read the whole Sample.
+    stored_sample<Sample> sample;
+    argument_header argument;
+    sample_argument_value argument_value;
+    char bytes[payload_size];
+    std::uint64_t event_id;
+    clock_sample end_time_point;
+    czstring dynamic_category;
+    czstring dynamic_name;
+    clock_sample time_base;
+  };
+};
+
+// Returns the number of records needed to store one argument of a Sample.
+template<class Sample>
+auto
+sample_argument_record_count(const span_argument& argument) noexcept
+  -> std::size_t
+{
+  using record = sample_record<Sample>;
+
+  auto count = std::size_t{ 1 };
+  switch (argument.type()) {
+    case span_argument_type::integer:
+    case span_argument_type::floating:
+      if (!record::inline_argument_values) {
+        count += 1;
+      }
+      break;
+    case span_argument_type::string: {
+      auto bytes_capacity = record::payload_size;
+      count += (argument.string().size() + bytes_capacity - 1) / bytes_capacity;
+      break;
+    }
+  }
+  return count;
+}
+
+// Returns the number of records needed to store a sample without its
+// span_argument-s.
+template<class ClockSample>
+auto
+sample_header_record_count(
+  const sample_arguments<ClockSample>& arguments) noexcept -> std::size_t
+{
+  auto count = std::size_t{ 1 };
+  if (arguments.event_id.has_value()) {
+    count += 1;
+  }
+  if (arguments.end_time_point.has_value()) {
+    count += 1;
+  }
+  if (arguments.dynamic_category) {
+    count += 1;
+  }
+  if (arguments.dynamic_name) {
+    count += 1;
+  }
+  return count;
+}
+
+// Returns the number of records needed to store a Sample with the given
+// arguments.
+template<class Sample>
+auto
+sample_record_count(
+  const sample_arguments<typename Sample::clock_sample>& arguments) noexcept
+  -> std::size_t
+{
+  auto count = sample_header_record_count(arguments);
+  for (const auto& argument : arguments) {
+    count += sample_argument_record_count<Sample>(argument);
+  }
+  return count;
+}
+
+// Drop trailing arguments until the Sample's records number fewer than
+// queue_capacity. (Ring queues cannot push queue_capacity items at once.)
+template<class Sample>
+auto
+fit_sample_arguments(sample_arguments<typename Sample::clock_sample> arguments,
+                     std::size_t queue_capacity) noexcept
+  -> sample_arguments<typename Sample::clock_sample>
+{
+  auto count = sample_header_record_count(arguments);
+  auto fitting_size = std::size_t{ 0 };
+  for (const auto& argument : arguments) {
+    count += sample_argument_record_count<Sample>(argument);
+    if (count >= queue_capacity) {
+      break;
+    }
+    fitting_size += 1;
+  }
+  arguments.size = fitting_size;
+  return arguments;
+}
+
+// Erase argument, event ID, end time, and dynamic name records at
+// records[begin_index] which do not follow a sample record. Call this after
+// appending a queue's records (at begin_index) so the queue's leftover
+// arguments aren't attributed to the previous queue's last sample.
+template<class Sample>
+auto
+erase_orphaned_sample_records(std::vector<sample_record<Sample>>& records,
+                              std::size_t begin_index) noexcept -> void
+{
+  auto begin = records.begin() + begin_index;
+  auto sample_it =
+    std::find_if(begin, records.end(), [](const sample_record<Sample>& r) {
+      return r.kind == sample_record_kind::sample;
+    });
+  records.erase(begin, sample_it);
+}
+
+// Encode a sample record and its arguments into
+// sample_record_count<Sample>(arguments) records, calling set(index, record)
+// for each record.
+template<class Sample, class SetFunction>
+auto
+write_sample_records(
+  const sample_record<Sample>& sample,
+  const sample_arguments<typename Sample::clock_sample>& arguments,
+  SetFunction&& set) noexcept -> void
+{
+  using record = sample_record<Sample>;
+  static_assert(sizeof(record) == record::size);
+  static_assert(alignof(record) == record::size);
+
+  auto index = std::size_t{ 0 };
+  auto sample_with_depth = sample;
+  sample_with_depth.depth = arguments.depth;
+  set(index++, sample_with_depth);
+  if (arguments.event_id.has_value()) {
+    record event_id;
+    event_id.kind = sample_record_kind::event_id;
+    event_id.event_id = *arguments.event_id;
+    set(index++, event_id);
+  }
+  if (arguments.end_time_point.has_value()) {
+    record end_time_point;
+    end_time_point.kind = sample_record_kind::end_time_point;
+    end_time_point.end_time_point = *arguments.end_time_point;
+    set(index++, end_time_point);
+  }
+  if (arguments.dynamic_category) {
+    record dynamic_category;
+    dynamic_category.kind = sample_record_kind::dynamic_category;
+    dynamic_category.dynamic_category = arguments.dynamic_category;
+    set(index++, dynamic_category);
+  }
+  if (arguments.dynamic_name) {
+    record dynamic_name;
+    dynamic_name.kind = sample_record_kind::dynamic_name;
+    dynamic_name.dynamic_name = arguments.dynamic_name;
+    set(index++, dynamic_name);
+  }
+  for (const auto& argument : arguments) {
+    record header;
+    header.kind = sample_record_kind::argument;
+    header.argument_type = argument.type();
+    header.argument.name = argument.name();
+    auto value = sample_argument_value{};
+    switch (argument.type()) {
+      case span_argument_type::integer:
+        value.integer = argument.integer();
+        break;
+      case span_argument_type::floating:
+        value.floating = argument.floating();
+        break;
+      case span_argument_type::string:
+        header.string_size =
+          static_cast<std::uint32_t>(argument.string().size());
+        break;
+    }
+    if constexpr (record::inline_argument_values) {
+      header.argument.value = value;
+    }
+    set(index++, header);
+
+    if (argument.type() == span_argument_type::string) {
+      auto string = argument.string();
+      for (auto offset = std::size_t{ 0 }; offset < string.size();
+           offset += record::payload_size) {
+        auto size = std::min(record::payload_size, string.size() - offset);
+        record bytes;
+        bytes.kind = sample_record_kind::argument_bytes;
+        bytes.string_size = static_cast<std::uint32_t>(size);
+        std::memcpy(bytes.bytes, string.data() + offset, size);
+        set(index++, bytes);
+      }
+    } else if (!record::inline_argument_values) {
+      record value_record;
+      value_record.kind = sample_record_kind::argument_value;
+      value_record.argument_value = value;
+      set(index++, value_record);
+    }
+  }
+}
+
+// Call storage.add_sample for the sites' sample_site of the given kind with
+// the given span_argument-s (if any). The sample's depth is the calling
+// thread's current span depth in storages of type Storage.
+template<class Storage, class ClockSample, class... Arguments>
+auto
+add_sample_with_arguments(Storage& storage,
+                          const sample_sites& sites,
+                          sample_kind kind,
+                          ClockSample time_point,
+                          std::optional<std::uint64_t> event_id,
+                          const Arguments&... arguments) noexcept(false) -> void
+{
+  auto depth = get_current_thread_span_depth<Storage>();
+  if constexpr (sizeof...(Arguments) == 0) {
+    storage.add_sample(sites.at(kind),
+                       time_point,
+                       sample_arguments<ClockSample>{ nullptr,
+                                                      0,
+                                                      event_id,
+                                                      std::nullopt,
+                                                      depth,
+                                                      sites.dynamic_category,
+                                                      sites.dynamic_name });
+  } else {
+    const span_argument span_arguments[] = { span_argument{ arguments }... };
+    storage.add_sample(sites.at(kind),
+                       time_point,
+                       sample_arguments<ClockSample>{ span_arguments,
+                                                      sizeof...(Arguments),
+                                                      event_id,
+                                                      std::nullopt,
+                                                      depth,
+                                                      sites.dynamic_category,
+                                                      sites.dynamic_name });
+  }
+}
 }
 }
 
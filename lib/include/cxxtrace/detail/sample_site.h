@@ -0,0 +1,186 @@
+#ifndef CXXTRACE_DETAIL_SAMPLE_SITE_H
+#define CXXTRACE_DETAIL_SAMPLE_SITE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cxxtrace/sample.h>
+#include <cxxtrace/string.h>
+
+// CXXTRACE_DETAIL_SAMPLE_SITE_CACHE()
+//
+// Evaluate to a reference to a sample_site_cache unique to the macro's
+// expansion. The cache is constant-initialized, so using it costs no
+// initialization guard.
+#define CXXTRACE_DETAIL_SAMPLE_SITE_CACHE()                                    \
+  ([]() noexcept -> ::cxxtrace::detail::sample_site_cache& {                   \
+    static ::cxxtrace::detail::sample_site_cache cache{ __FILE__, __LINE__ };  \
+    return cache;                                                              \
+  }())
+
+// CXXTRACE_DETAIL_MULTI_SAMPLE_SITE_CACHE()
+//
+// Like CXXTRACE_DETAIL_SAMPLE_SITE_CACHE, but evaluate to a reference to a
+// multi_sample_site_cache.
+#define CXXTRACE_DETAIL_MULTI_SAMPLE_SITE_CACHE()                              \
+  ([]() noexcept -> ::cxxtrace::detail::multi_sample_site_cache& {             \
+    static ::cxxtrace::detail::multi_sample_site_cache cache{ __FILE__,        \
+                                                              __LINE__ };      \
+    return cache;                                                              \
+  }())
+
+namespace cxxtrace {
+namespace detail {
+inline constexpr auto sample_kind_count =
+  static_cast<std::size_t>(sample_kind::next_phase) + 1;
+
+// A 32-bit number identifying a sample_site. (See lookup_sample_site.)
+using sample_site_index = std::uint32_t;
+
+// A description of the place where samples are added (usually a macro call
+// site). Samples refer to their sample_site by pointer or by index rather than
+// copying the site's category, name, and kind.
+//
+// sample_site-s are never destroyed.
+struct sample_site
+{
+  czstring category;
+  czstring name;
+  sample_kind kind;
+  sample_site_index index;
+  // The source location of the site, or nullptr and 0 if unknown.
+  czstring file;
+  int line;
+};
+
+// One sample_site for each sample_kind, all sharing a category and name. (A
+// span adds samples of several kinds from one call site.)
+struct sample_site_set
+{
+  auto at(sample_kind kind) const noexcept -> const sample_site*
+  {
+    return &this->sites[static_cast<std::size_t>(kind)];
+  }
+
+  czstring category;
+  czstring name;
+  sample_site sites[sample_kind_count];
+};
+
+// The sample_site-s for one call from a call site, as returned by a
+// sample_site_cache.
+//
+// A cache interns at most one sample_site_set per entry. If a call's category
+// or name differs from the interned set's, dynamic_category or dynamic_name
+// holds the call's, and each sample records it in an extra record (see
+// sample_arguments::dynamic_name).
+struct sample_sites
+{
+  auto at(sample_kind kind) const noexcept -> const sample_site*
+  {
+    return this->set->at(kind);
+  }
+
+  const sample_site_set* set{ nullptr };
+  // The call's category and name, or nullptr if they are set's.
+  czstring dynamic_category{ nullptr };
+  czstring dynamic_name{ nullptr };
+};
+
+// Return a sample_site_set which lives forever.
+//
+// Interning compares category and name by address, not by contents.
+auto
+intern_sample_site_set(czstring category,
+                       czstring name,
+                       czstring file,
+                       int line) noexcept(false) -> const sample_site_set&;
+
+// Return the interned sample_site whose index is the given index.
+//
+// lookup_sample_site does not lock. index must have been read from an interned
+// sample_site.
+auto
+lookup_sample_site(sample_site_index) noexcept -> const sample_site&;
+
+// A call site's sample_site_set.
+//
+// get interns a sample_site_set only on the call site's first call. A call
+// site's category and name usually do not change between calls. If they do,
+// get returns the first call's sample_site_set with the new category and name
+// as dynamic names, without locking or allocating.
+class sample_site_cache
+{
+public:
+  explicit constexpr sample_site_cache(czstring file, int line) noexcept
+    : file{ file }
+    , line{ line }
+  {}
+
+  sample_site_cache(const sample_site_cache&) = delete;
+  sample_site_cache& operator=(const sample_site_cache&) = delete;
+
+  auto get(czstring category, czstring name) noexcept(false) -> sample_sites
+  {
+    auto* sites = this->sites.load(std::memory_order_acquire);
+    if (sites && sites->category == category && sites->name == name) {
+      return sample_sites{ sites };
+    }
+    return this->get_slow(category, name);
+  }
+
+private:
+  auto get_slow(czstring category, czstring name) noexcept(false)
+    -> sample_sites;
+
+  czstring file;
+  int line;
+  std::atomic<const sample_site_set*> sites{ nullptr };
+};
+
+// A call site's sample_site_set-s, for call sites whose name changes between
+// calls (such as a sequence of phases).
+//
+// Callers pass a hint, such as the phase's position in its sequence, which
+// chooses the entry probed first. If that entry holds a different name, the
+// other entries are probed in order, and a name not found is interned into the
+// first empty entry. Like sample_site_cache, each entry is interned once; only
+// once every entry holds a different name is a name returned as a dynamic
+// name.
+class multi_sample_site_cache
+{
+public:
+  explicit constexpr multi_sample_site_cache(czstring file, int line) noexcept
+    : file{ file }
+    , line{ line }
+  {}
+
+  multi_sample_site_cache(const multi_sample_site_cache&) = delete;
+  multi_sample_site_cache& operator=(const multi_sample_site_cache&) = delete;
+
+  auto get(czstring category, czstring name, std::size_t hint) noexcept(false)
+    -> sample_sites
+  {
+    auto& entry = this->entries[hint % entry_count];
+    auto* sites = entry.load(std::memory_order_acquire);
+    if (sites && sites->category == category && sites->name == name) {
+      return sample_sites{ sites };
+    }
+    return this->get_slow(category, name, hint);
+  }
+
+private:
+  static constexpr auto entry_count = std::size_t{ 8 };
+
+  auto get_slow(czstring category,
+                czstring name,
+                std::size_t hint) noexcept(false) -> sample_sites;
+
+  czstring file;
+  int line;
+  std::atomic<const sample_site_set*> entries[entry_count]{};
+};
+}
+}
+
+#endif
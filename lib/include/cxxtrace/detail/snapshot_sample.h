@@ -1,68 +1,328 @@
 #ifndef CXXTRACE_DETAIL_SNAPSHOT_SAMPLE_H
 #define CXXTRACE_DETAIL_SNAPSHOT_SAMPLE_H
 
-#include <algorithm> // IWYU pragma: keep
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/span_depth.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/hardware_counters.h>
+#include <cxxtrace/span_argument.h>
+#include <cxxtrace/string.h>
 #include <cxxtrace/thread.h>
-#include <iterator>
+#include <cxxtrace/thread_cpu_time.h>
+#include <cxxtrace/uninitialized.h>
+#include <optional>
+#include <string>
 #include <type_traits> // IWYU pragma: keep
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace cxxtrace {
 namespace detail {
 struct snapshot_sample
 {
-  template<class Clock>
-  explicit snapshot_sample(const global_sample<typename Clock::sample>& sample,
-                           Clock& clock) noexcept
-    : site{ sample.site }
-    , thread_id{ sample.thread_id }
-    , timestamp{ clock.make_time_point(sample.time_point) }
-  {}
-
-  template<class Clock>
-  explicit snapshot_sample(
-    const thread_local_sample<typename Clock::sample>& sample,
-    thread_id thread_id,
-    Clock& clock) noexcept
-    : site{ sample.site }
+  explicit snapshot_sample(sample_site_local_data site,
+                           cxxtrace::thread_id thread_id,
+                           time_point timestamp) noexcept
+    : site{ site }
     , thread_id{ thread_id }
-    , timestamp{ clock.make_time_point(sample.time_point) }
+    , timestamp{ timestamp }
   {}
 
+  // Convert sample records (i.e. records whose kind is
+  // sample_record_kind::sample) into snapshot_sample-s.
   template<class Sample, class Clock>
-  static auto many_from_samples(const std::vector<Sample>& samples,
-                                Clock& clock) noexcept(false)
-    -> std::vector<snapshot_sample>
+  static auto many_from_samples(
+    const std::vector<sample_record<Sample>>& samples,
+    Clock& clock,
+    std::vector<snapshot_sample>& out) noexcept(false) -> void
+  {
+    static_assert(
+      std::is_same_v<Sample, global_sample<typename Clock::sample>>);
+
+    // Convert timestamps in chunks with detail::make_time_points. Batching
+    // lets the clock vectorize the conversion, and chunking keeps the
+    // intermediate buffers in cache.
+    static constexpr auto chunk_size = std::size_t{ 256 };
+
+    auto buffer_size = std::min(chunk_size, samples.size());
+    auto clock_samples = std::vector<typename Clock::sample>(buffer_size);
+    auto time_points =
+      std::vector<time_point>(buffer_size, time_point{ uninitialized });
+
+    out.reserve(out.size() + samples.size());
+    for (auto chunk_begin = std::size_t{ 0 }; chunk_begin < samples.size();
+         chunk_begin += chunk_size) {
+      auto count = std::min(chunk_size, samples.size() - chunk_begin);
+      for (auto i = std::size_t{ 0 }; i < count; ++i) {
+        clock_samples[i] = samples[chunk_begin + i].get_sample().time_point;
+      }
+      make_time_points(clock, clock_samples.data(), time_points.data(), count);
+      for (auto i = std::size_t{ 0 }; i < count; ++i) {
+        const auto& record = samples[chunk_begin + i];
+        auto sample = record.get_sample();
+        auto& snapshot_sample = out.emplace_back(
+          sample.site, thread_id_of_index(record.thread), time_points[i]);
+        snapshot_sample.depth = record.depth;
+        if constexpr (clock_has_hardware_counters<Clock>::value) {
+          snapshot_sample.counters =
+            available_counters(sample.time_point.counters);
+        }
+        if constexpr (clock_has_thread_cpu_time<Clock>::value) {
+          snapshot_sample.thread_cpu_time =
+            available_thread_cpu_time(sample.time_point.thread_cpu_time);
+        }
+      }
+    }
+  }
+
+  template<class Sample, class Clock>
+  static auto many_from_records(
+    const std::vector<sample_record<Sample>>& records,
+    Clock& clock) noexcept(false) -> std::vector<snapshot_sample>
   {
     auto snapshot_samples = std::vector<detail::snapshot_sample>{};
-    many_from_samples(samples, clock, snapshot_samples);
+    many_from_records(records, clock, snapshot_samples);
     return snapshot_samples;
   }
 
+  // Like many_from_samples, but also decode each sample's event ID, end time,
+  // dynamic category and name, and arguments.
   template<class Sample, class Clock>
-  static auto many_from_samples(
-    const std::vector<Sample>& samples,
+  static auto many_from_records(
+    const std::vector<sample_record<Sample>>& records,
     Clock& clock,
     std::vector<snapshot_sample>& out) noexcept(false) -> void
   {
-    static_assert(
-      std::is_convertible_v<Sample, global_sample<typename Clock::sample>>);
+    using clock_sample = typename Clock::sample;
 
-    out.reserve(out.size() + samples.size());
-    std::transform(
-      samples.begin(),
-      samples.end(),
-      std::back_inserter(out),
-      [&](auto&& s) noexcept->detail::snapshot_sample {
-        return detail::snapshot_sample{ s, clock };
-      });
+    auto samples = std::vector<sample_record<Sample>>{};
+    auto payloads = std::vector<sample_payload<clock_sample>>{};
+    decode_records(records, samples, payloads);
+
+    auto first_index = out.size();
+    many_from_samples(samples, clock, out);
+    auto end_sample_indexes = std::vector<std::size_t>{};
+    auto end_clock_samples = std::vector<clock_sample>{};
+    for (auto& payload : payloads) {
+      auto sample_index = first_index + payload.sample_index;
+      auto& sample = out[sample_index];
+      sample.event_id = payload.event_id;
+      sample.dynamic_category = payload.dynamic_category;
+      sample.dynamic_name = payload.dynamic_name;
+      sample.arguments = std::move(payload.arguments);
+      if (payload.end_time_point.has_value()) {
+        end_sample_indexes.emplace_back(sample_index);
+        end_clock_samples.emplace_back(*payload.end_time_point);
+      }
+    }
+
+    auto end_time_points = std::vector<time_point>(end_clock_samples.size(),
+                                                   time_point{ uninitialized });
+    make_time_points(clock,
+                     end_clock_samples.data(),
+                     end_time_points.data(),
+                     end_clock_samples.size());
+    for (auto i = std::size_t{ 0 }; i < end_sample_indexes.size(); ++i) {
+      auto& sample = out[end_sample_indexes[i]];
+      sample.end_timestamp = end_time_points[i];
+      if constexpr (clock_has_hardware_counters<Clock>::value) {
+        sample.end_counters = available_counters(end_clock_samples[i].counters);
+      }
+      if constexpr (clock_has_thread_cpu_time<Clock>::value) {
+        sample.end_thread_cpu_time =
+          available_thread_cpu_time(end_clock_samples[i].thread_cpu_time);
+      }
+    }
   }
 
   sample_site_local_data site;
   cxxtrace::thread_id thread_id;
   time_point timestamp;
+  std::optional<hardware_counters> counters{};
+  std::optional<std::chrono::nanoseconds> thread_cpu_time{};
+  std::optional<std::uint64_t> event_id{};
+  std::vector<sample_argument> arguments{};
+  recorded_span_depth depth{ 0 };
+  // The sample's category and name, or nullptr if they are site's.
+  czstring dynamic_category{ nullptr };
+  czstring dynamic_name{ nullptr };
+
+  // For complete_span samples, the time, hardware counters, and CPU time when
+  // the span exited. (timestamp, counters, and thread_cpu_time are from when
+  // the span was entered.)
+  std::optional<time_point> end_timestamp{};
+  std::optional<hardware_counters> end_counters{};
+  std::optional<std::chrono::nanoseconds> end_thread_cpu_time{};
+
+private:
+  static auto available_counters(const hardware_counters& counters) noexcept
+    -> std::optional<hardware_counters>
+  {
+    if (!counters.available()) {
+      return std::nullopt;
+    }
+    return counters;
+  }
+
+  static auto available_thread_cpu_time(
+    std::chrono::nanoseconds thread_cpu_time) noexcept
+    -> std::optional<std::chrono::nanoseconds>
+  {
+    if (thread_cpu_time == unavailable_thread_cpu_time) {
+      return std::nullopt;
+    }
+    return thread_cpu_time;
+  }
+
+  // The event ID, end time, dynamic category and name, and arguments of
+  // samples[sample_index].
+  template<class ClockSample>
+  struct sample_payload
+  {
+    std::size_t sample_index;
+    std::optional<std::uint64_t> event_id{};
+    std::optional<ClockSample> end_time_point{};
+    czstring dynamic_category{ nullptr };
+    czstring dynamic_name{ nullptr };
+    std::vector<sample_argument> arguments{};
+  };
+
+  // Split records (see sample_record) into samples and their payloads.
+  //
+  // Event IDs, end times, dynamic names, and arguments whose sample record was
+  // discarded (because a ring queue overflowed) are ignored.
+  template<class Sample, class ClockSample>
+  static auto decode_records(
+    const std::vector<sample_record<Sample>>& records,
+    std::vector<sample_record<Sample>>& samples,
+    std::vector<sample_payload<ClockSample>>& payloads) noexcept(false) -> void
+  {
+    using payload_type = sample_payload<ClockSample>;
+
+    auto current_payload = [&]() -> payload_type& {
+      auto sample_index = samples.size() - 1;
+      if (payloads.empty() || payloads.back().sample_index != sample_index) {
+        payloads.emplace_back(payload_type{ sample_index });
+      }
+      return payloads.back();
+    };
+
+    using record_type = sample_record<Sample>;
+
+    samples.reserve(samples.size() + records.size());
+    auto have_sample = false;
+    // The number argument receiving an argument_value record, if any.
+    sample_argument* number = nullptr;
+    // The string argument receiving argument_bytes records, if any.
+    std::string* string = nullptr;
+    auto string_remaining_size = std::size_t{ 0 };
+    for (const auto& record : records) {
+      if (record.kind != sample_record_kind::argument_value) {
+        number = nullptr;
+      }
+      if (record.kind != sample_record_kind::argument_bytes) {
+        string = nullptr;
+      }
+      switch (record.kind) {
+        case sample_record_kind::sample:
+          samples.emplace_back(record);
+          have_sample = true;
+          break;
+
+        case sample_record_kind::time_base:
+        case sample_record_kind::discarded:
+          have_sample = false;
+          break;
+
+        case sample_record_kind::event_id:
+          if (have_sample) {
+            current_payload().event_id = record.event_id;
+          }
+          break;
+
+        case sample_record_kind::end_time_point:
+          if (have_sample) {
+            current_payload().end_time_point = record.end_time_point;
+          }
+          break;
+
+        case sample_record_kind::dynamic_category:
+          if (have_sample) {
+            current_payload().dynamic_category = record.dynamic_category;
+          }
+          break;
+
+        case sample_record_kind::dynamic_name:
+          if (have_sample) {
+            current_payload().dynamic_name = record.dynamic_name;
+          }
+          break;
+
+        case sample_record_kind::argument: {
+          if (!have_sample) {
+            break;
+          }
+          auto& sample_arguments = current_payload().arguments;
+          auto value = sample_argument_value{};
+          if constexpr (record_type::inline_argument_values) {
+            value = record.argument.value;
+          }
+          auto name = record.argument.name;
+          switch (record.argument_type) {
+            case span_argument_type::integer:
+              number = &sample_arguments.emplace_back(
+                sample_argument{ name, value.integer });
+              break;
+            case span_argument_type::floating:
+              number = &sample_arguments.emplace_back(
+                sample_argument{ name, value.floating });
+              break;
+            case span_argument_type::string:
+              string = &std::get<std::string>(
+                sample_arguments
+                  .emplace_back(sample_argument{ name, std::string{} })
+                  .value);
+              string_remaining_size = record.string_size;
+              string->reserve(string_remaining_size);
+              break;
+          }
+          break;
+        }
+
+        case sample_record_kind::argument_value:
+          if (!number) {
+            break;
+          }
+          if (std::holds_alternative<double>(number->value)) {
+            number->value = record.argument_value.floating;
+          } else {
+            number->value = record.argument_value.integer;
+          }
+          number = nullptr;
+          break;
+
+        case sample_record_kind::argument_bytes: {
+          if (!string) {
+            break;
+          }
+          auto size = std::min(string_remaining_size,
+                               std::size_t{ record.string_size });
+          string->append(record.bytes, size);
+          string_remaining_size -= size;
+          if (string_remaining_size == 0) {
+            string = nullptr;
+          }
+          break;
+        }
+      }
+    }
+  }
 };
 }
 }
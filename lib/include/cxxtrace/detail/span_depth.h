@@ -0,0 +1,45 @@
+#ifndef CXXTRACE_DETAIL_SPAN_DEPTH_H
+#define CXXTRACE_DETAIL_SPAN_DEPTH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace cxxtrace {
+namespace detail {
+// The number of spans which enclose a sample on the sample's thread, as
+// stored in the sample's record.
+//
+// Depths greater than max_recorded_span_depth are recorded as
+// max_recorded_span_depth.
+using recorded_span_depth = std::uint8_t;
+
+inline constexpr auto max_recorded_span_depth =
+  std::numeric_limits<recorded_span_depth>::max();
+
+// The number of spans which the calling thread has entered but not exited in
+// storages of type Storage.
+//
+// Each storage type has its own depth, so spans recorded in one storage do not
+// nest the samples of another storage. (Like the per-thread data of
+// thread-local storages, the depth is shared by storages of the same type.)
+//
+// span_guard, complete_span_guard, and phases_guard increment
+// current_thread_span_depth after adding a span's enter sample and decrement it
+// before adding a span's exit sample, so a span's enter and exit samples have
+// the same depth.
+template<class Storage>
+inline thread_local std::uint32_t current_thread_span_depth = 0;
+
+template<class Storage>
+inline auto
+get_current_thread_span_depth() noexcept -> recorded_span_depth
+{
+  return static_cast<recorded_span_depth>(
+    std::min(current_thread_span_depth<Storage>,
+             std::uint32_t{ max_recorded_span_depth }));
+}
+}
+}
+
+#endif
@@ -2,18 +2,21 @@
 #define CXXTRACE_DETAIL_SPSC_RING_QUEUE_H
 
 #include <algorithm>
-#include <array>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cxxtrace/detail/add.h>
 #include <cxxtrace/detail/debug_source_location.h>
 #include <cxxtrace/detail/molecular.h>
 #include <cxxtrace/detail/real_synchronization.h>
+#include <cxxtrace/detail/ring_buffer.h>
+#include <cxxtrace/ring_queue_overflow_policy.h>
 #include <limits>
-#include <type_traits> // IWYU pragma: keep
+#include <optional>
+#include <type_traits>
 #include <utility>
 
 namespace cxxtrace {
@@ -23,61 +26,115 @@ namespace detail {
 // Special-purpose: Items in a spsc_ring_queue must be trivial. Constructors and
 // destructors are not called on a spsc_ring_queue's items.
 //
-// Lossy: If a writer pushes too many items, older items are discarded.
+// Lossy: If a writer pushes too many items, older items are discarded. If
+// Overflow is ring_queue_overflow_policy::drop_newest, the pushed items are
+// discarded instead. pop_all_into reports how many items were discarded.
 //
 // Bounded: The maximum number of items allowed in a spsc_ring_queue is fixed.
-// Operations on a spsc_ring_queue will never allocate memory.
+// If Capacity is dynamic_capacity, the maximum is chosen when the
+// spsc_ring_queue is constructed. Operations on a spsc_ring_queue will
+// never allocate memory.
 //
 // SPSC: A single thread can push items ("Single Producer"), and a single thread
 // can pop items ("Single Consumer").
 //
 // FIFO: Items are read First In, First Out.
 //
-// TODO(strager): Add an API for the reader to detect when items are discarded.
+// Index counts every item ever pushed, and pushing aborts the program if the
+// count would overflow Index. The default, std::uint64_t, lets a writer push
+// a billion items per second for centuries.
 //
 // @see ring_queue
 // @see mpsc_ring_queue
 template<class T,
          std::size_t Capacity,
-         class Index = int,
-         class Sync = real_synchronization>
+         class Index = std::uint64_t,
+         class Sync = real_synchronization,
+         ring_queue_overflow_policy Overflow =
+           ring_queue_overflow_policy::overwrite_oldest>
 class spsc_ring_queue
 {
 public:
-  static_assert(Capacity > 0);
   static_assert(std::is_integral_v<Index>, "Index must be an integral type");
   static_assert(
-    std::numeric_limits<Index>::max() >= Capacity - 1,
+    Capacity == dynamic_capacity ||
+      std::numeric_limits<Index>::max() >= Capacity - 1,
     "Index must be able to contain non-negative integers less than Capacity");
   static_assert(std::is_trivial_v<T>, "T must be a trivial type");
 
   using size_type = Index;
   using value_type = T;
 
+  // The maximum number of items, or dynamic_capacity if the capacity is chosen
+  // at run time.
+  //
+  // @see get_capacity
   static inline constexpr const auto capacity = size_type{ Capacity };
 
+  spsc_ring_queue() noexcept = default;
+
+  // Create a queue which holds at least minimum_capacity items, rounded up to
+  // a power of two. Capacity must be dynamic_capacity.
+  template<std::size_t C = Capacity,
+           class = std::enable_if_t<C == dynamic_capacity>>
+  explicit spsc_ring_queue(size_type minimum_capacity) noexcept(false)
+    : storage{ static_cast<std::size_t>(minimum_capacity) }
+  {
+    assert(this->storage.capacity() - 1 <=
+           static_cast<std::size_t>(std::numeric_limits<size_type>::max()));
+  }
+
+  auto get_capacity() const noexcept -> size_type
+  {
+    return static_cast<size_type>(this->storage.capacity());
+  }
+
   auto reset() noexcept -> void
   {
     this->read_vindex.store(0, CXXTRACE_HERE);
     this->write_begin_vindex.store(0, CXXTRACE_HERE);
     this->write_end_vindex.store(0, CXXTRACE_HERE);
+    this->cached_read_vindex.store(0, CXXTRACE_HERE);
+    this->dropped_item_count.store(0, CXXTRACE_HERE);
+    this->reported_dropped_item_count.store(0, CXXTRACE_HERE);
   }
 
   template<class WriterFunction>
   auto push(size_type count, WriterFunction&& write) noexcept -> void
   {
+    if constexpr (Overflow == ring_queue_overflow_policy::drop_newest) {
+      auto vindexes = this->begin_push_if_room(count);
+      if (!vindexes.has_value()) {
+        this->dropped_item_count.fetch_add(
+          count, std::memory_order_relaxed, CXXTRACE_HERE);
+        return;
+      }
+      auto [begin_vindex, end_vindex] = *vindexes;
+      write(push_handle{ this->storage, begin_vindex });
+      this->end_push(end_vindex);
+      return;
+    }
+
     auto [begin_vindex, end_vindex] = this->begin_push(count);
     write(push_handle{ this->storage, begin_vindex });
     this->end_push(end_vindex);
   }
 
+  // Move all items into output, and return the number of items which were
+  // discarded (i.e. overwritten by writers before they could be popped, or
+  // dropped because the queue was full) since the previous call to
+  // pop_all_into or reset.
   template<class Sink>
-  auto pop_all_into(Sink&& output) -> void
+  auto pop_all_into(Sink&& output) -> size_type
   {
+    if constexpr (Overflow == ring_queue_overflow_policy::drop_newest) {
+      return this->pop_all_without_overwrites_into(output);
+    }
+
     // TODO(strager): Consolidate duplication with mpsc_ring_queue.
     auto read_vindex = this->read_vindex.load(CXXTRACE_HERE);
 
-    auto get_begin_vindex = [&read_vindex](
+    auto get_begin_vindex = [&read_vindex, capacity = this->get_capacity()](
                               size_type write_end_vindex) noexcept->size_type
     {
       if (write_end_vindex > capacity) {
@@ -102,10 +159,12 @@ public:
       end_vindex = write_begin_vindex;
       output.reserve_back(end_vindex - begin_vindex);
       for (auto i = begin_vindex; i < end_vindex; ++i) {
-        output.push_back(this->storage[i % this->capacity].load(CXXTRACE_HERE));
+        output.push_back(this->storage[i].load(CXXTRACE_HERE));
       }
     }
     auto output_item_count = end_vindex - begin_vindex;
+    auto discarded_item_count =
+      static_cast<size_type>(begin_vindex - read_vindex);
 
     if (output_item_count > 0) {
       Sync::atomic_thread_fence(std::memory_order_seq_cst, CXXTRACE_HERE);
@@ -121,11 +180,13 @@ public:
           auto items_to_unoutput =
             std::min(new_begin_vindex - begin_vindex, output_item_count);
           output.pop_front_n(items_to_unoutput);
+          discarded_item_count += items_to_unoutput;
         }
       }
     }
 
     this->read_vindex.store(end_vindex, CXXTRACE_HERE);
+    return discarded_item_count;
   }
 
 private:
@@ -134,25 +195,29 @@ private:
   template<class U>
   using nonatomic = typename Sync::template nonatomic<U>;
 
+  // Align storage like value_type so items which tile cache lines (such as
+  // sample_record-s) are not split across cache lines.
+  using storage_type =
+    ring_buffer<molecular<value_type, Sync>, Capacity, alignof(value_type)>;
+
   class push_handle
   {
   public:
     auto set(size_type index, T value) noexcept -> void
     {
       Sync::allow_preempt(CXXTRACE_HERE);
-      this->storage[(this->write_begin_vindex + index) % capacity].store(
+      this->storage[this->write_begin_vindex + index].store(
         std::move(value), CXXTRACE_HERE);
     }
 
   private:
-    explicit push_handle(
-      std::array<molecular<value_type, Sync>, capacity>& storage,
-      size_type write_begin_vindex) noexcept
+    explicit push_handle(storage_type& storage,
+                         size_type write_begin_vindex) noexcept
       : storage{ storage }
       , write_begin_vindex{ write_begin_vindex }
     {}
 
-    std::array<molecular<value_type, Sync>, capacity>& storage;
+    storage_type& storage;
     size_type write_begin_vindex{ 0 };
 
     friend class spsc_ring_queue;
@@ -161,7 +226,7 @@ private:
   auto begin_push(size_type count) noexcept -> std::pair<size_type, size_type>
   {
     assert(count > 0);
-    assert(count < this->capacity);
+    assert(count < this->get_capacity());
 
     Sync::allow_preempt(CXXTRACE_HERE);
     auto write_begin_vindex =
@@ -179,6 +244,38 @@ private:
     return { write_begin_vindex, *maybe_new_write_end_vindex };
   }
 
+  // Reserve count items, or return nullopt if the reader has not popped
+  // enough items to make room for them.
+  //
+  // The reader's index is cached, so begin_push_if_room usually does not
+  // touch the reader's cache line.
+  auto begin_push_if_room(size_type count) noexcept
+    -> std::optional<std::pair<size_type, size_type>>
+  {
+    assert(count > 0);
+    assert(count < this->get_capacity());
+
+    auto write_begin_vindex =
+      this->write_begin_vindex.load(std::memory_order_relaxed, CXXTRACE_HERE);
+    auto maybe_new_write_end_vindex = add(write_begin_vindex, count);
+    if (!maybe_new_write_end_vindex.has_value()) {
+      this->abort_due_to_overflow();
+    }
+    auto new_write_end_vindex = *maybe_new_write_end_vindex;
+    auto capacity = this->get_capacity();
+    auto cached_read_vindex = this->cached_read_vindex.load(CXXTRACE_HERE);
+    if (new_write_end_vindex - cached_read_vindex > capacity) {
+      Sync::allow_preempt(CXXTRACE_HERE);
+      cached_read_vindex =
+        this->read_vindex.load(std::memory_order_acquire, CXXTRACE_HERE);
+      this->cached_read_vindex.store(cached_read_vindex, CXXTRACE_HERE);
+      if (new_write_end_vindex - cached_read_vindex > capacity) {
+        return std::nullopt;
+      }
+    }
+    return std::pair{ write_begin_vindex, new_write_end_vindex };
+  }
+
   auto end_push(size_type write_end_vindex) noexcept -> void
   {
     Sync::allow_preempt(CXXTRACE_HERE);
@@ -186,6 +283,33 @@ private:
       write_end_vindex, std::memory_order_release, CXXTRACE_HERE);
   }
 
+  // Like pop_all_into, but for queues whose writers never overwrite items
+  // which have not been popped.
+  template<class Sink>
+  auto pop_all_without_overwrites_into(Sink& output) -> size_type
+  {
+    auto read_vindex = this->read_vindex.load(CXXTRACE_HERE);
+    auto end_vindex =
+      this->write_begin_vindex.load(std::memory_order_acquire, CXXTRACE_HERE);
+    assert(read_vindex <= end_vindex);
+    output.reserve_back(end_vindex - read_vindex);
+    for (auto i = read_vindex; i < end_vindex; ++i) {
+      output.push_back(this->storage[i].load(CXXTRACE_HERE));
+    }
+    // Release the popped items' slots to the writer.
+    this->read_vindex.store(
+      end_vindex, std::memory_order_release, CXXTRACE_HERE);
+
+    auto dropped_item_count =
+      this->dropped_item_count.load(std::memory_order_relaxed, CXXTRACE_HERE);
+    auto reported_dropped_item_count =
+      this->reported_dropped_item_count.load(CXXTRACE_HERE);
+    auto discarded_item_count =
+      static_cast<size_type>(dropped_item_count - reported_dropped_item_count);
+    this->reported_dropped_item_count.store(dropped_item_count, CXXTRACE_HERE);
+    return discarded_item_count;
+  }
+
   [[noreturn]] auto abort_due_to_overflow() const noexcept -> void
   {
     std::fprintf(stderr, "fatal: Writer overflowed size_type\n");
@@ -193,12 +317,17 @@ private:
   }
 
   // 'vindex' is an abbreviation for 'virtual index'.
-  nonatomic<size_type> read_vindex{ 0 };
+  atomic<size_type> read_vindex{ 0 };
   atomic<size_type> write_begin_vindex{ 0 };
   atomic<size_type> write_end_vindex{ 0 };
 
-  std::array<molecular<value_type, Sync>, capacity> storage
-    /* uninitialized */;
+  // Used only if Overflow is drop_newest. cached_read_vindex is accessed only
+  // by the writer, and reported_dropped_item_count only by the reader.
+  nonatomic<size_type> cached_read_vindex{ 0 };
+  atomic<size_type> dropped_item_count{ 0 };
+  nonatomic<size_type> reported_dropped_item_count{ 0 };
+
+  storage_type storage;
 };
 }
 }
@@ -0,0 +1,62 @@
+#ifndef CXXTRACE_DETAIL_THREAD_INDEX_H
+#define CXXTRACE_DETAIL_THREAD_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cxxtrace/thread.h>
+#include <limits>
+
+namespace cxxtrace {
+namespace detail {
+// A small number identifying a thread within this process.
+//
+// Samples store a thread_index instead of a thread_id, keeping sample records
+// small. A thread registry assigns indexes densely (starting at 0) the first
+// time a thread ID is seen, and snapshots convert indexes back into thread
+// IDs with thread_id_of_index.
+//
+// A thread's index is released when the thread exits. Samples recorded before
+// the thread exited keep the index, so a released index is reused only after
+// every other index has been assigned, and released indexes are reused in the
+// order they were released.
+using thread_index = std::uint16_t;
+
+// The index given to threads if every other index is assigned to a live thread.
+// thread_id_of_index(unknown_thread_index) returns thread_id{}.
+inline constexpr auto unknown_thread_index =
+  std::numeric_limits<thread_index>::max();
+
+// The number of threads which can be registered.
+inline constexpr auto max_thread_index_count =
+  std::size_t{ unknown_thread_index };
+
+// Return the calling thread's index, registering the thread if necessary. The
+// index is released when the calling thread exits.
+//
+// After the first call on a thread, get_current_thread_index does not lock.
+auto
+get_current_thread_index() noexcept -> thread_index;
+
+// Return the index of the thread with the given ID, registering the thread if
+// necessary.
+//
+// thread_index_of_id locks the registry. Prefer get_current_thread_index.
+auto
+thread_index_of_id(thread_id) noexcept -> thread_index;
+
+// Allow the index of a registered thread to be given to another thread.
+//
+// After release_thread_index, thread_id_of_index(index) still returns the
+// released thread's ID until the index is reused.
+auto
+release_thread_index(thread_index) noexcept -> void;
+
+// Return the ID of a registered or released thread.
+//
+// thread_id_of_index does not lock.
+auto
+thread_id_of_index(thread_index) noexcept -> thread_id;
+}
+}
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef CXXTRACE_DETAIL_THREAD_LOCAL_RECORD_H
+#define CXXTRACE_DETAIL_THREAD_LOCAL_RECORD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <limits>
+#include <optional>
+
+namespace cxxtrace {
+namespace detail {
+// Encodes samples into a thread-local storage's queue.
+//
+// If ClockSample is delta-encodable, each sample record holds a 32-bit
+// difference from the most recent time_base record. A time_base record is
+// written before a sample if the difference would not fit, and periodically so
+// that a lossy queue does not discard many samples' time_base record.
+//
+// A thread_local_record_encoder is used only by the thread which owns the
+// queue.
+//
+// @see thread_local_record_decoder
+template<class ClockSample>
+class thread_local_record_encoder
+{
+public:
+  using sample = thread_local_sample<ClockSample>;
+  using record = sample_record<sample>;
+
+  struct encoded_sample
+  {
+    // The number of records to push before sample.
+    auto extra_record_count() const noexcept -> std::size_t
+    {
+      return this->time_base.has_value() ? 1 : 0;
+    }
+
+    // If present, the record to push before sample.
+    std::optional<record> time_base;
+    record sample;
+  };
+
+  // The number of records which encode can add for one sample (in addition to
+  // the sample's own records).
+  static constexpr auto max_extra_record_count = std::size_t{ 1 };
+
+  // Encode a sample which will be followed by sample_record_count records
+  // (including its own) in a queue holding queue_capacity records.
+  auto encode(sample_site_local_data site,
+              ClockSample time_point,
+              std::size_t sample_record_count,
+              std::size_t queue_capacity) noexcept -> encoded_sample
+  {
+    if constexpr (is_delta_encodable_clock_sample<ClockSample>) {
+      auto encoded = encoded_sample{};
+      auto delta = static_cast<std::uint64_t>(time_point) -
+                   static_cast<std::uint64_t>(this->time_base);
+      auto period = std::max(queue_capacity / time_base_periods_per_queue,
+                             std::size_t{ 1 });
+      if (!this->have_time_base ||
+          delta > std::numeric_limits<std::uint32_t>::max() ||
+          this->records_since_time_base + sample_record_count > period) {
+        this->have_time_base = true;
+        this->time_base = time_point;
+        this->time_base_generation += 1;
+        this->records_since_time_base = 0;
+        delta = 0;
+
+        auto& base = encoded.time_base.emplace();
+        base.kind = sample_record_kind::time_base;
+        base.time_base_generation = this->time_base_generation;
+        base.time_base = time_point;
+      }
+      this->records_since_time_base += sample_record_count;
+
+      encoded.sample = record::from_sample(sample{ site });
+      encoded.sample.time_base_generation = this->time_base_generation;
+      encoded.sample.time_delta = static_cast<std::uint32_t>(delta);
+      return encoded;
+    } else {
+      static_cast<void>(sample_record_count);
+      static_cast<void>(queue_capacity);
+      return encoded_sample{ std::nullopt,
+                             record::from_sample(sample{ site, time_point }) };
+    }
+  }
+
+  // Write a time_base record before the next sample. Call this if the queue's
+  // records were discarded.
+  auto reset() noexcept -> void { this->have_time_base = false; }
+
+private:
+  // A queue's oldest samples are discarded if their time_base record is
+  // overwritten. Writing several time_base records per queue length limits
+  // such losses to a fraction of the queue.
+  static constexpr auto time_base_periods_per_queue = std::size_t{ 8 };
+
+  bool have_time_base{ false };
+  ClockSample time_base{};
+  std::uint16_t time_base_generation{ 0 };
+  std::size_t records_since_time_base{ 0 };
+};
+
+// Converts a thread-local storage's records into global records, decoding
+// delta-encoded time points.
+//
+// Sample records whose time_base record was discarded (e.g. because a lossy
+// queue overwrote it) are converted into discarded records. A time_base record
+// is remembered across calls to decode, so samples can be decoded even if
+// their time_base record was taken in an earlier snapshot.
+//
+// Generations are 16 bits, so in theory a sample whose time_base record was
+// lost could be matched with a remembered time_base from 65536 generations
+// earlier. This requires the queue to overflow many times between snapshots.
+//
+// @see thread_local_record_encoder
+template<class ClockSample>
+class thread_local_record_decoder
+{
+public:
+  using thread_local_record = sample_record<thread_local_sample<ClockSample>>;
+  using global_record = sample_record<global_sample<ClockSample>>;
+
+  auto decode(const thread_local_record& record, thread_index thread) noexcept
+    -> global_record
+  {
+    if constexpr (is_delta_encodable_clock_sample<ClockSample>) {
+      switch (record.kind) {
+        case sample_record_kind::time_base:
+          this->have_time_base = true;
+          this->time_base = record.time_base;
+          this->time_base_generation = record.time_base_generation;
+          break;
+        case sample_record_kind::sample:
+          if (this->have_time_base &&
+              this->time_base_generation == record.time_base_generation) {
+            auto time_point = static_cast<ClockSample>(
+              static_cast<std::uint64_t>(this->time_base) + record.time_delta);
+            auto site = record.get_sample().site;
+            auto decoded = global_record::from_sample(
+              global_sample<ClockSample>{ site, time_point }, thread);
+            decoded.depth = record.depth;
+            return decoded;
+          }
+          return discarded_record();
+        case sample_record_kind::argument:
+        case sample_record_kind::argument_value:
+        case sample_record_kind::argument_bytes:
+        case sample_record_kind::event_id:
+        case sample_record_kind::end_time_point:
+        case sample_record_kind::dynamic_category:
+        case sample_record_kind::dynamic_name:
+        case sample_record_kind::discarded:
+          break;
+      }
+    }
+    return global_record::from_thread_local_record(record, thread);
+  }
+
+  // Forget the remembered time_base record. Call this if the queue's records
+  // were discarded.
+  auto reset() noexcept -> void { this->have_time_base = false; }
+
+private:
+  static auto discarded_record() noexcept -> global_record
+  {
+    global_record record;
+    record.kind = sample_record_kind::discarded;
+    return record;
+  }
+
+  bool have_time_base{ false };
+  ClockSample time_base{};
+  std::uint16_t time_base_generation{ 0 };
+};
+}
+}
+
+#endif
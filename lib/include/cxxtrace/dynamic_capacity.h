@@ -0,0 +1,14 @@
+#ifndef CXXTRACE_DYNAMIC_CAPACITY_H
+#define CXXTRACE_DYNAMIC_CAPACITY_H
+
+#include <cstddef>
+
+namespace cxxtrace {
+// Pass dynamic_capacity as a ring queue storage's Capacity to choose the
+// storage's capacity at run time instead of at compile time. Such storages
+// take their capacity as a constructor argument and allocate their buffer on
+// the heap.
+inline constexpr auto dynamic_capacity = std::size_t{ 0 };
+}
+
+#endif
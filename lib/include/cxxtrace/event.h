@@ -0,0 +1,113 @@
+#ifndef CXXTRACE_EVENT_H
+#define CXXTRACE_EVENT_H
+
+#include <cstdint>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/sample.h>
+#include <cxxtrace/span_argument.h> // IWYU pragma: export
+#include <cxxtrace/string.h>
+#include <type_traits>
+
+namespace cxxtrace {
+// CXXTRACE_INSTANT_WITH_CONFIG(config, category, name, arguments...)
+//
+// Record a single sample marking a point in time. Each argument is a
+// cxxtrace::span_argument.
+#define CXXTRACE_INSTANT_WITH_CONFIG(config, category, ...)                    \
+  (::cxxtrace::detail::add_event((config).storage(),                           \
+                                 (config).clock(),                             \
+                                 CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),          \
+                                 ::cxxtrace::sample_kind::instant,             \
+                                 (category),                                   \
+                                 __VA_ARGS__))
+
+// CXXTRACE_COUNTER_WITH_CONFIG(config, category, name, arguments...)
+//
+// Record a single sample holding the current values of one or more counters
+// (such as a queue's depth). Each argument is a cxxtrace::span_argument naming
+// one counter series; arguments should be numbers.
+#define CXXTRACE_COUNTER_WITH_CONFIG(config, category, ...)                    \
+  (::cxxtrace::detail::add_event((config).storage(),                           \
+                                 (config).clock(),                             \
+                                 CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),          \
+                                 ::cxxtrace::sample_kind::counter,             \
+                                 (category),                                   \
+                                 __VA_ARGS__))
+
+// CXXTRACE_ASYNC_BEGIN_WITH_CONFIG(config, category, name, id, arguments...)
+// CXXTRACE_ASYNC_END_WITH_CONFIG(config, category, name, id, arguments...)
+//
+// Record the beginning or end of an asynchronous operation. The operation is
+// identified by its category, name, and id (a std::uint64_t), and can begin
+// and end on different threads.
+#define CXXTRACE_ASYNC_BEGIN_WITH_CONFIG(config, category, ...)                \
+  (::cxxtrace::detail::add_event_with_id((config).storage(),                   \
+                                         (config).clock(),                     \
+                                         CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),  \
+                                         ::cxxtrace::sample_kind::async_begin, \
+                                         (category),                           \
+                                         __VA_ARGS__))
+#define CXXTRACE_ASYNC_END_WITH_CONFIG(config, category, ...)                  \
+  (::cxxtrace::detail::add_event_with_id((config).storage(),                   \
+                                         (config).clock(),                     \
+                                         CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),  \
+                                         ::cxxtrace::sample_kind::async_end,   \
+                                         (category),                           \
+                                         __VA_ARGS__))
+
+// CXXTRACE_FLOW_START_WITH_CONFIG(config, category, name, id, arguments...)
+// CXXTRACE_FLOW_STEP_WITH_CONFIG(config, category, name, id, arguments...)
+// CXXTRACE_FLOW_END_WITH_CONFIG(config, category, name, id, arguments...)
+//
+// Record a causal link between the enclosing spans of samples with the same
+// id (a std::uint64_t), such as a task being posted then run on another
+// thread.
+#define CXXTRACE_FLOW_START_WITH_CONFIG(config, category, ...)                 \
+  (::cxxtrace::detail::add_event_with_id((config).storage(),                   \
+                                         (config).clock(),                     \
+                                         CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),  \
+                                         ::cxxtrace::sample_kind::flow_start,  \
+                                         (category),                           \
+                                         __VA_ARGS__))
+#define CXXTRACE_FLOW_STEP_WITH_CONFIG(config, category, ...)                  \
+  (::cxxtrace::detail::add_event_with_id((config).storage(),                   \
+                                         (config).clock(),                     \
+                                         CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),  \
+                                         ::cxxtrace::sample_kind::flow_step,   \
+                                         (category),                           \
+                                         __VA_ARGS__))
+#define CXXTRACE_FLOW_END_WITH_CONFIG(config, category, ...)                   \
+  (::cxxtrace::detail::add_event_with_id((config).storage(),                   \
+                                         (config).clock(),                     \
+                                         CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),  \
+                                         ::cxxtrace::sample_kind::flow_end,    \
+                                         (category),                           \
+                                         __VA_ARGS__))
+
+namespace detail {
+template<class Storage, class Clock, class... Arguments>
+auto
+add_event(Storage&,
+          Clock&,
+          sample_site_cache&,
+          sample_kind,
+          czstring category,
+          czstring name,
+          const Arguments&...) noexcept(false) -> void;
+
+template<class Storage, class Clock, class... Arguments>
+auto
+add_event_with_id(Storage&,
+                  Clock&,
+                  sample_site_cache&,
+                  sample_kind,
+                  czstring category,
+                  czstring name,
+                  std::uint64_t id,
+                  const Arguments&...) noexcept(false) -> void;
+}
+}
+
+#include <cxxtrace/event_impl.h> // IWYU pragma: export
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CXXTRACE_EVENT_IMPL_H
+#define CXXTRACE_EVENT_IMPL_H
+
+#if !defined(CXXTRACE_EVENT_H)
+#error                                                                         \
+  "Include <cxxtrace/event.h> instead of including <cxxtrace/event_impl.h> directly."
+#endif
+
+#include <cstdint>
+#include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/sample.h>
+#include <cxxtrace/string.h>
+#include <optional>
+
+namespace cxxtrace {
+namespace detail {
+template<class Storage, class Clock, class... Arguments>
+auto
+add_event(Storage& storage,
+          Clock& clock,
+          sample_site_cache& site_cache,
+          sample_kind kind,
+          czstring category,
+          czstring name,
+          const Arguments&... arguments) noexcept(false) -> void
+{
+  add_sample_with_arguments(storage,
+                            site_cache.get(category, name),
+                            kind,
+                            clock.query(),
+                            std::nullopt,
+                            arguments...);
+}
+
+template<class Storage, class Clock, class... Arguments>
+auto
+add_event_with_id(Storage& storage,
+                  Clock& clock,
+                  sample_site_cache& site_cache,
+                  sample_kind kind,
+                  czstring category,
+                  czstring name,
+                  std::uint64_t id,
+                  const Arguments&... arguments) noexcept(false) -> void
+{
+  add_sample_with_arguments(storage,
+                            site_cache.get(category, name),
+                            kind,
+                            clock.query(),
+                            id,
+                            arguments...);
+}
+}
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CXXTRACE_HARDWARE_COUNTERS_H
+#define CXXTRACE_HARDWARE_COUNTERS_H
+
+#include <cstdint>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/detail/have.h>
+#include <limits>
+#include <type_traits>
+
+namespace cxxtrace {
+// Values of the processor's performance counters, counted for one thread.
+struct hardware_counters
+{
+  std::uint64_t cycles;
+  std::uint64_t instructions;
+  // Last-level cache misses.
+  std::uint64_t llc_misses;
+
+  // False if these are unavailable_hardware_counters.
+  constexpr auto available() const noexcept -> bool
+  {
+    return this->cycles != std::numeric_limits<std::uint64_t>::max();
+  }
+};
+
+// The counters a reader returns if it cannot read the current thread's
+// counters. Snapshots report such samples as having no counters.
+inline constexpr auto unavailable_hardware_counters =
+  hardware_counters{ std::numeric_limits<std::uint64_t>::max(), 0, 0 };
+
+// Subtract each counter. The result is unavailable if either operand is.
+auto
+operator-(const hardware_counters&, const hardware_counters&) noexcept
+  -> hardware_counters;
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+// Read hardware counters using Linux' perf_event_open(2).
+//
+// Each thread opens its own counters the first time it calls read. After that,
+// read uses the rdpmc instruction on the counters' mmap-ed pages and does not
+// make any system calls. If the kernel does not allow rdpmc, read falls back to
+// read(2).
+//
+// If a thread's counters cannot be opened (for example, because the thread
+// was created after the process hit its file descriptor limit), read returns
+// unavailable_hardware_counters for that thread without retrying.
+class perf_event_counter_reader
+{
+public:
+  static auto supported() noexcept -> bool;
+
+  auto read() noexcept(false) -> hardware_counters;
+};
+#endif
+
+// A clock which additionally records the current thread's hardware counters
+// with each sample.
+//
+// When used with a span, the difference between the span's exit and enter
+// samples tells how many cycles, instructions, and cache misses the span
+// spent, and chrome_trace_event_writer reports those differences as the span's
+// arguments.
+//
+// CounterReader must have a static supported() member function and a read()
+// member function returning hardware_counters, such as
+// perf_event_counter_reader.
+template<class Clock, class CounterReader>
+class hardware_counter_clock : public clock_base
+{
+public:
+  struct sample
+  {
+    typename Clock::sample time;
+    hardware_counters counters;
+  };
+
+  inline static constexpr auto traits = Clock::traits;
+
+  static auto supported() noexcept -> bool;
+
+  auto query() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+
+  auto clock() noexcept -> Clock&;
+  auto counter_reader() noexcept -> CounterReader&;
+
+private:
+  Clock clock_;
+  CounterReader counter_reader_;
+};
+
+namespace detail {
+template<class Clock>
+struct clock_has_hardware_counters : std::false_type
+{};
+
+template<class Clock, class CounterReader>
+struct clock_has_hardware_counters<hardware_counter_clock<Clock, CounterReader>>
+  : std::true_type
+{};
+}
+}
+
+#include <cxxtrace/hardware_counters_impl.h> // IWYU pragma: export
+
+#endif
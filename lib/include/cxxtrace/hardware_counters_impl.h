@@ -0,0 +1,50 @@
+#ifndef CXXTRACE_HARDWARE_COUNTERS_IMPL_H
+#define CXXTRACE_HARDWARE_COUNTERS_IMPL_H
+
+#if !defined(CXXTRACE_HARDWARE_COUNTERS_H)
+#error                                                                         \
+  "Include <cxxtrace/hardware_counters.h> instead of including <cxxtrace/hardware_counters_impl.h> directly."
+#endif
+
+namespace cxxtrace {
+template<class Clock, class CounterReader>
+auto
+hardware_counter_clock<Clock, CounterReader>::supported() noexcept -> bool
+{
+  return CounterReader::supported();
+}
+
+template<class Clock, class CounterReader>
+auto
+hardware_counter_clock<Clock, CounterReader>::query() -> sample
+{
+  auto time = this->clock_.query();
+  auto counters = this->counter_reader_.read();
+  return sample{ time, counters };
+}
+
+template<class Clock, class CounterReader>
+auto
+hardware_counter_clock<Clock, CounterReader>::make_time_point(
+  const sample& sample) -> time_point
+{
+  return this->clock_.make_time_point(sample.time);
+}
+
+template<class Clock, class CounterReader>
+auto
+hardware_counter_clock<Clock, CounterReader>::clock() noexcept -> Clock&
+{
+  return this->clock_;
+}
+
+template<class Clock, class CounterReader>
+auto
+hardware_counter_clock<Clock, CounterReader>::counter_reader() noexcept
+  -> CounterReader&
+{
+  return this->counter_reader_;
+}
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef CXXTRACE_INTERNED_STRING_H
+#define CXXTRACE_INTERNED_STRING_H
+
+#include <cxxtrace/string.h>
+#include <string_view>
+
+namespace cxxtrace {
+// Return a null-terminated copy of string which is never destroyed.
+//
+// Interning equal strings returns the same pointer, so an interned string can
+// be used as a span's category or name even if the span's name is computed at
+// run time (e.g. an RPC method name).
+//
+// intern_string is thread-safe. Strings which were recently interned by the
+// calling thread are found without touching shared memory; other strings are
+// found or added with a lock-free hash table.
+auto
+intern_string(std::string_view string) noexcept(false) -> czstring;
+}
+
+#endif
@@ -1,14 +1,17 @@
 #ifndef CXXTRACE_MPSC_RING_QUEUE_PROCESSOR_LOCAL_STORAGE_H
 #define CXXTRACE_MPSC_RING_QUEUE_PROCESSOR_LOCAL_STORAGE_H
 
+#include <chrono>
 #include <cstddef>
+#include <deque>
 #include <cxxtrace/detail/lazy_thread_local.h>
 #include <cxxtrace/detail/mpsc_ring_queue.h>
 #include <cxxtrace/detail/processor.h>
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/dynamic_capacity.h> // IWYU pragma: export
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <mutex>
 #include <vector>
 
@@ -19,6 +22,11 @@ class mpsc_ring_queue_processor_local_storage
 {
 public:
   explicit mpsc_ring_queue_processor_local_storage() noexcept(false);
+  // Create a storage whose per-processor queues each hold at least
+  // minimum_capacity_per_processor sample records (rounded up to a power of
+  // two). CapacityPerProcessor must be dynamic_capacity.
+  explicit mpsc_ring_queue_processor_local_storage(
+    std::size_t minimum_capacity_per_processor) noexcept(false);
   ~mpsc_ring_queue_processor_local_storage() noexcept;
 
   mpsc_ring_queue_processor_local_storage(
@@ -34,17 +42,28 @@ public:
 
   auto add_sample(detail::sample_site_local_data,
                   ClockSample time_point,
-                  thread_id) noexcept -> void;
+                  detail::thread_index,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   auto add_sample(detail::sample_site_local_data,
-                  ClockSample time_point) noexcept -> void;
+                  ClockSample time_point,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
 
+  // Measure how far each processor's clock is ahead of a reference processor's
+  // clock (see detail::measure_processor_clock_offsets).
+  //
+  // Later calls to take_all_samples subtract each processor's offset from the
+  // timestamps of samples added on that processor, then merge the samples.
+  template<class Clock>
+  auto measure_clock_skew(Clock&) noexcept(false) -> void;
+
 private:
   using sample = detail::global_sample<ClockSample>;
+  using record = detail::sample_record<sample>;
   using processor_samples =
-    detail::mpsc_ring_queue<sample, CapacityPerProcessor>;
+    detail::mpsc_ring_queue<record, CapacityPerProcessor>;
 
   using processor_id_lookup_thread_local_cache =
     typename detail::processor_id_lookup::thread_local_cache;
@@ -52,9 +71,13 @@ private:
   auto take_remembered_thread_names() -> detail::thread_name_set;
 
   detail::processor_id_lookup processor_id_lookup;
-  std::vector<processor_samples> samples_by_processor;
+  // A deque rather than a vector because queues cannot be moved, so
+  // runtime-sized queues must be constructed in place one by one.
+  std::deque<processor_samples> samples_by_processor;
 
   std::mutex pop_samples_mutex;
+  // Protected by pop_samples_mutex.
+  std::vector<std::chrono::nanoseconds> processor_clock_offsets;
 
   std::mutex remembered_thread_names_mutex;
   detail::thread_name_set remembered_thread_names;
@@ -7,7 +7,11 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <cxxtrace/detail/clock_skew.h>
 #include <cxxtrace/detail/debug_source_location.h>
 #include <cxxtrace/detail/mpsc_ring_queue.h>
 #include <cxxtrace/detail/processor.h>
@@ -16,10 +20,12 @@
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/snapshot_sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/thread.h>
 #include <mutex>
 #include <new>
+#include <optional>
 #include <utility>
 #include <vector>
 // IWYU pragma: no_include <cxxtrace/clock.h>
@@ -31,7 +37,24 @@ mpsc_ring_queue_processor_local_storage<
   Tag,
   ClockSample>::mpsc_ring_queue_processor_local_storage() noexcept(false)
   : samples_by_processor{ detail::get_maximum_processor_id() + 1 }
-{}
+{
+  static_assert(CapacityPerProcessor != dynamic_capacity,
+                "Pass the capacity per processor to the constructor");
+}
+
+template<std::size_t CapacityPerProcessor, class Tag, class ClockSample>
+mpsc_ring_queue_processor_local_storage<
+  CapacityPerProcessor,
+  Tag,
+  ClockSample>::mpsc_ring_queue_processor_local_storage(
+  std::size_t minimum_capacity_per_processor) noexcept(false)
+{
+  static_assert(CapacityPerProcessor == dynamic_capacity);
+  auto processor_count = detail::get_maximum_processor_id() + 1;
+  for (auto i = std::size_t{ 0 }; i < processor_count; ++i) {
+    this->samples_by_processor.emplace_back(minimum_capacity_per_processor);
+  }
+}
 
 template<std::size_t CapacityPerProcessor, class Tag, class ClockSample>
 mpsc_ring_queue_processor_local_storage<
@@ -55,33 +78,29 @@ auto
 mpsc_ring_queue_processor_local_storage<
   CapacityPerProcessor,
   Tag,
-  ClockSample>::add_sample(detail::sample_site_local_data site,
-                           ClockSample time_point,
-                           thread_id thread_id) noexcept -> void
+  ClockSample>::add_sample(
+  detail::sample_site_local_data site,
+  ClockSample time_point,
+  detail::thread_index thread,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
-  using detail::mpsc_ring_queue_push_result;
-
   auto& processor_id_cache = *this->processor_id_cache.get(
     [this](processor_id_lookup_thread_local_cache* uninitialized_cache) {
       return new (uninitialized_cache)
         processor_id_lookup_thread_local_cache{ this->processor_id_lookup };
     });
-  auto backoff = detail::real_synchronization::backoff{};
-retry:
   auto processor_id =
     this->processor_id_lookup.get_current_processor_id(processor_id_cache);
   auto& samples = this->samples_by_processor[processor_id];
-  auto result = samples.try_push(
-    1, [&](auto data) noexcept {
-      data.set(0, sample{ site, thread_id, time_point });
+  arguments =
+    detail::fit_sample_arguments<sample>(arguments, samples.get_capacity());
+  samples.push(
+    detail::sample_record_count<sample>(arguments), [&](auto data) noexcept {
+      detail::write_sample_records(
+        record::from_sample(sample{ site, time_point }, thread),
+        arguments,
+        [&](auto index, const record& r) noexcept { data.set(index, r); });
     });
-  switch (result) {
-    case mpsc_ring_queue_push_result::not_pushed_due_to_contention:
-      backoff.yield(CXXTRACE_HERE);
-      goto retry;
-    case mpsc_ring_queue_push_result::pushed:
-      break;
-  }
 }
 
 template<std::size_t CapacityPerProcessor, class Tag, class ClockSample>
@@ -89,10 +108,13 @@ auto
 mpsc_ring_queue_processor_local_storage<
   CapacityPerProcessor,
   Tag,
-  ClockSample>::add_sample(detail::sample_site_local_data site,
-                           ClockSample time_point) noexcept -> void
+  ClockSample>::add_sample(
+  detail::sample_site_local_data site,
+  ClockSample time_point,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
-  this->add_sample(site, time_point, get_current_thread_id());
+  this->add_sample(
+    site, time_point, detail::get_current_thread_index(), arguments);
 }
 
 template<std::size_t CapacityPerProcessor, class Tag, class ClockSample>
@@ -109,29 +131,39 @@ mpsc_ring_queue_processor_local_storage<
 
   static_assert(std::is_same_v<typename Clock::sample, ClockSample>);
 
+  auto clock_anchor = measure_wall_clock_anchor(clock);
+
   auto samples = std::vector<detail::snapshot_sample>{};
-  auto make_sample = [&](const sample& sample) noexcept->detail::snapshot_sample
-  {
-    return detail::snapshot_sample{ sample, clock };
-  };
-  auto snapshot_sample_less_by_clock =
-    [](const detail::snapshot_sample& x,
-       const detail::snapshot_sample& y) noexcept->bool
-  {
-    return x.timestamp < y.timestamp;
-  };
+  auto processor_raw_samples = std::vector<record>{};
+  auto processor_clock_offsets = std::vector<std::chrono::nanoseconds>{};
+  auto losses = std::vector<sample_loss>{};
   {
     auto guard = std::lock_guard<std::mutex>{ this->pop_samples_mutex };
+    processor_clock_offsets = this->processor_clock_offsets;
     // TODO(strager): Avoid excessive copying caused by vector resizes and
     // repeated calls to inplace_merge.
-    for (auto& processor_samples : this->samples_by_processor) {
+    for (auto processor_id = std::size_t{ 0 };
+         processor_id < this->samples_by_processor.size();
+         ++processor_id) {
+      auto& processor_samples = this->samples_by_processor[processor_id];
+      processor_raw_samples.clear();
+      auto discarded_record_count =
+        static_cast<std::size_t>(processor_samples.pop_all_into(
+          detail::vector_queue_sink{ processor_raw_samples }));
+      if (discarded_record_count > 0) {
+        losses.emplace_back(
+          sample_loss{ std::nullopt,
+                       static_cast<std::uint32_t>(processor_id),
+                       discarded_record_count });
+      }
       auto size_before = samples.size();
-      processor_samples.pop_all_into(
-        detail::transform_vector_queue_sink{ samples, make_sample });
-      std::inplace_merge(samples.begin(),
-                         samples.begin() + size_before,
-                         samples.end(),
-                         snapshot_sample_less_by_clock);
+      detail::snapshot_sample::many_from_records(
+        processor_raw_samples, clock, samples);
+      detail::merge_processor_samples(
+        samples,
+        size_before,
+        processor_clock_offsets.empty() ? std::chrono::nanoseconds{ 0 }
+                                        : processor_clock_offsets[processor_id]);
     }
   }
 
@@ -146,7 +178,34 @@ mpsc_ring_queue_processor_local_storage<
     }
   }
 
-  return samples_snapshot{ std::move(samples), std::move(thread_names) };
+  return samples_snapshot{ std::move(samples),
+                           std::move(thread_names),
+                           clock_anchor,
+                           std::move(processor_clock_offsets),
+                           std::move(losses) };
+}
+
+template<std::size_t CapacityPerProcessor, class Tag, class ClockSample>
+template<class Clock>
+auto
+mpsc_ring_queue_processor_local_storage<
+  CapacityPerProcessor,
+  Tag,
+  ClockSample>::measure_clock_skew(Clock& clock) noexcept(false) -> void
+{
+  static_assert(std::is_same_v<typename Clock::sample, ClockSample>);
+
+  auto get_processor_id = [this]() noexcept->detail::processor_id
+  {
+    auto cache =
+      processor_id_lookup_thread_local_cache{ this->processor_id_lookup };
+    return this->processor_id_lookup.get_current_processor_id(cache);
+  };
+  auto offsets = detail::measure_processor_clock_offsets(
+    clock, this->samples_by_processor.size() - 1, get_processor_id);
+
+  auto guard = std::lock_guard<std::mutex>{ this->pop_samples_mutex };
+  this->processor_clock_offsets = std::move(offsets);
 }
 
 template<std::size_t CapacityPerProcessor, class Tag, class ClockSample>
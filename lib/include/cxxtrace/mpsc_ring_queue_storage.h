@@ -2,20 +2,37 @@
 #define CXXTRACE_MPSC_RING_QUEUE_STORAGE_H
 
 #include <cstddef>
+#include <cstdint>
 #include <cxxtrace/detail/mpsc_ring_queue.h>
+#include <cxxtrace/detail/real_synchronization.h>
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/dynamic_capacity.h> // IWYU pragma: export
+#include <cxxtrace/ring_queue_overflow_policy.h> // IWYU pragma: export
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <mutex>
 
 namespace cxxtrace {
 
-template<std::size_t Capacity, class ClockSample>
+// If Overflow is ring_queue_overflow_policy::drop_newest, samples added while
+// the storage is full are discarded, and snapshots keep the oldest samples
+// added since the previous snapshot.
+//
+// Threads adding samples never wait for each other, even if a thread is
+// preempted while adding a sample.
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow =
+           ring_queue_overflow_policy::overwrite_oldest>
 class mpsc_ring_queue_storage
 {
 public:
   explicit mpsc_ring_queue_storage() noexcept;
+  // Create a storage which holds at least minimum_capacity sample records
+  // (rounded up to a power of two). Capacity must be dynamic_capacity.
+  explicit mpsc_ring_queue_storage(
+    std::size_t minimum_capacity) noexcept(false);
   ~mpsc_ring_queue_storage() noexcept;
 
   mpsc_ring_queue_storage(const mpsc_ring_queue_storage&) = delete;
@@ -27,19 +44,27 @@ public:
 
   auto add_sample(detail::sample_site_local_data,
                   ClockSample time_point,
-                  thread_id) noexcept -> void;
+                  detail::thread_index,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   auto add_sample(detail::sample_site_local_data,
-                  ClockSample time_point) noexcept -> void;
+                  ClockSample time_point,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
 
 private:
   using sample = detail::global_sample<ClockSample>;
+  using record = detail::sample_record<sample>;
 
   auto take_remembered_thread_names() -> detail::thread_name_set;
 
-  detail::mpsc_ring_queue<sample, Capacity> samples;
+  detail::mpsc_ring_queue<record,
+                          Capacity,
+                          std::uint64_t,
+                          detail::real_synchronization,
+                          Overflow>
+    samples;
 
   std::mutex pop_samples_mutex;
 
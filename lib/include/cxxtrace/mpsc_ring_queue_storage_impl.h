@@ -15,81 +15,100 @@
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/snapshot_sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/ring_queue_overflow_policy.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/thread.h>
 #include <mutex> // IWYU pragma: keep
+#include <optional>
 #include <utility>
 #include <vector>
 
 namespace cxxtrace {
-template<std::size_t Capacity, class ClockSample>
-mpsc_ring_queue_storage<Capacity,
-                        ClockSample>::mpsc_ring_queue_storage() noexcept =
-  default;
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::
+  mpsc_ring_queue_storage() noexcept = default;
 
-template<std::size_t Capacity, class ClockSample>
-mpsc_ring_queue_storage<Capacity,
-                        ClockSample>::~mpsc_ring_queue_storage() noexcept =
-  default;
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::
+  mpsc_ring_queue_storage(std::size_t minimum_capacity) noexcept(false)
+  : samples{ minimum_capacity }
+{}
 
-template<std::size_t Capacity, class ClockSample>
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::
+  ~mpsc_ring_queue_storage() noexcept = default;
+
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
 auto
-mpsc_ring_queue_storage<Capacity, ClockSample>::reset() noexcept -> void
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::reset() noexcept
+  -> void
 {
   this->samples.reset();
 }
 
-template<std::size_t Capacity, class ClockSample>
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
 auto
-mpsc_ring_queue_storage<Capacity, ClockSample>::add_sample(
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::add_sample(
   detail::sample_site_local_data site,
   ClockSample time_point,
-  thread_id thread_id) noexcept -> void
+  detail::thread_index thread,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
-  using detail::mpsc_ring_queue_push_result;
-
-  auto backoff = detail::real_synchronization::backoff{};
-retry:
-  auto result = this->samples.try_push(
-    1, [&](auto data) noexcept {
-      data.set(0, sample{ site, thread_id, time_point });
+  arguments = detail::fit_sample_arguments<sample>(
+    arguments, this->samples.get_capacity());
+  this->samples.push(
+    detail::sample_record_count<sample>(arguments), [&](auto data) noexcept {
+      detail::write_sample_records(
+        record::from_sample(sample{ site, time_point }, thread),
+        arguments,
+        [&](auto index, const record& r) noexcept { data.set(index, r); });
     });
-  switch (result) {
-    case mpsc_ring_queue_push_result::not_pushed_due_to_contention:
-      backoff.yield(CXXTRACE_HERE);
-      goto retry;
-    case mpsc_ring_queue_push_result::pushed:
-      break;
-  }
 }
 
-template<std::size_t Capacity, class ClockSample>
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
 auto
-mpsc_ring_queue_storage<Capacity, ClockSample>::add_sample(
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::add_sample(
   detail::sample_site_local_data site,
-  ClockSample time_point) noexcept -> void
+  ClockSample time_point,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
-  this->add_sample(site, time_point, get_current_thread_id());
+  this->add_sample(
+    site, time_point, detail::get_current_thread_index(), arguments);
 }
 
-template<std::size_t Capacity, class ClockSample>
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
 template<class Clock>
 auto
-mpsc_ring_queue_storage<Capacity, ClockSample>::take_all_samples(
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::take_all_samples(
   Clock& clock) noexcept(false) -> samples_snapshot
 {
   static_assert(std::is_same_v<typename Clock::sample, ClockSample>);
 
-  auto samples = std::vector<detail::snapshot_sample>{};
-  auto make_sample = [&](const sample& sample) noexcept->detail::snapshot_sample
-  {
-    return detail::snapshot_sample{ sample, clock };
-  };
+  auto clock_anchor = measure_wall_clock_anchor(clock);
+
+  auto raw_samples = std::vector<record>{};
+  auto discarded_record_count = std::size_t{ 0 };
   {
     auto guard = std::lock_guard<std::mutex>{ this->pop_samples_mutex };
-    this->samples.pop_all_into(
-      detail::transform_vector_queue_sink{ samples, make_sample });
+    discarded_record_count =
+      this->samples.pop_all_into(detail::vector_queue_sink{ raw_samples });
   }
+  auto samples = detail::snapshot_sample::many_from_records(raw_samples, clock);
 
   auto named_threads = std::vector<thread_id>{};
   auto thread_names = this->take_remembered_thread_names();
@@ -102,22 +121,35 @@ mpsc_ring_queue_storage<Capacity, ClockSample>::take_all_samples(
     }
   }
 
-  return samples_snapshot{ std::move(samples), std::move(thread_names) };
+  auto losses = std::vector<sample_loss>{};
+  if (discarded_record_count > 0) {
+    losses.emplace_back(
+      sample_loss{ std::nullopt, std::nullopt, discarded_record_count });
+  }
+
+  return samples_snapshot{ std::move(samples),
+                           std::move(thread_names),
+                           clock_anchor,
+                           std::move(losses) };
 }
 
-template<std::size_t Capacity, class ClockSample>
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
 auto
-mpsc_ring_queue_storage<Capacity, ClockSample>::
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::
   remember_current_thread_name_for_next_snapshot() -> void
 {
   auto guard = std::lock_guard{ this->remembered_thread_names_mutex };
   this->remembered_thread_names.fetch_and_remember_name_of_current_thread();
 }
 
-template<std::size_t Capacity, class ClockSample>
+template<std::size_t Capacity,
+         class ClockSample,
+         ring_queue_overflow_policy Overflow>
 auto
-mpsc_ring_queue_storage<Capacity, ClockSample>::take_remembered_thread_names()
-  -> detail::thread_name_set
+mpsc_ring_queue_storage<Capacity, ClockSample, Overflow>::
+  take_remembered_thread_names() -> detail::thread_name_set
 {
   auto guard = std::lock_guard{ this->remembered_thread_names_mutex };
   return std::move(this->remembered_thread_names);
@@ -0,0 +1,17 @@
+#ifndef CXXTRACE_RING_QUEUE_OVERFLOW_POLICY_H
+#define CXXTRACE_RING_QUEUE_OVERFLOW_POLICY_H
+
+namespace cxxtrace {
+// What a full ring queue does when more items are pushed.
+enum class ring_queue_overflow_policy
+{
+  // Overwrite the oldest items. Snapshots contain the most recent samples.
+  overwrite_oldest,
+
+  // Discard the pushed items. Snapshots contain the earliest samples added
+  // since the previous snapshot, such as the first events of an incident.
+  drop_newest,
+};
+}
+
+#endif
@@ -8,9 +8,9 @@
 
 #include <cstddef>
 #include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/ring_queue_unsafe_storage.h>
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <mutex> // IWYU pragma: keep
 
 namespace cxxtrace {
@@ -18,6 +18,12 @@ template<std::size_t Capacity, class ClockSample>
 ring_queue_storage<Capacity, ClockSample>::ring_queue_storage() noexcept =
   default;
 
+template<std::size_t Capacity, class ClockSample>
+ring_queue_storage<Capacity, ClockSample>::ring_queue_storage(
+  std::size_t minimum_capacity) noexcept(false)
+  : storage{ minimum_capacity }
+{}
+
 template<std::size_t Capacity, class ClockSample>
 ring_queue_storage<Capacity, ClockSample>::~ring_queue_storage() noexcept =
   default;
@@ -35,19 +41,22 @@ auto
 ring_queue_storage<Capacity, ClockSample>::add_sample(
   detail::sample_site_local_data site,
   ClockSample time_point,
-  thread_id thread_id) noexcept -> void
+  detail::thread_index thread,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
   auto lock = std::unique_lock{ this->mutex };
-  this->storage.add_sample(site, time_point, thread_id);
+  this->storage.add_sample(site, time_point, thread, arguments);
 }
 
 template<std::size_t Capacity, class ClockSample>
 auto
 ring_queue_storage<Capacity, ClockSample>::add_sample(
   detail::sample_site_local_data site,
-  ClockSample time_point) noexcept -> void
+  ClockSample time_point,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
-  this->add_sample(site, time_point, get_current_thread_id());
+  this->add_sample(
+    site, time_point, detail::get_current_thread_index(), arguments);
 }
 
 template<std::size_t Capacity, class ClockSample>
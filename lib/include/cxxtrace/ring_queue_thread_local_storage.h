@@ -1,9 +1,11 @@
 #ifndef CXXTRACE_RING_QUEUE_THREAD_LOCAL_STORAGE_H
 #define CXXTRACE_RING_QUEUE_THREAD_LOCAL_STORAGE_H
 
+#include <atomic>
 #include <cstddef>
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/dynamic_capacity.h> // IWYU pragma: export
 #include <cxxtrace/snapshot.h>
 #include <mutex>
 #include <vector>
@@ -14,20 +16,37 @@ template<std::size_t CapacityPerThread, class Tag, class ClockSample>
 class ring_queue_thread_local_storage
 {
 public:
+  explicit ring_queue_thread_local_storage() noexcept;
+  // Create a storage whose per-thread queues each hold at least
+  // minimum_capacity_per_thread sample records (rounded up to a power of two).
+  // CapacityPerThread must be dynamic_capacity.
+  //
+  // A thread's queue is allocated when the thread first adds a sample, with
+  // the capacity given to the most recently constructed storage with the same
+  // Tag. Construct the storage before threads add samples.
+  explicit ring_queue_thread_local_storage(
+    std::size_t minimum_capacity_per_thread) noexcept;
+
   static auto reset() noexcept -> void;
 
   static auto add_sample(detail::sample_site_local_data,
-                         ClockSample time_point) noexcept -> void;
+                         ClockSample time_point,
+                         detail::sample_arguments<ClockSample> = {}) noexcept
+    -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
 
 private:
   using disowned_sample = detail::global_sample<ClockSample>;
+  using disowned_record = detail::sample_record<disowned_sample>;
   using sample = detail::thread_local_sample<ClockSample>;
+  using record = detail::sample_record<sample>;
   struct thread_data;
+  using thread_queue = detail::ring_queue<record, CapacityPerThread>;
 
   static auto get_thread_data() -> thread_data&;
+  static auto make_thread_queue() noexcept(false) -> thread_queue;
 
   static auto add_to_thread_list(thread_data*) noexcept(false) -> void;
   static auto remove_from_thread_list(thread_data*) noexcept -> void;
@@ -35,8 +54,11 @@ private:
   // See NOTE[ring_queue_thread_local_storage lock order].
   inline static std::mutex global_mutex{};
   inline static std::vector<thread_data*> thread_list{};
-  inline static std::vector<disowned_sample> disowned_samples{};
+  inline static std::vector<disowned_record> disowned_samples{};
+  inline static std::vector<sample_loss> disowned_losses{};
   inline static detail::thread_name_set disowned_thread_names{};
+  // Used only if CapacityPerThread is dynamic_capacity.
+  inline static std::atomic<std::size_t> minimum_capacity_per_thread{ 0 };
 };
 }
 
@@ -5,8 +5,9 @@
 #include <cxxtrace/detail/ring_queue.h>
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/dynamic_capacity.h> // IWYU pragma: export
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 
 namespace cxxtrace {
 
@@ -15,6 +16,10 @@ class ring_queue_unsafe_storage
 {
 public:
   explicit ring_queue_unsafe_storage() noexcept;
+  // Create a storage which holds at least minimum_capacity sample records
+  // (rounded up to a power of two). Capacity must be dynamic_capacity.
+  explicit ring_queue_unsafe_storage(
+    std::size_t minimum_capacity) noexcept(false);
   ~ring_queue_unsafe_storage() noexcept;
 
   ring_queue_unsafe_storage(const ring_queue_unsafe_storage&) = delete;
@@ -27,17 +32,20 @@ public:
 
   auto add_sample(detail::sample_site_local_data,
                   ClockSample time_point,
-                  thread_id) noexcept -> void;
+                  detail::thread_index,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   auto add_sample(detail::sample_site_local_data,
-                  ClockSample time_point) noexcept -> void;
+                  ClockSample time_point,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
 
 private:
   using sample = detail::global_sample<ClockSample>;
+  using record = detail::sample_record<sample>;
 
-  detail::ring_queue<sample, Capacity> samples;
+  detail::ring_queue<record, Capacity> samples;
   detail::thread_name_set remembered_thread_names;
 };
 }
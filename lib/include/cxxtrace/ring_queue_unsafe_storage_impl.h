@@ -11,8 +11,10 @@
 #include <cxxtrace/detail/queue_sink.h> // IWYU pragma: keep
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/snapshot_sample.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/thread.h>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -22,6 +24,12 @@ ring_queue_unsafe_storage<Capacity,
                           ClockSample>::ring_queue_unsafe_storage() noexcept =
   default;
 
+template<std::size_t Capacity, class ClockSample>
+ring_queue_unsafe_storage<Capacity, ClockSample>::ring_queue_unsafe_storage(
+  std::size_t minimum_capacity) noexcept(false)
+  : samples{ minimum_capacity }
+{}
+
 template<std::size_t Capacity, class ClockSample>
 ring_queue_unsafe_storage<Capacity,
                           ClockSample>::~ring_queue_unsafe_storage() noexcept =
@@ -39,11 +47,17 @@ auto
 ring_queue_unsafe_storage<Capacity, ClockSample>::add_sample(
   detail::sample_site_local_data site,
   ClockSample time_point,
-  thread_id thread_id) noexcept -> void
+  detail::thread_index thread,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
+  arguments = detail::fit_sample_arguments<sample>(
+    arguments, this->samples.get_capacity());
   this->samples.push(
-    1, [&](auto data) noexcept {
-      data.set(0, sample{ site, thread_id, time_point });
+    detail::sample_record_count<sample>(arguments), [&](auto data) noexcept {
+      detail::write_sample_records(
+        record::from_sample(sample{ site, time_point }, thread),
+        arguments,
+        [&](auto index, const record& r) noexcept { data.set(index, r); });
     });
 }
 
@@ -51,9 +65,11 @@ template<std::size_t Capacity, class ClockSample>
 auto
 ring_queue_unsafe_storage<Capacity, ClockSample>::add_sample(
   detail::sample_site_local_data site,
-  ClockSample time_point) noexcept -> void
+  ClockSample time_point,
+  detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
-  this->add_sample(site, time_point, get_current_thread_id());
+  this->add_sample(
+    site, time_point, detail::get_current_thread_index(), arguments);
 }
 
 template<std::size_t Capacity, class ClockSample>
@@ -64,13 +80,12 @@ ring_queue_unsafe_storage<Capacity, ClockSample>::take_all_samples(
 {
   static_assert(std::is_same_v<typename Clock::sample, ClockSample>);
 
-  auto samples = std::vector<detail::snapshot_sample>{};
-  auto make_sample = [&](const sample& sample) noexcept->detail::snapshot_sample
-  {
-    return detail::snapshot_sample{ sample, clock };
-  };
-  this->samples.pop_all_into(
-    detail::transform_vector_queue_sink{ samples, make_sample });
+  auto clock_anchor = measure_wall_clock_anchor(clock);
+
+  auto raw_samples = std::vector<record>{};
+  auto discarded_record_count = static_cast<std::size_t>(
+    this->samples.pop_all_into(detail::vector_queue_sink{ raw_samples }));
+  auto samples = detail::snapshot_sample::many_from_records(raw_samples, clock);
 
   auto named_threads = std::vector<thread_id>{};
   auto thread_names = std::move(this->remembered_thread_names);
@@ -83,7 +98,16 @@ ring_queue_unsafe_storage<Capacity, ClockSample>::take_all_samples(
     }
   }
 
-  return samples_snapshot{ std::move(samples), std::move(thread_names) };
+  auto losses = std::vector<sample_loss>{};
+  if (discarded_record_count > 0) {
+    losses.emplace_back(
+      sample_loss{ std::nullopt, std::nullopt, discarded_record_count });
+  }
+
+  return samples_snapshot{ std::move(samples),
+                           std::move(thread_names),
+                           clock_anchor,
+                           std::move(losses) };
 }
 
 template<std::size_t Capacity, class ClockSample>
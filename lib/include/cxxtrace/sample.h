@@ -6,6 +6,27 @@ enum class sample_kind
 {
   enter_span,
   exit_span,
+  // A span recorded as one sample when the span exits. The sample's timestamp
+  // is when the span was entered.
+  complete_span,
+  // A point in time, with no duration.
+  instant,
+  // A change of one or more numeric values (the sample's arguments).
+  counter,
+  // The beginning and end of an operation identified by an event ID. Unlike
+  // spans, async operations may begin and end on different threads.
+  async_begin,
+  async_end,
+  // Causal links between samples (possibly on different threads) which share
+  // an event ID.
+  flow_start,
+  flow_step,
+  flow_end,
+  // The end of a thread's current phase and the beginning of the next phase
+  // (named by the sample), at the same time point. The first phase of a
+  // sequence begins with an enter_span sample, and the last phase ends with an
+  // exit_span sample.
+  next_phase,
 };
 }
 
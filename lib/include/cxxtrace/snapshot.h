@@ -1,13 +1,18 @@
 #ifndef CXXTRACE_SNAPSHOT_H
 #define CXXTRACE_SNAPSHOT_H
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/detail/snapshot_sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/hardware_counters.h>
 #include <cxxtrace/sample.h>
+#include <cxxtrace/span_argument.h>
 #include <cxxtrace/string.h>
 #include <cxxtrace/thread.h>
+#include <optional>
 #include <vector>
 
 namespace cxxtrace {
@@ -15,6 +20,23 @@ class sample_ref;
 
 enum class event_kind;
 
+// Sample records which a lossy storage discarded (because a ring queue
+// overflowed) before a snapshot could take them.
+//
+// The discarded records are older than every sample in the snapshot from the
+// same queue. A sample occupies one record, plus one or more records for its
+// event ID, end time, and arguments.
+struct sample_loss
+{
+  // For storages with a queue per thread, the thread whose queue discarded
+  // records.
+  std::optional<cxxtrace::thread_id> thread_id;
+  // For storages with a queue per processor, the processor whose queue
+  // discarded records.
+  std::optional<std::uint32_t> processor_id;
+  std::uint64_t discarded_record_count;
+};
+
 class samples_snapshot
 {
 public:
@@ -22,6 +44,19 @@ public:
 
   explicit samples_snapshot(std::vector<detail::snapshot_sample>,
                             detail::thread_name_set thread_names) noexcept;
+  explicit samples_snapshot(std::vector<detail::snapshot_sample>,
+                            detail::thread_name_set thread_names,
+                            wall_clock_anchor) noexcept;
+  explicit samples_snapshot(std::vector<detail::snapshot_sample>,
+                            detail::thread_name_set thread_names,
+                            wall_clock_anchor,
+                            std::vector<sample_loss> losses) noexcept;
+  explicit samples_snapshot(
+    std::vector<detail::snapshot_sample>,
+    detail::thread_name_set thread_names,
+    wall_clock_anchor,
+    std::vector<std::chrono::nanoseconds> processor_clock_offsets,
+    std::vector<sample_loss> losses) noexcept;
 
   samples_snapshot(const samples_snapshot&) noexcept(false);
   samples_snapshot(samples_snapshot&&) noexcept;
@@ -38,9 +73,33 @@ public:
   // TODO(strager): Expose an iterator interface instead.
   auto thread_ids() const noexcept(false) -> std::vector<thread_id>;
 
+  // Simultaneous readings of the trace clock and the wall clock, taken when the
+  // snapshot was created. Empty if the storage did not record an anchor.
+  auto clock_anchor() const noexcept
+    -> const std::optional<wall_clock_anchor>&;
+
+  // The clock offsets subtracted from samples' timestamps to correct for clock
+  // skew between processors, indexed by processor ID. Empty if no correction
+  // was applied.
+  auto processor_clock_offsets() const noexcept
+    -> const std::vector<std::chrono::nanoseconds>&;
+
+  // Records discarded by the storage since the previous snapshot, with at most
+  // one sample_loss per queue. Empty if no records were discarded.
+  //
+  // If losses is not empty, the snapshot might be missing samples (or parts
+  // of spans) which were added.
+  auto losses() const noexcept -> const std::vector<sample_loss>&;
+
+  // The sum of discarded_record_count of every sample_loss in losses.
+  auto discarded_record_count() const noexcept -> std::uint64_t;
+
 private:
   std::vector<detail::snapshot_sample> samples;
   detail::thread_name_set thread_names;
+  std::optional<wall_clock_anchor> clock_anchor_;
+  std::vector<std::chrono::nanoseconds> processor_clock_offsets_;
+  std::vector<sample_loss> losses_;
 };
 
 class sample_ref
@@ -52,6 +111,47 @@ public:
   auto thread_id() const noexcept -> thread_id;
   auto timestamp() const -> time_point;
 
+  // The source file and line of the macro which added the sample, or nullptr
+  // and 0 if the sample was not added by a macro.
+  auto file() const noexcept -> czstring;
+  auto line() const noexcept -> int;
+
+  // The number of spans on the sample's thread which were entered but not
+  // exited when the sample was added. Only spans added to storages of the
+  // sample's storage's type are counted. A span's enter_span and exit_span
+  // samples have the same depth, and samples inside the span have a greater
+  // depth. Depths greater than 255 are reported as 255.
+  //
+  // Depths let readers rebuild each thread's tree of spans even if a lossy
+  // storage dropped some enter_span or exit_span samples.
+  auto depth() const noexcept -> int;
+
+  // The thread's hardware counters when the sample was taken. Empty unless the
+  // sample was taken with a hardware_counter_clock.
+  auto counters() const noexcept -> std::optional<hardware_counters>;
+
+  // The thread's CPU time when the sample was taken. Empty unless the sample
+  // was taken with a thread_cpu_time_clock.
+  auto thread_cpu_time() const noexcept
+    -> std::optional<std::chrono::nanoseconds>;
+
+  // The arguments given to CXXTRACE_SPAN_WITH_CONFIG (or to an event macro
+  // such as CXXTRACE_INSTANT_WITH_CONFIG), in order. exit_span samples have no
+  // arguments.
+  auto arguments() const noexcept -> const std::vector<sample_argument>&;
+
+  // The ID of an async or flow sample. Empty for other kinds of samples.
+  auto event_id() const noexcept -> std::optional<std::uint64_t>;
+
+  // When a complete_span sample's span exited. Empty for other kinds of
+  // samples.
+  auto end_timestamp() const noexcept -> std::optional<time_point>;
+  // Like counters and thread_cpu_time, but measured when a complete_span
+  // sample's span exited.
+  auto end_counters() const noexcept -> std::optional<hardware_counters>;
+  auto end_thread_cpu_time() const noexcept
+    -> std::optional<std::chrono::nanoseconds>;
+
 private:
   explicit sample_ref(const detail::snapshot_sample*) noexcept;
 
@@ -1,15 +1,70 @@
 #ifndef CXXTRACE_SPAN_H
 #define CXXTRACE_SPAN_H
 
+#include <cstddef>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/detail/span_depth.h>
+#include <cxxtrace/span_argument.h> // IWYU pragma: export
 #include <cxxtrace/string.h>
 #include <type_traits>
 
 namespace cxxtrace {
-#define CXXTRACE_SPAN_WITH_CONFIG(config, category, name)                      \
+// CXXTRACE_SPAN_WITH_CONFIG(config, category, name, arguments...)
+//
+// Each argument is a cxxtrace::span_argument, and is recorded with the span's
+// enter_span sample.
+//
+// category and name must outlive any snapshots containing the span. To name a
+// span with a string computed at run time, use cxxtrace::intern_string.
+#define CXXTRACE_SPAN_WITH_CONFIG(config, category, ...)                       \
   (::cxxtrace::detail::span_guard<                                             \
     ::std::remove_reference_t<decltype((config).storage())>,                   \
     ::std::remove_reference_t<decltype((config).clock())>>::                   \
-     enter((config).storage(), (config).clock(), (category), (name)))
+     enter((config).storage(),                                                 \
+           (config).clock(),                                                   \
+           CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),                                \
+           (category),                                                         \
+           __VA_ARGS__))
+
+// CXXTRACE_COMPLETE_SPAN_WITH_CONFIG(config, category, name)
+//
+// Like CXXTRACE_SPAN_WITH_CONFIG, but record the span as a single
+// complete_span sample when the span exits. The sample takes two records (the
+// sample and its end time point), like the enter and exit samples of a span,
+// but both records are added in one push, so a lossy storage can never keep
+// the beginning of the span without its end. However, a span which has not
+// exited is not visible in snapshots, and complete spans are stored in the
+// order they exit rather than the order they begin.
+#define CXXTRACE_COMPLETE_SPAN_WITH_CONFIG(config, category, name)             \
+  (::cxxtrace::detail::complete_span_guard<                                    \
+    ::std::remove_reference_t<decltype((config).storage())>,                   \
+    ::std::remove_reference_t<decltype((config).clock())>>::                   \
+     enter((config).storage(),                                                 \
+           (config).clock(),                                                   \
+           CXXTRACE_DETAIL_SAMPLE_SITE_CACHE(),                                \
+           (category),                                                         \
+           (name)))
+
+// CXXTRACE_PHASES_WITH_CONFIG(config, category)
+//
+// Evaluate to a guard which records a sequence of back-to-back spans (phases)
+// on the calling thread. Calling the guard's next(name) member function ends
+// the current phase (if any) and begins a phase named name. The last phase
+// ends when the guard is destroyed.
+//
+// Each call to next queries the clock once and adds one sample, so a sequence
+// of N phases costs N+1 samples instead of the 2N samples of N spans.
+//
+// category and each phase's name must outlive any snapshots containing the
+// phases.
+#define CXXTRACE_PHASES_WITH_CONFIG(config, category)                          \
+  (::cxxtrace::detail::phases_guard<                                           \
+    ::std::remove_reference_t<decltype((config).storage())>,                   \
+    ::std::remove_reference_t<decltype((config).clock())>>::                   \
+     begin((config).storage(),                                                 \
+           (config).clock(),                                                   \
+           CXXTRACE_DETAIL_MULTI_SAMPLE_SITE_CACHE(),                          \
+           (category)))
 
 namespace detail {
 template<class Storage, class Clock>
@@ -23,23 +78,93 @@ public:
 
   ~span_guard() noexcept;
 
+  template<class... Arguments>
+  static auto enter(Storage&,
+                    Clock&,
+                    sample_site_cache&,
+                    czstring category,
+                    czstring name,
+                    const Arguments&...) noexcept(false) -> span_guard;
+
+private:
+  explicit span_guard(Storage&, Clock&, sample_sites) noexcept;
+
+  auto exit() noexcept(false) -> void;
+
+  Storage& storage;
+  Clock& clock;
+  sample_sites sites;
+};
+
+template<class Storage, class Clock>
+class complete_span_guard
+{
+public:
+  complete_span_guard(const complete_span_guard&) = delete;
+  complete_span_guard(complete_span_guard&&) = delete;
+  complete_span_guard& operator=(const complete_span_guard&) = delete;
+  complete_span_guard& operator=(complete_span_guard&&) = delete;
+
+  ~complete_span_guard() noexcept;
+
   static auto enter(Storage&,
                     Clock&,
+                    sample_site_cache&,
                     czstring category,
-                    czstring name) noexcept(false) -> span_guard;
+                    czstring name) noexcept(false) -> complete_span_guard;
+
+private:
+  using clock_sample = typename Clock::sample;
+
+  explicit complete_span_guard(Storage&,
+                               Clock&,
+                               sample_sites,
+                               clock_sample begin_time_point) noexcept;
+
+  auto exit() noexcept(false) -> void;
+
+  Storage& storage;
+  Clock& clock;
+  sample_sites sites;
+  clock_sample begin_time_point;
+};
+
+template<class Storage, class Clock>
+class phases_guard
+{
+public:
+  phases_guard(const phases_guard&) = delete;
+  phases_guard(phases_guard&&) = delete;
+  phases_guard& operator=(const phases_guard&) = delete;
+  phases_guard& operator=(phases_guard&&) = delete;
+
+  ~phases_guard() noexcept;
+
+  static auto begin(Storage&,
+                    Clock&,
+                    multi_sample_site_cache&,
+                    czstring category) noexcept -> phases_guard;
+
+  auto next(czstring name) noexcept(false) -> void;
 
 private:
-  explicit span_guard(Storage&,
-                      Clock&,
-                      czstring category,
-                      czstring name) noexcept;
+  explicit phases_guard(Storage&,
+                        Clock&,
+                        multi_sample_site_cache&,
+                        czstring category) noexcept;
 
   auto exit() noexcept(false) -> void;
 
   Storage& storage;
   Clock& clock;
-  czstring category{ nullptr };
-  czstring name{ nullptr };
+  multi_sample_site_cache& site_cache;
+  czstring category;
+  // The current phase's sites. sites.set is nullptr if no phase has begun.
+  sample_sites sites{};
+  // The number of phases begun so far. The phase's position is the hint for
+  // site_cache.
+  std::size_t phase_index{ 0 };
+  recorded_span_depth depth{ 0 };
 };
 }
 }
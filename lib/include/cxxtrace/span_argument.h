@@ -0,0 +1,106 @@
+#ifndef CXXTRACE_SPAN_ARGUMENT_H
+#define CXXTRACE_SPAN_ARGUMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cxxtrace/string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+
+namespace cxxtrace {
+enum class span_argument_type : std::uint8_t
+{
+  integer,
+  floating,
+  string,
+};
+
+// A named value recorded with a span, such as a request ID or a status code.
+//
+// The argument's name must outlive any snapshots containing the argument (like
+// a span's category and name). A string argument's value is copied when the
+// span is entered; only the first max_string_size bytes are copied.
+//
+// @see CXXTRACE_SPAN_WITH_CONFIG
+class span_argument
+{
+public:
+  static constexpr auto max_string_size = std::size_t{ 256 };
+
+  template<class T, class = std::enable_if_t<std::is_integral_v<T>>>
+  span_argument(czstring name, T value) noexcept
+    : name_{ name }
+    , type_{ span_argument_type::integer }
+  {
+    this->value_.integer = static_cast<std::int64_t>(value);
+  }
+
+  span_argument(czstring name, double value) noexcept
+    : name_{ name }
+    , type_{ span_argument_type::floating }
+  {
+    this->value_.floating = value;
+  }
+
+  span_argument(czstring name, std::string_view value) noexcept
+    : name_{ name }
+    , type_{ span_argument_type::string }
+  {
+    this->value_.string.data = value.data();
+    this->value_.string.size =
+      value.size() < max_string_size ? value.size() : max_string_size;
+  }
+
+  span_argument(czstring name, czstring value) noexcept
+    : span_argument{ name, std::string_view{ value } }
+  {}
+
+  auto name() const noexcept -> czstring { return this->name_; }
+  auto type() const noexcept -> span_argument_type { return this->type_; }
+
+  auto integer() const noexcept -> std::int64_t
+  {
+    return this->value_.integer;
+  }
+
+  auto floating() const noexcept -> double { return this->value_.floating; }
+
+  auto string() const noexcept -> std::string_view
+  {
+    return std::string_view{ this->value_.string.data,
+                             this->value_.string.size };
+  }
+
+private:
+  czstring name_;
+  span_argument_type type_;
+  union
+  {
+    std::int64_t integer;
+    double floating;
+    struct
+    {
+      const char* data;
+      std::size_t size;
+    } string;
+  } value_;
+};
+
+// A span_argument, as recorded in a samples_snapshot.
+struct sample_argument
+{
+  using value_type = std::variant<std::int64_t, double, std::string>;
+
+  czstring name;
+  value_type value;
+};
+
+auto
+operator==(const sample_argument&, const sample_argument&) noexcept -> bool;
+auto
+operator!=(const sample_argument&, const sample_argument&) noexcept -> bool;
+}
+
+#endif
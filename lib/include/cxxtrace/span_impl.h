@@ -6,8 +6,12 @@
   "Include <cxxtrace/span.h> instead of including <cxxtrace/span_impl.h> directly."
 #endif
 
+#include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/detail/span_depth.h>
 #include <cxxtrace/sample.h>
 #include <cxxtrace/string.h>
+#include <optional>
 
 namespace cxxtrace {
 namespace detail {
@@ -18,36 +22,167 @@ span_guard<Storage, Clock>::~span_guard() noexcept
 }
 
 template<class Storage, class Clock>
+template<class... Arguments>
 auto
 span_guard<Storage, Clock>::enter(Storage& storage,
                                   Clock& clock,
+                                  sample_site_cache& site_cache,
                                   czstring category,
-                                  czstring name) noexcept(false) -> span_guard
+                                  czstring name,
+                                  const Arguments&... arguments) noexcept(false)
+  -> span_guard
 {
+  auto sites = site_cache.get(category, name);
   auto begin_timestamp = clock.query();
-  storage.add_sample({ category, name, sample_kind::enter_span },
-                     begin_timestamp);
-  return span_guard{ storage, clock, category, name };
+  add_sample_with_arguments(storage,
+                            sites,
+                            sample_kind::enter_span,
+                            begin_timestamp,
+                            std::nullopt,
+                            arguments...);
+  current_thread_span_depth<Storage> += 1;
+  return span_guard{ storage, clock, sites };
 }
 
 template<class Storage, class Clock>
 span_guard<Storage, Clock>::span_guard(Storage& storage,
                                        Clock& clock,
-                                       czstring category,
-                                       czstring name) noexcept
+                                       sample_sites sites) noexcept
   : storage{ storage }
   , clock{ clock }
-  , category{ category }
-  , name{ name }
+  , sites{ sites }
 {}
 
 template<class Storage, class Clock>
 auto
 span_guard<Storage, Clock>::exit() noexcept(false) -> void
 {
-  auto end_timestamp = clock.query();
+  auto end_timestamp = this->clock.query();
+  current_thread_span_depth<Storage> -= 1;
+  auto arguments = sample_arguments<typename Clock::sample>{};
+  arguments.depth = get_current_thread_span_depth<Storage>();
+  arguments.dynamic_category = this->sites.dynamic_category;
+  arguments.dynamic_name = this->sites.dynamic_name;
+  this->storage.add_sample(
+    this->sites.at(sample_kind::exit_span), end_timestamp, arguments);
+}
+
+template<class Storage, class Clock>
+complete_span_guard<Storage, Clock>::~complete_span_guard() noexcept
+{
+  this->exit();
+}
+
+template<class Storage, class Clock>
+auto
+complete_span_guard<Storage, Clock>::enter(Storage& storage,
+                                           Clock& clock,
+                                           sample_site_cache& site_cache,
+                                           czstring category,
+                                           czstring name) noexcept(false)
+  -> complete_span_guard
+{
+  auto sites = site_cache.get(category, name);
+  auto begin_time_point = clock.query();
+  current_thread_span_depth<Storage> += 1;
+  return complete_span_guard{ storage, clock, sites, begin_time_point };
+}
+
+template<class Storage, class Clock>
+complete_span_guard<Storage, Clock>::complete_span_guard(
+  Storage& storage,
+  Clock& clock,
+  sample_sites sites,
+  clock_sample begin_time_point) noexcept
+  : storage{ storage }
+  , clock{ clock }
+  , sites{ sites }
+  , begin_time_point{ begin_time_point }
+{}
+
+template<class Storage, class Clock>
+auto
+complete_span_guard<Storage, Clock>::exit() noexcept(false) -> void
+{
+  auto end_time_point = this->clock.query();
+  current_thread_span_depth<Storage> -= 1;
+  auto arguments = sample_arguments<clock_sample>{};
+  arguments.end_time_point = end_time_point;
+  arguments.depth = get_current_thread_span_depth<Storage>();
+  arguments.dynamic_category = this->sites.dynamic_category;
+  arguments.dynamic_name = this->sites.dynamic_name;
+  this->storage.add_sample(this->sites.at(sample_kind::complete_span),
+                           this->begin_time_point,
+                           arguments);
+}
+
+template<class Storage, class Clock>
+phases_guard<Storage, Clock>::~phases_guard() noexcept
+{
+  this->exit();
+}
+
+template<class Storage, class Clock>
+auto
+phases_guard<Storage, Clock>::begin(Storage& storage,
+                                    Clock& clock,
+                                    multi_sample_site_cache& site_cache,
+                                    czstring category) noexcept -> phases_guard
+{
+  return phases_guard{ storage, clock, site_cache, category };
+}
+
+template<class Storage, class Clock>
+phases_guard<Storage, Clock>::phases_guard(Storage& storage,
+                                           Clock& clock,
+                                           multi_sample_site_cache& site_cache,
+                                           czstring category) noexcept
+  : storage{ storage }
+  , clock{ clock }
+  , site_cache{ site_cache }
+  , category{ category }
+{}
+
+template<class Storage, class Clock>
+auto
+phases_guard<Storage, Clock>::next(czstring name) noexcept(false) -> void
+{
+  auto sites =
+    this->site_cache.get(this->category, name, this->phase_index);
+  this->phase_index += 1;
+  auto time_point = this->clock.query();
+  auto arguments = sample_arguments<typename Clock::sample>{};
+  arguments.dynamic_category = sites.dynamic_category;
+  arguments.dynamic_name = sites.dynamic_name;
+  if (this->sites.set) {
+    arguments.depth = this->depth;
+    this->storage.add_sample(
+      sites.at(sample_kind::next_phase), time_point, arguments);
+  } else {
+    this->depth = get_current_thread_span_depth<Storage>();
+    arguments.depth = this->depth;
+    this->storage.add_sample(
+      sites.at(sample_kind::enter_span), time_point, arguments);
+    current_thread_span_depth<Storage> += 1;
+  }
+  this->sites = sites;
+}
+
+template<class Storage, class Clock>
+auto
+phases_guard<Storage, Clock>::exit() noexcept(false) -> void
+{
+  if (!this->sites.set) {
+    return;
+  }
+  auto end_time_point = this->clock.query();
+  current_thread_span_depth<Storage> -= 1;
+  auto arguments = sample_arguments<typename Clock::sample>{};
+  arguments.depth = this->depth;
+  arguments.dynamic_category = this->sites.dynamic_category;
+  arguments.dynamic_name = this->sites.dynamic_name;
   this->storage.add_sample(
-    { this->category, this->name, sample_kind::exit_span }, end_timestamp);
+    this->sites.at(sample_kind::exit_span), end_time_point, arguments);
 }
 }
 }
@@ -1,15 +1,18 @@
 #ifndef CXXTRACE_SPSC_RING_QUEUE_PROCESSOR_LOCAL_STORAGE_H
 #define CXXTRACE_SPSC_RING_QUEUE_PROCESSOR_LOCAL_STORAGE_H
 
+#include <chrono>
 #include <cstddef>
+#include <deque>
 #include <cxxtrace/detail/lazy_thread_local.h>
 #include <cxxtrace/detail/processor.h>
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/spin_lock.h>
 #include <cxxtrace/detail/spsc_ring_queue.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/dynamic_capacity.h> // IWYU pragma: export
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <mutex>
 #include <vector>
 
@@ -20,6 +23,11 @@ class spsc_ring_queue_processor_local_storage
 {
 public:
   explicit spsc_ring_queue_processor_local_storage() noexcept(false);
+  // Create a storage whose per-processor queues each hold at least
+  // minimum_capacity_per_processor sample records (rounded up to a power of
+  // two). CapacityPerProcessor must be dynamic_capacity.
+  explicit spsc_ring_queue_processor_local_storage(
+    std::size_t minimum_capacity_per_processor) noexcept(false);
   ~spsc_ring_queue_processor_local_storage() noexcept;
 
   spsc_ring_queue_processor_local_storage(
@@ -35,20 +43,36 @@ public:
 
   auto add_sample(detail::sample_site_local_data,
                   ClockSample time_point,
-                  thread_id) noexcept -> void;
+                  detail::thread_index,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   auto add_sample(detail::sample_site_local_data,
-                  ClockSample time_point) noexcept -> void;
+                  ClockSample time_point,
+                  detail::sample_arguments<ClockSample> = {}) noexcept -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
 
+  // Measure how far each processor's clock is ahead of a reference processor's
+  // clock (see detail::measure_processor_clock_offsets).
+  //
+  // Later calls to take_all_samples subtract each processor's offset from the
+  // timestamps of samples added on that processor, then merge the samples.
+  template<class Clock>
+  auto measure_clock_skew(Clock&) noexcept(false) -> void;
+
 private:
   using sample = detail::global_sample<ClockSample>;
+  using record = detail::sample_record<sample>;
 
   struct processor_samples
   {
-    detail::spin_lock mutex;
-    detail::spsc_ring_queue<sample, CapacityPerProcessor> samples;
+    explicit processor_samples() noexcept = default;
+    explicit processor_samples(std::size_t minimum_capacity) noexcept(false)
+      : samples{ minimum_capacity }
+    {}
+
+    detail::spin_lock mutex{};
+    detail::spsc_ring_queue<record, CapacityPerProcessor> samples{};
   };
 
   using processor_id_lookup_thread_local_cache =
@@ -57,13 +81,17 @@ private:
   auto take_remembered_thread_names() -> detail::thread_name_set;
 
   detail::processor_id_lookup processor_id_lookup;
-  std::vector<processor_samples> samples_by_processor;
+  // A deque rather than a vector because queues cannot be moved, so
+  // runtime-sized queues must be constructed in place one by one.
+  std::deque<processor_samples> samples_by_processor;
 
   std::mutex remembered_thread_names_mutex;
   detail::thread_name_set remembered_thread_names;
 
   // Synchronizes consuming samples_by_processor[n].processor_samples.samples.
   std::mutex pop_samples_mutex;
+  // Protected by pop_samples_mutex.
+  std::vector<std::chrono::nanoseconds> processor_clock_offsets;
 
   // TODO(strager): Only create this thread-local variable if it's actually used
   // by processor_id_lookup.
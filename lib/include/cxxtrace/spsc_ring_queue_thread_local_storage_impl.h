@@ -7,6 +7,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>                      // IWYU pragma: keep
 #include <cxxtrace/detail/queue_sink.h> // IWYU pragma: keep
@@ -14,11 +15,14 @@
 #include <cxxtrace/detail/snapshot_sample.h>
 #include <cxxtrace/detail/spsc_ring_queue.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/detail/thread_local_record.h>
 #include <cxxtrace/detail/vector.h>
 #include <cxxtrace/detail/workarounds.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/thread.h>
 #include <mutex> // IWYU pragma: keep
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -47,36 +51,58 @@ struct spsc_ring_queue_thread_local_storage<CapacityPerThread,
   thread_data(thread_data&&) = delete;
   thread_data& operator=(thread_data&&) = delete;
 
-  auto pop_all_into(std::vector<disowned_sample>& output) noexcept(false)
-    -> void
+  // Return the number of records discarded since the previous call.
+  auto pop_all_into(std::vector<disowned_record>& output) noexcept(false)
+    -> std::size_t
   {
-    auto thread_id = this->id;
-    auto make_sample = [thread_id](
-                         const sample& sample) noexcept->disowned_sample
+    // Samples whose time_base record was discarded are also lost.
+    auto undecodable_sample_count = std::size_t{ 0 };
+    auto make_record =
+      [this, &undecodable_sample_count](
+        const record& record) noexcept->disowned_record
     {
-      return disowned_sample{ sample.site, thread_id, sample.time_point };
+      auto decoded = this->decoder.decode(record, this->index);
+      if (record.kind == detail::sample_record_kind::sample &&
+          decoded.kind == detail::sample_record_kind::discarded) {
+        undecodable_sample_count += 1;
+      }
+      return decoded;
     };
-    this->samples.pop_all_into(
-      detail::transform_vector_queue_sink{ output, make_sample });
-  }
-
-  template<class Clock>
-  auto pop_all_into(std::vector<detail::snapshot_sample>& output,
-                    Clock& clock) noexcept(false) -> void
-  {
-    auto make_sample = [&](
-                         const sample& sample) noexcept->detail::snapshot_sample
-    {
-      return detail::snapshot_sample{ sample, this->id, clock };
-    };
-    this->samples.pop_all_into(
-      detail::transform_vector_queue_sink{ output, make_sample });
+    auto begin_index = output.size();
+    auto discarded_record_count =
+      static_cast<std::size_t>(this->samples.pop_all_into(
+        detail::transform_vector_queue_sink{ output, make_record }));
+    detail::erase_orphaned_sample_records(output, begin_index);
+    return discarded_record_count + undecodable_sample_count;
   }
 
   cxxtrace::thread_id id{ cxxtrace::get_current_thread_id() };
-  detail::spsc_ring_queue<sample, CapacityPerThread> samples{};
+  detail::thread_index index{ detail::get_current_thread_index() };
+  thread_queue samples{ make_thread_queue() };
+  // Used only by the thread which owns this thread_data.
+  detail::thread_local_record_encoder<ClockSample> encoder{};
+  // Used only while holding global_mutex.
+  detail::thread_local_record_decoder<ClockSample> decoder{};
 };
 
+template<std::size_t CapacityPerThread, class Tag, class ClockSample>
+spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
+  spsc_ring_queue_thread_local_storage() noexcept
+{
+  static_assert(CapacityPerThread != dynamic_capacity,
+                "Pass the capacity per thread to the constructor");
+}
+
+template<std::size_t CapacityPerThread, class Tag, class ClockSample>
+spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
+  spsc_ring_queue_thread_local_storage(
+    std::size_t minimum_capacity_per_thread) noexcept
+{
+  static_assert(CapacityPerThread == dynamic_capacity);
+  spsc_ring_queue_thread_local_storage::minimum_capacity_per_thread.store(
+    minimum_capacity_per_thread, std::memory_order_relaxed);
+}
+
 template<std::size_t CapacityPerThread, class Tag, class ClockSample>
 auto
 spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
@@ -88,20 +114,39 @@ spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
 #endif
   for (auto* data : thread_list) {
     data->samples.reset();
+    data->encoder.reset();
+    data->decoder.reset();
   }
   detail::reset_vector(disowned_samples);
+  detail::reset_vector(disowned_losses);
 }
 
 template<std::size_t CapacityPerThread, class Tag, class ClockSample>
 auto
 spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
   add_sample(detail::sample_site_local_data site,
-             ClockSample time_point) noexcept -> void
+             ClockSample time_point,
+             detail::sample_arguments<ClockSample> arguments) noexcept -> void
 {
+  using encoder = detail::thread_local_record_encoder<ClockSample>;
+
   auto& thread_data = get_thread_data();
+  auto capacity = thread_data.samples.get_capacity();
+  arguments = detail::fit_sample_arguments<sample>(
+    arguments, capacity - encoder::max_extra_record_count);
+  auto record_count = detail::sample_record_count<sample>(arguments);
+  auto encoded =
+    thread_data.encoder.encode(site, time_point, record_count, capacity);
+  auto extra_record_count = encoded.extra_record_count();
   thread_data.samples.push(
-    1, [&](auto data) noexcept {
-      data.set(0, sample{ site, time_point });
+    extra_record_count + record_count, [&](auto data) noexcept {
+      if (encoded.time_base.has_value()) {
+        data.set(0, *encoded.time_base);
+      }
+      detail::write_sample_records(
+        encoded.sample, arguments, [&](auto index, const record& r) noexcept {
+          data.set(extra_record_count + index, r);
+        });
     });
 }
 
@@ -111,28 +156,42 @@ auto
 spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
   take_all_samples(Clock& clock) noexcept(false) -> samples_snapshot
 {
-  auto reclaimed_samples = std::vector<disowned_sample>{};
-  auto samples = std::vector<detail::snapshot_sample>{};
+  auto clock_anchor = measure_wall_clock_anchor(clock);
+
+  auto reclaimed_samples = std::vector<disowned_record>{};
+  auto thread_samples = std::vector<disowned_record>{};
   auto thread_names = detail::thread_name_set{};
   auto thread_ids = std::vector<thread_id>{};
+  auto losses = std::vector<sample_loss>{};
   {
     auto global_lock = std::lock_guard{ global_mutex };
     swap(reclaimed_samples, disowned_samples);
+    swap(losses, disowned_losses);
     thread_names = std::move(disowned_thread_names);
     thread_ids.reserve(thread_list.size());
     for (auto* data : thread_list) {
-      data->pop_all_into(samples, clock);
+      auto discarded_record_count = data->pop_all_into(thread_samples);
+      if (discarded_record_count > 0) {
+        losses.emplace_back(
+          sample_loss{ data->id, std::nullopt, discarded_record_count });
+      }
       thread_ids.emplace_back(data->id);
     }
   }
-  detail::snapshot_sample::many_from_samples(reclaimed_samples, clock, samples);
+  auto samples =
+    detail::snapshot_sample::many_from_records(thread_samples, clock);
+  detail::reset_vector(thread_samples);
+  detail::snapshot_sample::many_from_records(reclaimed_samples, clock, samples);
   detail::reset_vector(reclaimed_samples);
 
   for (const auto& thread_id : thread_ids) {
     thread_names.fetch_and_remember_thread_name_for_id(thread_id);
   }
 
-  return samples_snapshot{ std::move(samples), std::move(thread_names) };
+  return samples_snapshot{ std::move(samples),
+                           std::move(thread_names),
+                           clock_anchor,
+                           std::move(losses) };
 }
 
 template<std::size_t CapacityPerThread, class Tag, class ClockSample>
@@ -154,6 +213,20 @@ spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
 #endif
 }
 
+template<std::size_t CapacityPerThread, class Tag, class ClockSample>
+auto
+spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
+  make_thread_queue() noexcept(false) -> thread_queue
+{
+  if constexpr (CapacityPerThread == dynamic_capacity) {
+    auto capacity = minimum_capacity_per_thread.load(std::memory_order_relaxed);
+    assert(capacity > 0);
+    return thread_queue{ capacity };
+  } else {
+    return thread_queue{};
+  }
+}
+
 template<std::size_t CapacityPerThread, class Tag, class ClockSample>
 auto
 spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
@@ -174,7 +247,11 @@ spsc_ring_queue_thread_local_storage<CapacityPerThread, Tag, ClockSample>::
   assert(it != thread_list.end());
   thread_list.erase(it, thread_list.end());
 
-  data->pop_all_into(disowned_samples);
+  auto discarded_record_count = data->pop_all_into(disowned_samples);
+  if (discarded_record_count > 0) {
+    disowned_losses.emplace_back(
+      sample_loss{ data->id, std::nullopt, discarded_record_count });
+  }
   disowned_thread_names.fetch_and_remember_name_of_current_thread(data->id);
 }
 
@@ -0,0 +1,97 @@
+#ifndef CXXTRACE_THREAD_CPU_TIME_H
+#define CXXTRACE_THREAD_CPU_TIME_H
+
+#include <chrono>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/detail/have.h>
+#include <type_traits>
+
+namespace cxxtrace {
+// The CPU time a reader returns if it cannot read the current thread's CPU
+// time. Snapshots report such samples as having no CPU time.
+inline constexpr auto unavailable_thread_cpu_time =
+  std::chrono::nanoseconds::min();
+
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+// Read the current thread's CPU time using
+// clock_gettime(CLOCK_THREAD_CPUTIME_ID). Each read makes a system call.
+class posix_thread_cpu_time_reader
+{
+public:
+  static auto supported() noexcept -> bool;
+
+  auto read() noexcept(false) -> std::chrono::nanoseconds;
+};
+#endif
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+// Read the current thread's CPU time using Linux' task-clock perf event.
+//
+// Each thread opens its own event the first time it calls read. After that,
+// read extrapolates the event's running time from the event's mmap-ed page
+// using the time stamp counter, and does not make any system calls. If the
+// kernel does not publish the parameters for extrapolation, read falls back to
+// read(2).
+//
+// If a thread's event cannot be opened, read returns
+// unavailable_thread_cpu_time for that thread without retrying.
+class perf_event_task_clock_reader
+{
+public:
+  static auto supported() noexcept -> bool;
+
+  auto read() noexcept(false) -> std::chrono::nanoseconds;
+};
+#endif
+
+// A clock which additionally records the current thread's CPU time with each
+// sample.
+//
+// When used with a span, comparing the span's CPU time with its duration tells
+// whether the span was slow because it was computing (on-CPU) or because it
+// was blocked or preempted (off-CPU). chrome_trace_event_writer reports both.
+//
+// CpuTimeReader must have a static supported() member function and a read()
+// member function returning std::chrono::nanoseconds, such as
+// perf_event_task_clock_reader.
+template<class Clock, class CpuTimeReader>
+class thread_cpu_time_clock : public clock_base
+{
+public:
+  struct sample
+  {
+    typename Clock::sample time;
+    std::chrono::nanoseconds thread_cpu_time;
+  };
+
+  inline static constexpr auto traits = Clock::traits;
+
+  static auto supported() noexcept -> bool;
+
+  auto query() -> sample;
+
+  auto make_time_point(const sample&) -> time_point;
+
+  auto clock() noexcept -> Clock&;
+  auto cpu_time_reader() noexcept -> CpuTimeReader&;
+
+private:
+  Clock clock_;
+  CpuTimeReader cpu_time_reader_;
+};
+
+namespace detail {
+template<class Clock>
+struct clock_has_thread_cpu_time : std::false_type
+{};
+
+template<class Clock, class CpuTimeReader>
+struct clock_has_thread_cpu_time<thread_cpu_time_clock<Clock, CpuTimeReader>>
+  : std::true_type
+{};
+}
+}
+
+#include <cxxtrace/thread_cpu_time_impl.h> // IWYU pragma: export
+
+#endif
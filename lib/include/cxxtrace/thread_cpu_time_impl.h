@@ -0,0 +1,50 @@
+#ifndef CXXTRACE_THREAD_CPU_TIME_IMPL_H
+#define CXXTRACE_THREAD_CPU_TIME_IMPL_H
+
+#if !defined(CXXTRACE_THREAD_CPU_TIME_H)
+#error                                                                         \
+  "Include <cxxtrace/thread_cpu_time.h> instead of including <cxxtrace/thread_cpu_time_impl.h> directly."
+#endif
+
+namespace cxxtrace {
+template<class Clock, class CpuTimeReader>
+auto
+thread_cpu_time_clock<Clock, CpuTimeReader>::supported() noexcept -> bool
+{
+  return CpuTimeReader::supported();
+}
+
+template<class Clock, class CpuTimeReader>
+auto
+thread_cpu_time_clock<Clock, CpuTimeReader>::query() -> sample
+{
+  auto time = this->clock_.query();
+  auto thread_cpu_time = this->cpu_time_reader_.read();
+  return sample{ time, thread_cpu_time };
+}
+
+template<class Clock, class CpuTimeReader>
+auto
+thread_cpu_time_clock<Clock, CpuTimeReader>::make_time_point(
+  const sample& sample) -> time_point
+{
+  return this->clock_.make_time_point(sample.time);
+}
+
+template<class Clock, class CpuTimeReader>
+auto
+thread_cpu_time_clock<Clock, CpuTimeReader>::clock() noexcept -> Clock&
+{
+  return this->clock_;
+}
+
+template<class Clock, class CpuTimeReader>
+auto
+thread_cpu_time_clock<Clock, CpuTimeReader>::cpu_time_reader() noexcept
+  -> CpuTimeReader&
+{
+  return this->cpu_time_reader_;
+}
+}
+
+#endif
@@ -2,8 +2,8 @@
 #define CXXTRACE_UNBOUNDED_STORAGE_H
 
 #include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <cxxtrace/unbounded_unsafe_storage.h>
 #include <mutex>
 
@@ -27,9 +27,13 @@ public:
 
   auto add_sample(detail::sample_site_local_data,
                   ClockSample time_point,
-                  thread_id) noexcept(false) -> void;
+                  detail::thread_index,
+                  detail::sample_arguments<ClockSample> = {}) noexcept(false)
+    -> void;
   auto add_sample(detail::sample_site_local_data,
-                  ClockSample time_point) noexcept(false) -> void;
+                  ClockSample time_point,
+                  detail::sample_arguments<ClockSample> = {}) noexcept(false)
+    -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
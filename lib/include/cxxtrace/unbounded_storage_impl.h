@@ -7,8 +7,8 @@
 #endif
 
 #include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <cxxtrace/unbounded_unsafe_storage_impl.h>
 #include <mutex> // IWYU pragma: keep
 
@@ -29,22 +29,25 @@ unbounded_storage<ClockSample>::reset() noexcept -> void
 
 template<class ClockSample>
 auto
-unbounded_storage<ClockSample>::add_sample(detail::sample_site_local_data site,
-                                           ClockSample time_point,
-                                           thread_id thread_id) noexcept(false)
-  -> void
+unbounded_storage<ClockSample>::add_sample(
+  detail::sample_site_local_data site,
+  ClockSample time_point,
+  detail::thread_index thread,
+  detail::sample_arguments<ClockSample> arguments) noexcept(false) -> void
 {
   auto lock = std::unique_lock{ this->mutex };
-  this->storage.add_sample(site, time_point, thread_id);
+  this->storage.add_sample(site, time_point, thread, arguments);
 }
 
 template<class ClockSample>
 auto
 unbounded_storage<ClockSample>::add_sample(
   detail::sample_site_local_data site,
-  ClockSample time_point) noexcept(false) -> void
+  ClockSample time_point,
+  detail::sample_arguments<ClockSample> arguments) noexcept(false) -> void
 {
-  this->add_sample(site, time_point, get_current_thread_id());
+  this->add_sample(
+    site, time_point, detail::get_current_thread_index(), arguments);
 }
 
 template<class ClockSample>
@@ -3,8 +3,8 @@
 
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/snapshot.h>
-#include <cxxtrace/thread.h>
 #include <vector>
 
 namespace cxxtrace {
@@ -27,17 +27,22 @@ public:
 
   auto add_sample(detail::sample_site_local_data,
                   ClockSample time_point,
-                  thread_id) noexcept(false) -> void;
+                  detail::thread_index,
+                  detail::sample_arguments<ClockSample> = {}) noexcept(false)
+    -> void;
   auto add_sample(detail::sample_site_local_data,
-                  ClockSample time_point) noexcept(false) -> void;
+                  ClockSample time_point,
+                  detail::sample_arguments<ClockSample> = {}) noexcept(false)
+    -> void;
   template<class Clock>
   auto take_all_samples(Clock&) noexcept(false) -> samples_snapshot;
   auto remember_current_thread_name_for_next_snapshot() -> void;
 
 private:
   using sample = detail::global_sample<ClockSample>;
+  using record = detail::sample_record<sample>;
 
-  std::vector<sample> samples;
+  std::vector<record> samples;
   detail::thread_name_set remembered_thread_names;
 };
 }
@@ -8,6 +8,7 @@
 
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/snapshot_sample.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/detail/vector.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/thread.h>
@@ -35,18 +36,29 @@ auto
 unbounded_unsafe_storage<ClockSample>::add_sample(
   detail::sample_site_local_data site,
   ClockSample time_point,
-  thread_id thread_id) noexcept(false) -> void
+  detail::thread_index thread,
+  detail::sample_arguments<ClockSample> arguments) noexcept(false) -> void
 {
-  this->samples.emplace_back(sample{ site, thread_id, time_point });
+  auto old_size = this->samples.size();
+  this->samples.resize(old_size +
+                       detail::sample_record_count<sample>(arguments));
+  detail::write_sample_records(
+    record::from_sample(sample{ site, time_point }, thread),
+    arguments,
+    [&](auto index, const record& r) noexcept {
+      this->samples[old_size + index] = r;
+    });
 }
 
 template<class ClockSample>
 auto
 unbounded_unsafe_storage<ClockSample>::add_sample(
   detail::sample_site_local_data site,
-  ClockSample time_point) noexcept(false) -> void
+  ClockSample time_point,
+  detail::sample_arguments<ClockSample> arguments) noexcept(false) -> void
 {
-  this->add_sample(site, time_point, get_current_thread_id());
+  this->add_sample(
+    site, time_point, detail::get_current_thread_index(), arguments);
 }
 
 template<class ClockSample>
@@ -55,8 +67,11 @@ auto
 unbounded_unsafe_storage<ClockSample>::take_all_samples(Clock& clock) noexcept(
   false) -> samples_snapshot
 {
-  auto samples = std::vector<sample>{};
-  swap(samples, this->samples);
+  auto clock_anchor = measure_wall_clock_anchor(clock);
+
+  auto records = std::vector<record>{};
+  swap(records, this->samples);
+  auto samples = detail::snapshot_sample::many_from_records(records, clock);
 
   auto named_threads = std::vector<thread_id>{};
   auto thread_names = std::move(this->remembered_thread_names);
@@ -69,9 +84,9 @@ unbounded_unsafe_storage<ClockSample>::take_all_samples(Clock& clock) noexcept(
     }
   }
 
-  return samples_snapshot{ detail::snapshot_sample::many_from_samples(samples,
-                                                                      clock),
-                           std::move(thread_names) };
+  return samples_snapshot{ std::move(samples),
+                           std::move(thread_names),
+                           clock_anchor };
 }
 
 template<class ClockSample>
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <cxxtrace/interned_string.h>
+#include <cxxtrace/string.h>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+namespace cxxtrace {
+namespace {
+// An interned string. The string's characters (and a null terminator) are
+// allocated immediately after the interned_string_entry.
+struct interned_string_entry
+{
+  static auto make(std::string_view string, std::size_t hash) noexcept(false)
+    -> interned_string_entry*
+  {
+    auto* memory = static_cast<char*>(
+      ::operator new(sizeof(interned_string_entry) + string.size() + 1));
+    auto* entry = new (memory) interned_string_entry{ hash, string.size() };
+    auto* data = memory + sizeof(interned_string_entry);
+    std::memcpy(data, string.data(), string.size());
+    data[string.size()] = '\0';
+    return entry;
+  }
+
+  static auto destroy(interned_string_entry* entry) noexcept -> void
+  {
+    ::operator delete(entry);
+  }
+
+  auto data() const noexcept -> czstring
+  {
+    return reinterpret_cast<czstring>(this) + sizeof(interned_string_entry);
+  }
+
+  auto matches(std::string_view string, std::size_t hash) const noexcept
+    -> bool
+  {
+    return this->hash == hash &&
+           std::string_view{ this->data(), this->size } == string;
+  }
+
+  std::size_t hash;
+  std::size_t size;
+};
+
+// An append-only, open-addressed hash set of interned_string_entry-s.
+//
+// If a string's probe sequence is full, the string is added to the next table
+// instead. Slots never become empty, so a string is in the first table whose
+// probe sequence for the string is not full, or in no table at all.
+class interned_string_table
+{
+public:
+  static constexpr auto max_probe_count = std::size_t{ 32 };
+
+  explicit interned_string_table(std::size_t capacity) noexcept(false)
+    : capacity{ capacity }
+    , slots{ std::make_unique<std::atomic<const interned_string_entry*>[]>(
+        capacity) }
+  {}
+
+  // Find string, or add new_entry if string is missing. new_entry is allocated
+  // if needed, and is set to nullptr if it was added to the table.
+  //
+  // Return nullptr if string's probe sequence is full.
+  auto find_or_add(std::string_view string,
+                   std::size_t hash,
+                   interned_string_entry*& new_entry) noexcept(false)
+    -> const interned_string_entry*
+  {
+    auto probe_count = std::min(max_probe_count, this->capacity);
+    for (auto i = std::size_t{ 0 }; i < probe_count; ++i) {
+      auto& slot = this->slots[(hash + i) % this->capacity];
+      auto* entry = slot.load(std::memory_order_acquire);
+      if (!entry) {
+        if (!new_entry) {
+          new_entry = interned_string_entry::make(string, hash);
+        }
+        if (slot.compare_exchange_strong(entry,
+                                         new_entry,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+          return std::exchange(new_entry, nullptr);
+        }
+        // Another thread filled the slot first. entry is the other thread's
+        // entry.
+      }
+      if (entry->matches(string, hash)) {
+        return entry;
+      }
+    }
+    return nullptr;
+  }
+
+  auto next_table() noexcept(false) -> interned_string_table*
+  {
+    auto* next = this->next.load(std::memory_order_acquire);
+    if (next) {
+      return next;
+    }
+    auto new_next =
+      std::make_unique<interned_string_table>(this->capacity * 2);
+    if (this->next.compare_exchange_strong(next,
+                                           new_next.get(),
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+      return new_next.release();
+    }
+    // Another thread added a table first. next is the other thread's table.
+    return next;
+  }
+
+private:
+  std::size_t capacity;
+  std::unique_ptr<std::atomic<const interned_string_entry*>[]> slots;
+  std::atomic<interned_string_table*> next{ nullptr };
+};
+
+auto
+get_interned_string_table() noexcept(false) -> interned_string_table&
+{
+  // Never destroy the table. Interned strings must outlive every snapshot.
+  static auto* table = new interned_string_table{ 1024 };
+  return *table;
+}
+
+// Each thread's recently-interned strings, indexed by hash.
+constexpr auto recent_string_cache_size = std::size_t{ 64 };
+thread_local const interned_string_entry*
+  recent_strings[recent_string_cache_size] = {};
+}
+
+auto
+intern_string(std::string_view string) noexcept(false) -> czstring
+{
+  auto hash = std::hash<std::string_view>{}(string);
+  auto& recent_string = recent_strings[hash % recent_string_cache_size];
+  if (recent_string && recent_string->matches(string, hash)) {
+    return recent_string->data();
+  }
+
+  interned_string_entry* new_entry = nullptr;
+  auto* table = &get_interned_string_table();
+  for (;;) {
+    auto* entry = table->find_or_add(string, hash, new_entry);
+    if (entry) {
+      if (new_entry) {
+        interned_string_entry::destroy(new_entry);
+      }
+      recent_string = entry;
+      return entry->data();
+    }
+    table = table->next_table();
+  }
+}
+}
@@ -0,0 +1,97 @@
+#include <cxxtrace/detail/have.h>
+#include <cxxtrace/detail/perf_event.h>
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+#include <cerrno>
+#include <cstdint>
+#include <cxxtrace/detail/warning.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+#endif
+
+namespace cxxtrace {
+namespace detail {
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+namespace {
+auto
+perf_event_open(::perf_event_attr* attributes,
+                ::pid_t pid,
+                int cpu,
+                int group_fd,
+                unsigned long flags) noexcept -> int
+{
+  return int(
+    ::syscall(SYS_perf_event_open, attributes, pid, cpu, group_fd, flags));
+}
+}
+
+thread_perf_event::thread_perf_event(
+  std::uint32_t type,
+  std::uint64_t config,
+  const thread_perf_event* group_leader) noexcept(false)
+{
+  CXXTRACE_WARNING_PUSH
+  CXXTRACE_WARNING_IGNORE_GCC("-Wmissing-field-initializers")
+  auto attributes = ::perf_event_attr{
+    .type = type,
+    .size = sizeof(::perf_event_attr),
+    .config = config,
+    .read_format = 0,
+    .disabled = false,
+    .inherit = false,
+    .exclude_kernel = true,
+    .exclude_hv = true,
+  };
+  CXXTRACE_WARNING_POP
+  auto pid = ::pid_t{ 0 };
+  auto cpu = -1;
+  auto group_fd = group_leader ? group_leader->event.get() : -1;
+  this->event.reset(
+    perf_event_open(&attributes, pid, cpu, group_fd, PERF_FLAG_FD_CLOEXEC));
+  if (!this->event.valid()) {
+    throw std::system_error{ errno,
+                             std::generic_category(),
+                             "Failed to open Linux perf event" };
+  }
+
+  auto* mapping = ::mmap(
+    nullptr, ::getpagesize(), PROT_READ, MAP_SHARED, this->event.get(), 0);
+  if (mapping == MAP_FAILED) {
+    throw std::system_error{ errno,
+                             std::generic_category(),
+                             "Failed to map Linux perf event page" };
+  }
+  this->page_ = static_cast<::perf_event_mmap_page*>(mapping);
+}
+
+thread_perf_event::~thread_perf_event() noexcept
+{
+  if (this->page_) {
+    ::munmap(this->page_, ::getpagesize());
+  }
+}
+
+auto
+thread_perf_event::page() const noexcept -> const ::perf_event_mmap_page*
+{
+  return this->page_;
+}
+
+auto
+thread_perf_event::read_with_system_call() noexcept(false) -> std::uint64_t
+{
+  auto count = std::uint64_t{};
+  auto rc = ::read(this->event.get(), &count, sizeof(count));
+  if (rc != sizeof(count)) {
+    throw std::system_error{ errno,
+                             std::generic_category(),
+                             "Failed to read Linux perf event" };
+  }
+  return count;
+}
+#endif
+}
+}
@@ -0,0 +1,191 @@
+#include <atomic>
+#include <cstddef>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/sample.h>
+#include <cxxtrace/string.h>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace cxxtrace {
+namespace detail {
+namespace {
+class sample_site_registry
+{
+public:
+  auto intern(czstring category,
+              czstring name,
+              czstring file,
+              int line) noexcept(false) -> const sample_site_set&
+  {
+    auto lock = std::lock_guard<std::mutex>{ this->mutex };
+    auto& sites = this->site_sets[key{ category, name, file, line }];
+    if (!sites) {
+      auto set_index = this->set_count;
+      sites = this->allocate_set();
+      sites->category = category;
+      sites->name = name;
+      for (auto i = std::size_t{ 0 }; i < sample_kind_count; ++i) {
+        auto kind = static_cast<sample_kind>(i);
+        auto index =
+          static_cast<sample_site_index>(set_index * sample_kind_count + i);
+        sites->sites[i] =
+          sample_site{ category, name, kind, index, file, line };
+      }
+    }
+    return *sites;
+  }
+
+  auto lookup(sample_site_index index) noexcept -> const sample_site&
+  {
+    auto [chunk, offset] = chunk_of_set(index / sample_kind_count);
+    // The sample_site_set was published before its index could be read, so its
+    // chunk pointer is visible.
+    auto* sets = this->chunks[chunk].load(std::memory_order_acquire);
+    return sets[offset].sites[index % sample_kind_count];
+  }
+
+private:
+  using key = std::tuple<czstring, czstring, czstring, int>;
+
+  // Sets are stored in chunks of doubling size: chunk 0 holds set 0, chunk 1
+  // holds sets 1 and 2, chunk 2 holds sets 3 through 6, and so on. Chunks
+  // never move, so lookup needs no lock.
+  static constexpr auto chunk_count = std::size_t{ 32 };
+  static constexpr auto max_set_count =
+    std::numeric_limits<sample_site_index>::max() / sample_kind_count;
+
+  static auto chunk_of_set(std::size_t set_index) noexcept
+    -> std::pair<std::size_t, std::size_t>
+  {
+    auto chunk = std::size_t{ 0 };
+    while ((std::size_t{ 2 } << chunk) - 1 <= set_index) {
+      chunk += 1;
+    }
+    return { chunk, set_index - ((std::size_t{ 1 } << chunk) - 1) };
+  }
+
+  // Requires: this->mutex is locked.
+  auto allocate_set() noexcept(false) -> sample_site_set*
+  {
+    auto set_index = this->set_count;
+    if (set_index >= max_set_count) {
+      throw std::length_error{ "too many sample sites" };
+    }
+    auto [chunk, offset] = chunk_of_set(set_index);
+    auto* sets = this->chunks[chunk].load(std::memory_order_relaxed);
+    if (!sets) {
+      sets = new sample_site_set[std::size_t{ 1 } << chunk];
+      this->chunks[chunk].store(sets, std::memory_order_release);
+    }
+    this->set_count += 1;
+    return &sets[offset];
+  }
+
+  std::mutex mutex;
+  std::map<key, sample_site_set*> site_sets;
+  std::size_t set_count{ 0 };
+  std::atomic<sample_site_set*> chunks[chunk_count]{};
+};
+
+auto
+get_sample_site_registry() noexcept -> sample_site_registry&
+{
+  // Never destroy the registry. Samples might be added or read during static
+  // destruction.
+  static auto* registry = new sample_site_registry{};
+  return *registry;
+}
+}
+
+auto
+intern_sample_site_set(czstring category,
+                       czstring name,
+                       czstring file,
+                       int line) noexcept(false) -> const sample_site_set&
+{
+  return get_sample_site_registry().intern(category, name, file, line);
+}
+
+auto
+lookup_sample_site(sample_site_index index) noexcept -> const sample_site&
+{
+  return get_sample_site_registry().lookup(index);
+}
+
+namespace {
+// Return the sample_site_set in entry with category and name as dynamic names
+// if necessary. If entry is empty, intern a sample_site_set for category and
+// name and store it in entry.
+//
+// Each entry is interned at most once, so the registry holds a bounded number
+// of sample_site_set-s, and its mutex is locked only on an entry's first use.
+auto
+get_or_intern_sample_site_set(std::atomic<const sample_site_set*>& entry,
+                              czstring category,
+                              czstring name,
+                              czstring file,
+                              int line) noexcept(false) -> sample_sites
+{
+  auto* sites = entry.load(std::memory_order_acquire);
+  if (!sites) {
+    auto* interned = &intern_sample_site_set(category, name, file, line);
+    if (entry.compare_exchange_strong(sites,
+                                      interned,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      return sample_sites{ interned };
+    }
+    // Another thread interned a sample_site_set first. Use its set.
+  }
+  return sample_sites{ sites,
+                       sites->category == category ? nullptr : category,
+                       sites->name == name ? nullptr : name };
+}
+}
+
+auto
+sample_site_cache::get_slow(czstring category, czstring name) noexcept(false)
+  -> sample_sites
+{
+  return get_or_intern_sample_site_set(
+    this->sites, category, name, this->file, this->line);
+}
+
+auto
+multi_sample_site_cache::get_slow(czstring category,
+                                  czstring name,
+                                  std::size_t hint) noexcept(false)
+  -> sample_sites
+{
+  for (auto i = std::size_t{ 0 }; i < entry_count; ++i) {
+    auto& entry = this->entries[(hint + i) % entry_count];
+    auto* sites = entry.load(std::memory_order_acquire);
+    if (!sites) {
+      auto* interned =
+        &intern_sample_site_set(category, name, this->file, this->line);
+      if (entry.compare_exchange_strong(sites,
+                                        interned,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+        return sample_sites{ interned };
+      }
+      // Another thread filled this entry first. Check its set, then keep
+      // probing.
+    }
+    if (sites->category == category && sites->name == name) {
+      return sample_sites{ sites };
+    }
+  }
+  // Every entry holds a different name.
+  return get_or_intern_sample_site_set(this->entries[hint % entry_count],
+                                       category,
+                                       name,
+                                       this->file,
+                                       this->line);
+}
+}
+}
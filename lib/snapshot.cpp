@@ -1,13 +1,17 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/snapshot_sample.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/hardware_counters.h>
 #include <cxxtrace/sample.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/string.h>
 #include <cxxtrace/thread.h>
 #include <iterator>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -21,6 +25,39 @@ samples_snapshot::samples_snapshot(
   , thread_names{ std::move(thread_names) }
 {}
 
+samples_snapshot::samples_snapshot(
+  std::vector<detail::snapshot_sample> samples,
+  detail::thread_name_set thread_names,
+  wall_clock_anchor clock_anchor) noexcept
+  : samples{ std::move(samples) }
+  , thread_names{ std::move(thread_names) }
+  , clock_anchor_{ clock_anchor }
+{}
+
+samples_snapshot::samples_snapshot(
+  std::vector<detail::snapshot_sample> samples,
+  detail::thread_name_set thread_names,
+  wall_clock_anchor clock_anchor,
+  std::vector<sample_loss> losses) noexcept
+  : samples{ std::move(samples) }
+  , thread_names{ std::move(thread_names) }
+  , clock_anchor_{ clock_anchor }
+  , losses_{ std::move(losses) }
+{}
+
+samples_snapshot::samples_snapshot(
+  std::vector<detail::snapshot_sample> samples,
+  detail::thread_name_set thread_names,
+  wall_clock_anchor clock_anchor,
+  std::vector<std::chrono::nanoseconds> processor_clock_offsets,
+  std::vector<sample_loss> losses) noexcept
+  : samples{ std::move(samples) }
+  , thread_names{ std::move(thread_names) }
+  , clock_anchor_{ clock_anchor }
+  , processor_clock_offsets_{ std::move(processor_clock_offsets) }
+  , losses_{ std::move(losses) }
+{}
+
 samples_snapshot::samples_snapshot(const samples_snapshot&) noexcept(false) =
   default;
 samples_snapshot::samples_snapshot(samples_snapshot&&) noexcept = default;
@@ -67,22 +104,76 @@ samples_snapshot::thread_ids() const noexcept(false) -> std::vector<thread_id>
   return ids;
 }
 
+auto
+samples_snapshot::clock_anchor() const noexcept
+  -> const std::optional<wall_clock_anchor>&
+{
+  return this->clock_anchor_;
+}
+
+auto
+samples_snapshot::processor_clock_offsets() const noexcept
+  -> const std::vector<std::chrono::nanoseconds>&
+{
+  return this->processor_clock_offsets_;
+}
+
+auto
+samples_snapshot::losses() const noexcept -> const std::vector<sample_loss>&
+{
+  return this->losses_;
+}
+
+auto
+samples_snapshot::discarded_record_count() const noexcept -> std::uint64_t
+{
+  auto count = std::uint64_t{ 0 };
+  for (const auto& loss : this->losses_) {
+    count += loss.discarded_record_count;
+  }
+  return count;
+}
+
 auto
 sample_ref::category() const noexcept -> czstring
 {
-  return this->sample->site.category;
+  if (this->sample->dynamic_category) {
+    return this->sample->dynamic_category;
+  }
+  return this->sample->site.category();
 }
 
 auto
 sample_ref::kind() const noexcept -> sample_kind
 {
-  return this->sample->site.kind;
+  return this->sample->site.kind();
 }
 
 auto
 sample_ref::name() const noexcept -> czstring
 {
-  return this->sample->site.name;
+  if (this->sample->dynamic_name) {
+    return this->sample->dynamic_name;
+  }
+  return this->sample->site.name();
+}
+
+auto
+sample_ref::file() const noexcept -> czstring
+{
+  return this->sample->site.site().file;
+}
+
+auto
+sample_ref::line() const noexcept -> int
+{
+  return this->sample->site.site().line;
+}
+
+auto
+sample_ref::depth() const noexcept -> int
+{
+  return this->sample->depth;
 }
 
 auto
@@ -97,6 +188,50 @@ sample_ref::timestamp() const -> time_point
   return this->sample->timestamp;
 }
 
+auto
+sample_ref::counters() const noexcept -> std::optional<hardware_counters>
+{
+  return this->sample->counters;
+}
+
+auto
+sample_ref::thread_cpu_time() const noexcept
+  -> std::optional<std::chrono::nanoseconds>
+{
+  return this->sample->thread_cpu_time;
+}
+
+auto
+sample_ref::arguments() const noexcept -> const std::vector<sample_argument>&
+{
+  return this->sample->arguments;
+}
+
+auto
+sample_ref::event_id() const noexcept -> std::optional<std::uint64_t>
+{
+  return this->sample->event_id;
+}
+
+auto
+sample_ref::end_timestamp() const noexcept -> std::optional<time_point>
+{
+  return this->sample->end_timestamp;
+}
+
+auto
+sample_ref::end_counters() const noexcept -> std::optional<hardware_counters>
+{
+  return this->sample->end_counters;
+}
+
+auto
+sample_ref::end_thread_cpu_time() const noexcept
+  -> std::optional<std::chrono::nanoseconds>
+{
+  return this->sample->end_thread_cpu_time;
+}
+
 sample_ref::sample_ref(const detail::snapshot_sample* sample) noexcept
   : sample{ sample }
 {}
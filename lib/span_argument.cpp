@@ -0,0 +1,17 @@
+#include <cxxtrace/span_argument.h>
+#include <string_view>
+
+namespace cxxtrace {
+auto
+operator==(const sample_argument& x, const sample_argument& y) noexcept -> bool
+{
+  return std::string_view{ x.name } == std::string_view{ y.name } &&
+         x.value == y.value;
+}
+
+auto
+operator!=(const sample_argument& x, const sample_argument& y) noexcept -> bool
+{
+  return !(x == y);
+}
+}
@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cxxtrace/detail/have.h>
+#include <cxxtrace/thread_cpu_time.h>
+
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+#include <cerrno>
+#include <system_error>
+#include <time.h>
+#endif
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+#include <atomic>
+#include <cstdint>
+#include <cxxtrace/detail/perf_event.h>
+#include <linux/perf_event.h>
+#include <optional>
+#include <system_error>
+#include <utility>
+#endif
+
+namespace cxxtrace {
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+auto
+posix_thread_cpu_time_reader::supported() noexcept -> bool
+{
+  auto time = ::timespec{};
+  return ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0;
+}
+
+auto
+posix_thread_cpu_time_reader::read() noexcept(false) -> std::chrono::nanoseconds
+{
+  auto time = ::timespec{};
+  auto rc = ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  if (rc != 0) {
+    throw std::system_error{ errno,
+                             std::generic_category(),
+                             "clock_gettime(CLOCK_THREAD_CPUTIME_ID) failed" };
+  }
+  return std::chrono::seconds{ time.tv_sec } +
+         std::chrono::nanoseconds{ time.tv_nsec };
+}
+#endif
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+namespace {
+auto
+rdtsc() noexcept -> std::uint64_t
+{
+  std::uint32_t eax;
+  std::uint32_t edx;
+  asm volatile("rdtsc" : "=a"(eax), "=d"(edx));
+  return (std::uint64_t{ edx } << 32) | std::uint64_t{ eax };
+}
+
+auto
+read_task_clock(detail::thread_perf_event& event) noexcept(false)
+  -> std::chrono::nanoseconds
+{
+  // See the documentation of perf_event_mmap_page in <linux/perf_event.h> for
+  // this protocol. The event counts only while the current thread is running,
+  // and the current thread is running right now, so the time elapsed since the
+  // kernel last updated the page counts towards the event's running time.
+  const auto* page = event.page();
+  for (;;) {
+    auto sequence = page->lock;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    auto running = page->time_running;
+    auto can_extrapolate = bool(page->cap_user_time);
+    if (can_extrapolate) {
+      auto cycles = rdtsc();
+      auto shift = page->time_shift;
+      auto quotient = cycles >> shift;
+      auto remainder = cycles & ((std::uint64_t{ 1 } << shift) - 1);
+      running += page->time_offset + quotient * page->time_mult +
+                 ((remainder * page->time_mult) >> shift);
+    }
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (page->lock != sequence) {
+      continue;
+    }
+    if (!can_extrapolate) {
+      return std::chrono::nanoseconds{ event.read_with_system_call() };
+    }
+    return std::chrono::nanoseconds{ running };
+  }
+}
+
+auto
+open_thread_task_clock() noexcept -> std::optional<detail::thread_perf_event>
+{
+  try {
+    return std::optional<detail::thread_perf_event>{
+      std::in_place, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, nullptr
+    };
+  } catch (const std::system_error&) {
+    return std::nullopt;
+  }
+}
+
+// Return nullptr if the current thread's event could not be opened. The
+// failure is remembered, so perf_event_open is not retried on every read.
+auto
+get_thread_task_clock() noexcept -> detail::thread_perf_event*
+{
+  thread_local auto task_clock = open_thread_task_clock();
+  return task_clock.has_value() ? &*task_clock : nullptr;
+}
+}
+
+auto
+perf_event_task_clock_reader::supported() noexcept -> bool
+{
+  return get_thread_task_clock() != nullptr;
+}
+
+auto
+perf_event_task_clock_reader::read() noexcept(false)
+  -> std::chrono::nanoseconds
+{
+  auto* task_clock = get_thread_task_clock();
+  if (!task_clock) {
+    return unavailable_thread_cpu_time;
+  }
+  return read_task_clock(*task_clock);
+}
+#endif
+}
@@ -0,0 +1,197 @@
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cxxtrace/detail/thread_index.h>
+#include <cxxtrace/thread.h>
+#include <functional>
+#include <mutex>
+
+namespace cxxtrace {
+namespace detail {
+namespace {
+// Assigns thread_index-s to thread_id-s.
+//
+// Registering or releasing a thread locks a mutex and never allocates. Looking
+// up a thread ID by index does not lock.
+class thread_registry
+{
+public:
+  auto index_of_id(thread_id id) noexcept -> thread_index
+  {
+    auto lock = std::lock_guard<std::mutex>{ this->mutex };
+    auto slot = home_slot(id);
+    // slot_count is greater than max_thread_index_count, so this loop
+    // terminates.
+    for (;; slot = (slot + 1) % slot_count) {
+      auto slot_value = this->slots[slot];
+      if (slot_value == empty_slot) {
+        break;
+      }
+      auto index = static_cast<thread_index>(slot_value - 1);
+      if (this->thread_ids[index].load(std::memory_order_relaxed) == id) {
+        return index;
+      }
+    }
+
+    auto index = thread_index{};
+    if (this->thread_count < max_thread_index_count) {
+      index = static_cast<thread_index>(this->thread_count);
+      this->thread_count += 1;
+    } else if (this->released_count > 0) {
+      index = this->released_indexes[this->released_begin];
+      this->released_begin =
+        (this->released_begin + 1) % max_thread_index_count;
+      this->released_count -= 1;
+    } else {
+      return unknown_thread_index;
+    }
+    this->thread_ids[index].store(id, std::memory_order_release);
+    this->slots[slot] = static_cast<std::uint16_t>(index + 1);
+    return index;
+  }
+
+  auto release_index(thread_index index) noexcept -> void
+  {
+    if (index == unknown_thread_index) {
+      return;
+    }
+    auto lock = std::lock_guard<std::mutex>{ this->mutex };
+    auto slot_value = static_cast<std::uint16_t>(index + 1);
+    auto hole =
+      home_slot(this->thread_ids[index].load(std::memory_order_relaxed));
+    for (; this->slots[hole] != slot_value; hole = (hole + 1) % slot_count) {
+      if (this->slots[hole] == empty_slot) {
+        // index is not registered.
+        return;
+      }
+    }
+
+    // Remove the slot without leaving a tombstone: move later slots in hole's
+    // probe sequence back into the hole.
+    for (auto slot = (hole + 1) % slot_count;; slot = (slot + 1) % slot_count) {
+      auto moved_value = this->slots[slot];
+      if (moved_value == empty_slot) {
+        break;
+      }
+      auto moved_home = home_slot(
+        this->thread_ids[moved_value - 1].load(std::memory_order_relaxed));
+      auto distance = [](std::size_t from, std::size_t to) noexcept {
+        return (to + slot_count - from) % slot_count;
+      };
+      if (distance(moved_home, slot) >= distance(hole, slot)) {
+        this->slots[hole] = moved_value;
+        hole = slot;
+      }
+    }
+    this->slots[hole] = empty_slot;
+
+    this->released_indexes[(this->released_begin + this->released_count) %
+                           max_thread_index_count] = index;
+    this->released_count += 1;
+  }
+
+  auto id_of_index(thread_index index) const noexcept -> thread_id
+  {
+    if (index == unknown_thread_index) {
+      return thread_id{};
+    }
+    return this->thread_ids[index].load(std::memory_order_acquire);
+  }
+
+private:
+  // An open-addressed hash table from thread_id to thread_index, using linear
+  // probing. Each slot holds a registered thread_index plus 1 (which fits
+  // because unknown_thread_index is never stored), or empty_slot.
+  static constexpr auto empty_slot = std::uint16_t{ 0 };
+  static constexpr auto slot_count = max_thread_index_count * 2;
+
+  static auto home_slot(thread_id id) noexcept -> std::size_t
+  {
+    return std::hash<thread_id>{}(id) % slot_count;
+  }
+
+  std::mutex mutex;
+  // The number of indexes which have ever been assigned.
+  std::size_t thread_count{ 0 };
+  std::array<std::uint16_t, slot_count> slots{};
+  std::array<std::atomic<thread_id>, max_thread_index_count> thread_ids{};
+  // A FIFO queue of released indexes.
+  std::array<thread_index, max_thread_index_count> released_indexes{};
+  std::size_t released_begin{ 0 };
+  std::size_t released_count{ 0 };
+};
+
+auto
+get_thread_registry() noexcept -> thread_registry&
+{
+  // Never destroy the registry. Samples might be added or read during static
+  // destruction.
+  static auto* registry = new thread_registry{};
+  return *registry;
+}
+
+// The calling thread's index plus 1, or 0 if the thread has not been
+// registered yet.
+thread_local std::uint32_t current_thread_index_plus_one = 0;
+
+// Releases the calling thread's index when the thread exits.
+//
+// current_thread_index_plus_one is trivially destructible (so reading it needs
+// no initialization guard), so this separate thread_local is constructed when
+// the thread is registered.
+class current_thread_index_releaser
+{
+public:
+  current_thread_index_releaser() noexcept = default;
+
+  current_thread_index_releaser(const current_thread_index_releaser&) = delete;
+  current_thread_index_releaser& operator=(
+    const current_thread_index_releaser&) = delete;
+
+  ~current_thread_index_releaser() noexcept
+  {
+    auto index_plus_one = current_thread_index_plus_one;
+    // If a later thread_local destructor adds a sample, register the thread
+    // again instead of using the released index.
+    current_thread_index_plus_one = 0;
+    if (index_plus_one != 0) {
+      release_thread_index(static_cast<thread_index>(index_plus_one - 1));
+    }
+  }
+};
+}
+
+auto
+get_current_thread_index() noexcept -> thread_index
+{
+  auto index_plus_one = current_thread_index_plus_one;
+  if (index_plus_one == 0) {
+    thread_local auto releaser = current_thread_index_releaser{};
+    static_cast<void>(releaser);
+    auto index = thread_index_of_id(get_current_thread_id());
+    index_plus_one = std::uint32_t{ index } + 1;
+    current_thread_index_plus_one = index_plus_one;
+  }
+  return static_cast<thread_index>(index_plus_one - 1);
+}
+
+auto
+thread_index_of_id(thread_id id) noexcept -> thread_index
+{
+  return get_thread_registry().index_of_id(id);
+}
+
+auto
+release_thread_index(thread_index index) noexcept -> void
+{
+  get_thread_registry().release_index(index);
+}
+
+auto
+thread_id_of_index(thread_index index) noexcept -> thread_id
+{
+  return get_thread_registry().id_of_index(index);
+}
+}
+}
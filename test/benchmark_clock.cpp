@@ -1,19 +1,411 @@
 #include "black_hole.h"
+#include "clock_support.h"
 #include "cxxtrace_benchmark.h"
 #include "cxxtrace_cpp.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <atomic>
 #include <benchmark/benchmark.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cxxtrace/clock.h>       // IWYU pragma: keep
 #include <cxxtrace/clock_extra.h> // IWYU pragma: keep
 #include <cxxtrace/detail/have.h> // IWYU pragma: keep
 #include <cxxtrace/detail/warning.h>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#if CXXTRACE_HAVE_SCHED_SETAFFINITY
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace cxxtrace_test {
 namespace {
+// Measures short durations (tens of nanoseconds) as precisely as possible.
+//
+// On x86-64 with an invariant TSC, latency_stopwatch brackets the measured code
+// with lfence;rdtsc and rdtscp;lfence so that neither the measured code nor the
+// code around it leaks into the measurement. Otherwise, latency_stopwatch uses
+// std::chrono::steady_clock.
+class latency_stopwatch
+{
+public:
+  using ticks = std::uint64_t;
+
+  explicit latency_stopwatch() noexcept(false)
+  {
+#if defined(__x86_64__)
+    if (cxxtrace::x86_tsc_clock::supported()) {
+      this->use_tsc = true;
+      auto clock = cxxtrace::x86_tsc_clock{};
+      this->nanoseconds_per_tick =
+        clock.make_time_point(ticks{ 1'000'000'000 })
+          .nanoseconds_since_reference()
+          .count() /
+        1e9;
+    }
+#endif
+    this->overhead = this->measure_overhead();
+  }
+
+  [[gnu::always_inline]] auto start() noexcept -> ticks
+  {
+#if defined(__x86_64__)
+    if (this->use_tsc) {
+      std::uint32_t eax;
+      std::uint32_t edx;
+      asm volatile("lfence\n"
+                   "rdtsc"
+                   : "=a"(eax), "=d"(edx)
+                   :
+                   : "memory");
+      return (ticks{ edx } << 32) | ticks{ eax };
+    }
+#endif
+    return this->steady_clock_now();
+  }
+
+  [[gnu::always_inline]] auto stop() noexcept -> ticks
+  {
+#if defined(__x86_64__)
+    if (this->use_tsc) {
+      std::uint32_t eax;
+      std::uint32_t edx;
+      asm volatile("rdtscp\n"
+                   "lfence"
+                   : "=a"(eax), "=d"(edx)
+                   :
+                   : "ecx", "memory");
+      return (ticks{ edx } << 32) | ticks{ eax };
+    }
+#endif
+    return this->steady_clock_now();
+  }
+
+  // Returns the duration between start and stop, excluding the overhead of
+  // the stopwatch itself.
+  auto elapsed(ticks start, ticks stop) const noexcept -> ticks
+  {
+    auto duration = stop - start;
+    return duration > this->overhead ? duration - this->overhead : 0;
+  }
+
+  auto to_nanoseconds(ticks duration) const noexcept -> double
+  {
+    return static_cast<double>(duration) * this->nanoseconds_per_tick;
+  }
+
+private:
+  auto steady_clock_now() noexcept -> ticks
+  {
+    return static_cast<ticks>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  }
+
+  auto measure_overhead() noexcept -> ticks
+  {
+    auto overhead = std::numeric_limits<ticks>::max();
+    for (auto i = 0; i < 1000; ++i) {
+      auto start = this->start();
+      auto stop = this->stop();
+      overhead = std::min(overhead, stop - start);
+    }
+    return overhead;
+  }
+
+  bool use_tsc{ false };
+  double nanoseconds_per_tick{ 1.0 };
+  ticks overhead{ 0 };
+};
+
+#if defined(__x86_64__)
+auto
+x86_rdtscp_is_supported() noexcept -> bool
+{
+  std::uint32_t eax;
+  asm("cpuid" : "=a"(eax) : "a"(0x80000000) : "ebx", "ecx", "edx");
+  if (eax < 0x80000001) {
+    return false;
+  }
+  std::uint32_t edx;
+  asm("cpuid" : "=d"(edx) : "a"(0x80000001) : "ebx", "ecx");
+  // From Volume 2A:
+  // 80000001H: EDX: Bit 27: RDTSCP and IA32_TSC_AUX are available if 1.
+  return edx & (1 << 27);
+}
+
+// lfence waits for prior instructions to complete before rdtsc executes.
+struct x86_lfence_rdtsc
+{
+  static auto supported() noexcept -> bool { return true; }
+
+  static auto read() noexcept -> std::uint64_t
+  {
+    std::uint32_t eax;
+    std::uint32_t edx;
+    asm volatile("lfence\n"
+                 "rdtsc"
+                 : "=a"(eax), "=d"(edx));
+    return (std::uint64_t{ edx } << 32) | std::uint64_t{ eax };
+  }
+};
+
+// rdtscp waits for prior instructions to complete, but later instructions can
+// begin executing before rdtscp reads the TSC.
+struct x86_rdtscp
+{
+  static auto supported() noexcept -> bool { return x86_rdtscp_is_supported(); }
+
+  static auto read() noexcept -> std::uint64_t
+  {
+    std::uint32_t eax;
+    std::uint32_t edx;
+    asm volatile("rdtscp" : "=a"(eax), "=d"(edx) : : "ecx");
+    return (std::uint64_t{ edx } << 32) | std::uint64_t{ eax };
+  }
+};
+
+// rdtscp;lfence is fully serializing: neither earlier nor later instructions
+// overlap with the TSC read.
+struct x86_rdtscp_lfence
+{
+  static auto supported() noexcept -> bool { return x86_rdtscp_is_supported(); }
+
+  static auto read() noexcept -> std::uint64_t
+  {
+    std::uint32_t eax;
+    std::uint32_t edx;
+    asm volatile("rdtscp\n"
+                 "lfence"
+                 : "=a"(eax), "=d"(edx)
+                 :
+                 : "ecx");
+    return (std::uint64_t{ edx } << 32) | std::uint64_t{ eax };
+  }
+};
+
+// Like cxxtrace::x86_tsc_clock, but reads the TSC with Read::read instead of a
+// plain (non-serializing) rdtsc instruction.
+//
+// Comparing x86_tsc_clock with x86_tsc_clock_with shows how serializing the
+// TSC read affects the performance of the code surrounding a query.
+template<class Read>
+class x86_tsc_clock_with : public cxxtrace::x86_tsc_clock
+{
+public:
+  static auto supported() noexcept -> bool
+  {
+    return cxxtrace::x86_tsc_clock::supported() && Read::supported();
+  }
+
+  explicit x86_tsc_clock_with() noexcept(false) = default;
+
+  auto query() -> sample { return Read::read(); }
+};
+#endif
+
+#if CXXTRACE_HAVE_SCHED_SETAFFINITY
+auto
+get_allowed_cpus() noexcept -> std::vector<int>
+{
+  auto cpus = std::vector<int>{};
+  auto cpu_set = ::cpu_set_t{};
+  CPU_ZERO(&cpu_set);
+  if (::sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    return cpus;
+  }
+  for (auto cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      cpus.emplace_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// Restrict the current thread to one CPU for the lifetime of a
+// scoped_cpu_pin, then restore the thread's original affinity.
+class scoped_cpu_pin
+{
+public:
+  explicit scoped_cpu_pin(int cpu) noexcept
+  {
+    CPU_ZERO(&this->original_cpus);
+    if (::pthread_getaffinity_np(::pthread_self(),
+                                 sizeof(this->original_cpus),
+                                 &this->original_cpus) != 0) {
+      return;
+    }
+    auto cpu_set = ::cpu_set_t{};
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    this->pinned = ::pthread_setaffinity_np(
+                     ::pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+  }
+
+  scoped_cpu_pin(const scoped_cpu_pin&) = delete;
+  scoped_cpu_pin& operator=(const scoped_cpu_pin&) = delete;
+
+  ~scoped_cpu_pin()
+  {
+    if (this->pinned) {
+      ::pthread_setaffinity_np(
+        ::pthread_self(), sizeof(this->original_cpus), &this->original_cpus);
+    }
+  }
+
+  auto ok() const noexcept -> bool { return this->pinned; }
+
+private:
+  ::cpu_set_t original_cpus;
+  bool pinned{ false };
+};
+#endif
+
+// Like benchmark::State::SkipWithError, but also safe in multi-threaded
+// benchmarks. Every thread must enter the benchmark loop, or the other threads
+// wait forever for it to start.
+auto
+skip_benchmark(benchmark::State& bench, const char* message) -> void
+{
+  bench.SkipWithError(message);
+  for (auto _ : bench) {
+  }
+}
+
+template<class Clock>
+auto
+nanoseconds_of(Clock& clock, const typename Clock::sample& sample)
+  -> std::int64_t
+{
+  return clock.make_time_point(sample).nanoseconds_since_reference().count();
+}
+
 template<class Clock>
-class clock_benchmark : public benchmark_fixture
+class clock_benchmark : public thread_shared_benchmark_fixture
 {
 public:
   using clock_type = Clock;
+
+  explicit clock_benchmark() noexcept(false)
+  {
+    if (clock_is_supported<clock_type>()) {
+      this->shared_clock.emplace();
+    }
+  }
+
+protected:
+  struct monotonicity_violations
+  {
+    // Number of queries which returned a time earlier than a time returned by
+    // a query which happened before (on any thread).
+    std::int64_t causal_count{ 0 };
+    // Number of queries which returned a time earlier than the previous query
+    // on the same thread.
+    std::int64_t same_thread_count{ 0 };
+    std::int64_t max_nanoseconds{ 0 };
+  };
+
+  // Call merge with a lock held, then wait for every other thread of this
+  // benchmark to call merge_thread_results.
+  //
+  // merge_thread_results returns true for exactly one thread. That thread
+  // should report the merged results as counters. (Google Benchmark sums each
+  // counter across threads.)
+  template<class Merge>
+  auto merge_thread_results(benchmark::State& bench, Merge&& merge) -> bool
+  {
+    auto lock = std::unique_lock{ this->mutex };
+    merge();
+    this->merged_thread_count += 1;
+    this->merged_cond_var.notify_all();
+    if (bench.thread_index != 0) {
+      return false;
+    }
+    this->merged_cond_var.wait(
+      lock, [&] { return this->merged_thread_count >= bench.threads; });
+    return true;
+  }
+
+  auto report_latencies(benchmark::State& bench,
+                        const latency_stopwatch& stopwatch,
+                        const latency_histogram& latencies) -> void
+  {
+    auto report = [&](const char* name, latency_histogram::value_type ticks) {
+      bench.counters[name] = stopwatch.to_nanoseconds(ticks);
+    };
+    report("p50 ns", latencies.percentile(50.0));
+    report("p99 ns", latencies.percentile(99.0));
+    report("p99.9 ns", latencies.percentile(99.9));
+    report("max ns", latencies.max());
+  }
+
+  // Query shared_clock on every thread, and count the times the clock
+  // appeared to go backwards.
+  auto measure_monotonicity(benchmark::State& bench) -> void
+  {
+    auto& clock = *this->shared_clock;
+    auto violations = monotonicity_violations{};
+    auto previous_time = std::numeric_limits<std::int64_t>::min();
+    for (auto _ : bench) {
+      auto observed_time =
+        this->latest_time.load(std::memory_order_acquire);
+      auto time = nanoseconds_of(clock, clock.query());
+      if (time < observed_time) {
+        violations.causal_count += 1;
+        violations.max_nanoseconds =
+          std::max(violations.max_nanoseconds, observed_time - time);
+      }
+      if (time < previous_time) {
+        violations.same_thread_count += 1;
+      }
+      previous_time = time;
+      while (observed_time < time &&
+             !this->latest_time.compare_exchange_weak(
+               observed_time,
+               time,
+               std::memory_order_release,
+               std::memory_order_acquire)) {
+      }
+    }
+
+    auto is_reporter = this->merge_thread_results(bench, [&] {
+      this->merged_violations.causal_count += violations.causal_count;
+      this->merged_violations.same_thread_count +=
+        violations.same_thread_count;
+      this->merged_violations.max_nanoseconds = std::max(
+        this->merged_violations.max_nanoseconds, violations.max_nanoseconds);
+      this->merged_query_count += bench.iterations();
+    });
+    if (is_reporter) {
+      auto& merged = this->merged_violations;
+      bench.counters["violations"] = merged.causal_count;
+      bench.counters["violation rate"] =
+        static_cast<double>(merged.causal_count) /
+        static_cast<double>(
+          std::max(this->merged_query_count, std::uint64_t{ 1 }));
+      bench.counters["same-thread violations"] = merged.same_thread_count;
+      bench.counters["max violation ns"] = merged.max_nanoseconds;
+    }
+  }
+
+  // A clock shared by all threads, or nullopt if clock_type is not supported.
+  std::optional<clock_type> shared_clock;
+
+  // The latest time returned by a query of shared_clock, in nanoseconds.
+  alignas(64) std::atomic<std::int64_t> latest_time{
+    std::numeric_limits<std::int64_t>::min()
+  };
+
+  std::mutex mutex;
+  std::condition_variable merged_cond_var;
+  int merged_thread_count{ 0 };
+  latency_histogram merged_latencies;
+  monotonicity_violations merged_violations;
+  std::uint64_t merged_query_count{ 0 };
 };
 // TODO(strager): Allow CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F to be called
 // multiple times or something to avoid #if in macro arguments.
@@ -23,12 +415,41 @@ CXXTRACE_BENCHMARK_CONFIGURE_TEMPLATE_F(clock_benchmark,
 #if CXXTRACE_HAVE_MACH_TIME
                                         cxxtrace::apple_absolute_time_clock,
                                         cxxtrace::apple_approximate_time_clock,
+#endif
+#if defined(__x86_64__)
+                                        cxxtrace::x86_tsc_clock,
+                                        x86_tsc_clock_with<x86_lfence_rdtsc>,
+                                        x86_tsc_clock_with<x86_rdtscp>,
+                                        x86_tsc_clock_with<x86_rdtscp_lfence>,
 #endif
                                         cxxtrace::fake_clock,
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+                                        cxxtrace::
+                                          compact_posix_clock_gettime_clock<
+                                            CLOCK_MONOTONIC>,
+                                        cxxtrace::posix_clock_gettime_clock<
+                                          CLOCK_MONOTONIC>,
+#endif
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+                                        cxxtrace::
+                                          compact_posix_clock_gettime_clock<
+                                            CLOCK_MONOTONIC_COARSE>,
+                                        cxxtrace::fastest_monotonic_clock,
+                                        cxxtrace::posix_clock_gettime_clock<
+                                          CLOCK_BOOTTIME>,
+                                        cxxtrace::posix_clock_gettime_clock<
+                                          CLOCK_MONOTONIC_COARSE>,
+                                        cxxtrace::posix_clock_gettime_clock<
+                                          CLOCK_MONOTONIC_RAW>,
+#endif
+                                        cxxtrace::
+                                          compact_posix_gettimeofday_clock,
                                         cxxtrace::posix_gettimeofday_clock,
                                         cxxtrace::std_high_resolution_clock,
                                         cxxtrace::std_steady_clock,
-                                        cxxtrace::std_system_clock);
+                                        cxxtrace::std_system_clock,
+                                        cxxtrace::
+                                          ticker_approximate_time_clock);
 CXXTRACE_WARNING_POP
 
 CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, query)
@@ -36,6 +457,11 @@ CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, query)
 {
   using clock_type = typename fixture_type::clock_type;
 
+  if (!clock_is_supported<clock_type>()) {
+    bench.SkipWithError("This clock is not supported");
+    return;
+  }
+
   auto clock = clock_type{};
   for (auto _ : bench) {
     auto sample = clock.query();
@@ -49,6 +475,11 @@ CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, query_with_alu_workload)
 {
   using clock_type = typename fixture_type::clock_type;
 
+  if (!clock_is_supported<clock_type>()) {
+    bench.SkipWithError("This clock is not supported");
+    return;
+  }
+
   auto alu_multiplier = bench.range(0);
   auto abyss = black_hole{};
   auto clock = clock_type{};
@@ -66,5 +497,125 @@ CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(clock_benchmark, query_with_alu_workload)
   ->Arg(1 << 3)
   ->Arg(1 << 4)
   ->Arg(1 << 5);
+
+// Measure the latency of each query individually, and report tail latencies.
+//
+// With several threads, queries contend for shared resources (such as a
+// sibling hyperthread's execution units or a shared cache line), which affects
+// tail latency much more than mean latency.
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, query_latency)
+(benchmark::State& bench)
+{
+  using clock_type = typename fixture_type::clock_type;
+
+  if (!clock_is_supported<clock_type>()) {
+    skip_benchmark(bench, "This clock is not supported");
+    return;
+  }
+
+  auto clock = clock_type{};
+  auto stopwatch = latency_stopwatch{};
+  auto latencies = latency_histogram{};
+  for (auto _ : bench) {
+    auto start = stopwatch.start();
+    auto sample = clock.query();
+    benchmark::DoNotOptimize(sample);
+    auto stop = stopwatch.stop();
+    latencies.record(stopwatch.elapsed(start, stop));
+  }
+
+  auto is_reporter = this->merge_thread_results(
+    bench, [&] { this->merged_latencies.merge(latencies); });
+  if (is_reporter) {
+    this->report_latencies(bench, stopwatch, this->merged_latencies);
+  }
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(clock_benchmark, query_latency)
+  ->UseRealTime()
+  ->ThreadRange(1, benchmark::CPUInfo::Get().num_cpus * 2);
+
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, cross_thread_monotonicity)
+(benchmark::State& bench)
+{
+  using clock_type = typename fixture_type::clock_type;
+
+  if (!clock_is_supported<clock_type>()) {
+    skip_benchmark(bench, "This clock is not supported");
+    return;
+  }
+
+  this->measure_monotonicity(bench);
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(clock_benchmark,
+                                       cross_thread_monotonicity)
+  ->UseRealTime()
+  ->ThreadRange(2, std::max(2, benchmark::CPUInfo::Get().num_cpus * 2));
+
+#if CXXTRACE_HAVE_SCHED_SETAFFINITY
+// Like cross_thread_monotonicity, but with each thread pinned to a different
+// CPU. This exposes clocks which are not synchronized between cores (e.g. a
+// TSC which is not synchronized between sockets).
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, cross_core_monotonicity)
+(benchmark::State& bench)
+{
+  using clock_type = typename fixture_type::clock_type;
+
+  if (!clock_is_supported<clock_type>()) {
+    skip_benchmark(bench, "This clock is not supported");
+    return;
+  }
+  auto cpus = get_allowed_cpus();
+  if (cpus.size() < static_cast<std::size_t>(bench.threads)) {
+    skip_benchmark(bench, "Not enough CPUs to give each thread its own CPU");
+    return;
+  }
+  auto pin = scoped_cpu_pin{ cpus[bench.thread_index] };
+  if (!pin.ok()) {
+    skip_benchmark(bench, "Could not pin thread to CPU");
+    return;
+  }
+
+  this->measure_monotonicity(bench);
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(clock_benchmark,
+                                       cross_core_monotonicity)
+  ->UseRealTime()
+  ->ThreadRange(2, std::max(2, benchmark::CPUInfo::Get().num_cpus));
+#endif
+
+// Measure the smallest observable difference between two queries, and how
+// often consecutive queries return the same time.
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(clock_benchmark, resolution)
+(benchmark::State& bench)
+{
+  using clock_type = typename fixture_type::clock_type;
+
+  if (!clock_is_supported<clock_type>()) {
+    bench.SkipWithError("This clock is not supported");
+    return;
+  }
+
+  auto clock = clock_type{};
+  auto steps = latency_histogram{};
+  auto repeated_count = std::uint64_t{ 0 };
+  auto previous_time = nanoseconds_of(clock, clock.query());
+  for (auto _ : bench) {
+    auto time = nanoseconds_of(clock, clock.query());
+    if (time > previous_time) {
+      steps.record(static_cast<latency_histogram::value_type>(time -
+                                                              previous_time));
+    } else {
+      repeated_count += 1;
+    }
+    previous_time = time;
+  }
+
+  bench.counters["resolution ns"] = steps.percentile(0.0);
+  bench.counters["p50 step ns"] = steps.percentile(50.0);
+  bench.counters["repeated samples"] =
+    static_cast<double>(repeated_count) /
+    static_cast<double>(std::max(bench.iterations(), std::size_t{ 1 }));
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(clock_benchmark, resolution);
 }
 }
@@ -7,9 +7,11 @@
 #include <cxxtrace/detail/have.h> // IWYU pragma: keep
 #include <cxxtrace/detail/mpsc_ring_queue.h>
 #include <cxxtrace/detail/ring_queue.h>
+#include <cxxtrace/detail/sample.h>
 #include <cxxtrace/detail/spin_lock.h>
 #include <cxxtrace/detail/spsc_ring_queue.h>
 #include <cxxtrace/detail/warning.h>
+#include <cxxtrace/hardware_counters.h>
 #include <mutex>
 
 namespace cxxtrace_test {
@@ -36,11 +38,16 @@ protected:
   ring_queue_wrapper<RingQueue> queue;
 };
 
+// Compare 32-bit indexes (which overflow after 2^31 items) with the default
+// 64-bit indexes.
 CXXTRACE_BENCHMARK_CONFIGURE_TEMPLATE_F(
   ring_queue_benchmark,
-  (cxxtrace::detail::mpsc_ring_queue<int, 1024>),
-  (cxxtrace::detail::ring_queue<int, 1024>),
-  (cxxtrace::detail::spsc_ring_queue<int, 1024>));
+  (cxxtrace::detail::mpsc_ring_queue<int, 1024, int>),
+  (cxxtrace::detail::mpsc_ring_queue<int, 1024, std::uint64_t>),
+  (cxxtrace::detail::ring_queue<int, 1024, int>),
+  (cxxtrace::detail::ring_queue<int, 1024, std::uint64_t>),
+  (cxxtrace::detail::spsc_ring_queue<int, 1024, int>),
+  (cxxtrace::detail::spsc_ring_queue<int, 1024, std::uint64_t>));
 
 CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(ring_queue_benchmark, individual_pushes)
 (benchmark::State& bench)
@@ -60,6 +67,71 @@ CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(ring_queue_benchmark, individual_pushes)
 CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(ring_queue_benchmark, individual_pushes)
   ->Arg(400);
 
+// A clock sample large enough to need 32-byte sample records.
+struct wide_clock_sample
+{
+  std::int64_t seconds;
+  std::int64_t nanoseconds;
+};
+
+// A clock sample large enough to need 64-byte sample records.
+struct counted_clock_sample
+{
+  std::int64_t time;
+  cxxtrace::hardware_counters counters;
+};
+
+using global_sample_record_16 = cxxtrace::detail::sample_record<
+  cxxtrace::detail::global_sample<std::int64_t>>;
+using global_sample_record_32 = cxxtrace::detail::sample_record<
+  cxxtrace::detail::global_sample<wide_clock_sample>>;
+using global_sample_record_64 = cxxtrace::detail::sample_record<
+  cxxtrace::detail::global_sample<counted_clock_sample>>;
+static_assert(sizeof(global_sample_record_16) == 16);
+static_assert(sizeof(global_sample_record_32) == 32);
+static_assert(sizeof(global_sample_record_64) == 64);
+
+template<class RingQueue>
+class sample_record_ring_queue_benchmark
+  : public ring_queue_benchmark<RingQueue>
+{};
+
+CXXTRACE_BENCHMARK_CONFIGURE_TEMPLATE_F(
+  sample_record_ring_queue_benchmark,
+  (cxxtrace::detail::mpsc_ring_queue<global_sample_record_16, 1024>),
+  (cxxtrace::detail::mpsc_ring_queue<global_sample_record_32, 1024>),
+  (cxxtrace::detail::mpsc_ring_queue<global_sample_record_64, 1024>),
+  (cxxtrace::detail::ring_queue<global_sample_record_16, 1024>),
+  (cxxtrace::detail::ring_queue<global_sample_record_32, 1024>),
+  (cxxtrace::detail::ring_queue<global_sample_record_64, 1024>),
+  (cxxtrace::detail::spsc_ring_queue<global_sample_record_16, 1024>),
+  (cxxtrace::detail::spsc_ring_queue<global_sample_record_32, 1024>),
+  (cxxtrace::detail::spsc_ring_queue<global_sample_record_64, 1024>));
+
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(sample_record_ring_queue_benchmark,
+                                     individual_pushes)
+(benchmark::State& bench)
+{
+  using record = typename decltype(this->queue)::value_type;
+
+  auto sample = record{};
+  sample.kind = cxxtrace::detail::sample_record_kind::sample;
+  for (auto _ : bench) {
+    this->queue.reset();
+#if defined(__clang__)
+#pragma clang loop unroll_count(1)
+#endif
+    for (auto i = 0; i < this->items_per_iteration; ++i) {
+      this->queue.push(
+        1, [&sample](auto data) noexcept { data.set(0, sample); });
+    }
+    benchmark::DoNotOptimize(this->queue);
+  }
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(sample_record_ring_queue_benchmark,
+                                       individual_pushes)
+  ->Arg(400);
+
 template<class Mutex>
 class locked_spsc_ring_queue_benchmark
   : public ring_queue_benchmark<cxxtrace::detail::spsc_ring_queue<int, 1024>>
@@ -120,4 +192,51 @@ CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(locked_spsc_ring_queue_benchmark,
 CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(locked_spsc_ring_queue_benchmark,
                                        individual_pushes)
   ->Arg(400);
+
+// Push from several threads into one queue. With more threads than processors,
+// the scheduler preempts writers in the middle of their pushes.
+template<class RingQueue>
+class concurrent_ring_queue_benchmark : public thread_shared_benchmark_fixture
+{
+public:
+  auto tear_down_thread(benchmark::State& bench) -> void override
+  {
+    if (bench.thread_index == 0) {
+      auto total_items = bench.iterations() * bench.threads * items_per_push;
+      bench.counters["total items"] = total_items;
+      bench.counters["item throughput"] = { static_cast<double>(total_items),
+                                            benchmark::Counter::kIsRate };
+    }
+  }
+
+protected:
+  static constexpr auto items_per_push = 2;
+
+  ring_queue_wrapper<RingQueue> queue;
+};
+
+CXXTRACE_BENCHMARK_CONFIGURE_TEMPLATE_F(
+  concurrent_ring_queue_benchmark,
+  (cxxtrace::detail::mpsc_ring_queue<global_sample_record_16, 1024>));
+
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(concurrent_ring_queue_benchmark,
+                                     oversubscribed_pushes)
+(benchmark::State& bench)
+{
+  using record = typename decltype(this->queue)::value_type;
+
+  auto sample = record{};
+  sample.kind = cxxtrace::detail::sample_record_kind::sample;
+  auto write = [&sample](auto data) noexcept {
+    data.set(0, sample);
+    data.set(1, sample);
+  };
+  for (auto _ : bench) {
+    this->queue.push(this->items_per_push, write);
+  }
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(concurrent_ring_queue_benchmark,
+                                       oversubscribed_pushes)
+  ->UseRealTime()
+  ->ThreadRange(1, benchmark::CPUInfo::Get().num_cpus * 8);
 }
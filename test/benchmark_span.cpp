@@ -255,6 +255,22 @@ CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(concurrent_span_benchmark, enter_exit)
   ->UseRealTime()
   ->ThreadRange(1, 4);
 
+// With more threads than processors, the scheduler preempts threads in the
+// middle of adding samples, and threads which migrate onto the same processor
+// share that processor's queue.
+CXXTRACE_BENCHMARK_DEFINE_TEMPLATE_F(concurrent_span_benchmark,
+                                     oversubscribed_enter_exit)
+(benchmark::State& bench)
+{
+  for (auto _ : bench) {
+    auto span = CXXTRACE_SPAN("category", "span");
+  }
+}
+CXXTRACE_BENCHMARK_REGISTER_TEMPLATE_F(concurrent_span_benchmark,
+                                       oversubscribed_enter_exit)
+  ->UseRealTime()
+  ->ThreadRange(1, benchmark::CPUInfo::Get().num_cpus * 8);
+
 namespace {
 cpu_data_cache_thrasher::cpu_data_cache_thrasher()
 {
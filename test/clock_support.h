@@ -0,0 +1,36 @@
+#ifndef CXXTRACE_TEST_CLOCK_SUPPORT_H
+#define CXXTRACE_TEST_CLOCK_SUPPORT_H
+
+#include "void_t.h"
+#include <type_traits>
+#include <utility>
+
+namespace cxxtrace_test {
+namespace detail {
+template<class Clock, class = void_t<>>
+struct clock_support
+{
+  static auto supported() noexcept -> bool { return true; }
+};
+
+template<class Clock>
+struct clock_support<Clock, void_t<decltype(Clock::supported())>>
+{
+  static auto supported() noexcept -> bool { return Clock::supported(); }
+};
+}
+
+// Returns false if Clock cannot be constructed on this machine.
+//
+// Clocks with a static supported() member function (such as
+// cxxtrace::x86_tsc_clock) might be unsupported. Other clocks are always
+// supported.
+template<class Clock>
+auto
+clock_is_supported() noexcept -> bool
+{
+  return detail::clock_support<Clock>::supported();
+}
+}
+
+#endif
@@ -1,5 +1,5 @@
-#ifndef CXXTRACE_EVENT_H
-#define CXXTRACE_EVENT_H
+#ifndef CXXTRACE_TEST_EVENT_H
+#define CXXTRACE_TEST_EVENT_H
 
 #include <condition_variable> // IWYU pragma: keep
 #include <mutex>
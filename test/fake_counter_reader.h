@@ -0,0 +1,28 @@
+#ifndef CXXTRACE_TEST_FAKE_COUNTER_READER_H
+#define CXXTRACE_TEST_FAKE_COUNTER_READER_H
+
+#include <cxxtrace/hardware_counters.h>
+
+namespace cxxtrace_test {
+// A counter reader for cxxtrace::hardware_counter_clock whose counters advance
+// by a fixed amount on every read.
+class fake_counter_reader
+{
+public:
+  static auto supported() noexcept -> bool { return true; }
+
+  auto read() noexcept -> cxxtrace::hardware_counters
+  {
+    auto counters = this->next_counters;
+    this->next_counters.cycles += this->increment.cycles;
+    this->next_counters.instructions += this->increment.instructions;
+    this->next_counters.llc_misses += this->increment.llc_misses;
+    return counters;
+  }
+
+  cxxtrace::hardware_counters next_counters{ 0, 0, 0 };
+  cxxtrace::hardware_counters increment{ 1, 1, 1 };
+};
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CXXTRACE_TEST_FAKE_CPU_TIME_READER_H
+#define CXXTRACE_TEST_FAKE_CPU_TIME_READER_H
+
+#include <chrono>
+
+namespace cxxtrace_test {
+// A CPU time reader for cxxtrace::thread_cpu_time_clock whose CPU time advances
+// by a fixed amount on every read.
+class fake_cpu_time_reader
+{
+public:
+  static auto supported() noexcept -> bool { return true; }
+
+  auto read() noexcept -> std::chrono::nanoseconds
+  {
+    auto cpu_time = this->next_cpu_time;
+    this->next_cpu_time += this->increment;
+    return cpu_time;
+  }
+
+  std::chrono::nanoseconds next_cpu_time{ 0 };
+  std::chrono::nanoseconds increment{ 1 };
+};
+}
+
+#endif
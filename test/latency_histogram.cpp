@@ -0,0 +1,70 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace cxxtrace_test {
+auto
+latency_histogram::merge(const latency_histogram& other) noexcept -> void
+{
+  for (auto i = 0; i < bucket_count; ++i) {
+    this->buckets[i] += other.buckets[i];
+  }
+  this->count_ += other.count_;
+  this->max_ = std::max(this->max_, other.max_);
+}
+
+auto
+latency_histogram::reset() noexcept -> void
+{
+  this->buckets.fill(0);
+  this->count_ = 0;
+  this->max_ = 0;
+}
+
+auto
+latency_histogram::count() const noexcept -> std::uint64_t
+{
+  return this->count_;
+}
+
+auto
+latency_histogram::max() const noexcept -> value_type
+{
+  return this->max_;
+}
+
+auto
+latency_histogram::percentile(double percentile) const noexcept -> value_type
+{
+  if (this->count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<std::uint64_t>(
+    std::ceil(percentile * static_cast<double>(this->count_) / 100.0));
+  rank = std::clamp(rank, std::uint64_t{ 1 }, this->count_);
+
+  auto cumulative_count = std::uint64_t{ 0 };
+  for (auto i = 0; i < bucket_count; ++i) {
+    cumulative_count += this->buckets[i];
+    if (cumulative_count >= rank) {
+      return std::min(bucket_upper_bound(i), this->max_);
+    }
+  }
+  return this->max_;
+}
+
+auto
+latency_histogram::bucket_upper_bound(int index) noexcept -> value_type
+{
+  static_assert(bucket_index(std::numeric_limits<value_type>::max()) ==
+                bucket_count - 1);
+  if (index < 2 * sub_bucket_count) {
+    return static_cast<value_type>(index);
+  }
+  auto shift = index / sub_bucket_count - 1;
+  auto sub_bucket = value_type(index % sub_bucket_count + sub_bucket_count);
+  return ((sub_bucket + 1) << shift) - 1;
+}
+}
@@ -0,0 +1,67 @@
+#ifndef CXXTRACE_TEST_LATENCY_HISTOGRAM_H
+#define CXXTRACE_TEST_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace cxxtrace_test {
+// A log-linear histogram of durations (or any other non-negative integers),
+// similar to HdrHistogram.
+//
+// Values less than 64 are recorded exactly. Larger values are recorded with a
+// relative error of at most 1/32 (about 3%). record does not allocate, so it is
+// cheap enough to call once per measured operation.
+class latency_histogram
+{
+public:
+  using value_type = std::uint64_t;
+
+  auto record(value_type value) noexcept -> void
+  {
+    this->buckets[bucket_index(value)] += 1;
+    this->count_ += 1;
+    this->max_ = std::max(this->max_, value);
+  }
+
+  auto merge(const latency_histogram&) noexcept -> void;
+  auto reset() noexcept -> void;
+
+  auto count() const noexcept -> std::uint64_t;
+  auto max() const noexcept -> value_type;
+
+  // Returns an upper bound for the value at the given percentile (between 0.0
+  // and 100.0, inclusive).
+  //
+  // If no values were recorded, percentile returns 0.
+  auto percentile(double) const noexcept -> value_type;
+
+private:
+  static constexpr auto sub_bucket_bits = 5;
+  static constexpr auto sub_bucket_count = 1 << sub_bucket_bits;
+  // Values with their most significant bit in bit 0 through bit sub_bucket_bits
+  // share the first two groups of sub-buckets. Every higher bit gets its own
+  // group.
+  static constexpr auto bucket_count =
+    sub_bucket_count * (64 - sub_bucket_bits + 1);
+
+  static constexpr auto bucket_index(value_type value) noexcept -> int
+  {
+    if (value < 2 * sub_bucket_count) {
+      return static_cast<int>(value);
+    }
+    auto most_significant_bit = 63 - __builtin_clzll(value);
+    auto shift = most_significant_bit - sub_bucket_bits;
+    auto sub_bucket = static_cast<int>(value >> shift) - sub_bucket_count;
+    return sub_bucket_count * (shift + 1) + sub_bucket;
+  }
+
+  static auto bucket_upper_bound(int index) noexcept -> value_type;
+
+  std::array<std::uint64_t, bucket_count> buckets{};
+  std::uint64_t count_{ 0 };
+  value_type max_{ 0 };
+};
+}
+
+#endif
@@ -99,11 +99,13 @@ public:
   }
 
   template<class Sink>
-  auto pop_all_into(Sink&& output) -> void
+  auto pop_all_into(Sink&& output) -> size_type
   {
+    auto discarded_item_count = size_type{ 0 };
     for (auto& queue : this->queue_by_processor) {
-      queue.pop_all_into(std::forward<Sink>(output));
+      discarded_item_count += queue.pop_all_into(std::forward<Sink>(output));
     }
+    return discarded_item_count;
   }
 
 private:
@@ -3,7 +3,6 @@
 
 #include "processor_local_mpsc_ring_queue.h"
 #include "void_t.h"
-#include <cxxtrace/detail/mpsc_ring_queue.h>
 #include <cxxtrace/detail/queue_sink.h>
 #include <type_traits>
 
@@ -19,6 +18,13 @@
 #endif
 
 namespace cxxtrace_test {
+// The result of ring_queue_wrapper<>::try_push for ring queues whose pushes
+// always succeed.
+enum class ring_queue_push_result : bool
+{
+  pushed = true,
+};
+
 namespace { // Avoid ODR violations due to #if.
 template<class RingQueue, class = void_t<>>
 class ring_queue_wrapper;
@@ -29,7 +35,7 @@ class ring_queue_wrapper<
   void_t<decltype(std::declval<RingQueue&>().push(1, nullptr))>>
 {
 public:
-  using push_result = cxxtrace::detail::mpsc_ring_queue_push_result;
+  using push_result = ring_queue_push_result;
   using size_type = typename RingQueue::size_type;
   using value_type = typename RingQueue::value_type;
 
@@ -56,16 +62,16 @@ public:
   }
 
   template<class Allocator>
-  auto pop_all_into(std::vector<value_type, Allocator>& output) -> void
+  auto pop_all_into(std::vector<value_type, Allocator>& output) -> size_type
   {
-    this->pop_all_into(
+    return this->pop_all_into(
       cxxtrace::detail::vector_queue_sink<value_type, Allocator>{ output });
   }
 
   template<class Sink>
-  auto pop_all_into(Sink&& output) -> void
+  auto pop_all_into(Sink&& output) -> size_type
   {
-    this->queue.pop_all_into(std::forward<Sink>(output));
+    return this->queue.pop_all_into(std::forward<Sink>(output));
   }
 
   RingQueue queue;
@@ -117,39 +123,21 @@ public:
   }
 
   template<class Allocator>
-  auto pop_all_into(std::vector<value_type, Allocator>& output) -> void
+  auto pop_all_into(std::vector<value_type, Allocator>& output) -> size_type
   {
-    this->pop_all_into(
+    return this->pop_all_into(
       cxxtrace::detail::vector_queue_sink<value_type, Allocator>{ output });
   }
 
   template<class Sink>
-  auto pop_all_into(Sink&& output) -> void
+  auto pop_all_into(Sink&& output) -> size_type
   {
-    this->queue.pop_all_into(std::forward<Sink>(output));
+    return this->queue.pop_all_into(std::forward<Sink>(output));
   }
 
   RingQueue queue;
 
 private:
-  static auto assert_push_succeeded(
-    cxxtrace::detail::mpsc_ring_queue_push_result push_result) noexcept -> void
-  {
-    using cxxtrace::detail::mpsc_ring_queue_push_result;
-    switch (push_result) {
-      case mpsc_ring_queue_push_result::not_pushed_due_to_contention:
-#if CXXTRACE_ENABLE_CDSCHECKER || CXXTRACE_ENABLE_RELACY
-        CXXTRACE_ASSERT(false);
-#else
-        std::fprintf(stderr, "fatal: try_push failed due to contention\n");
-        std::terminate();
-#endif
-        break;
-      case mpsc_ring_queue_push_result::pushed:
-        break;
-    }
-  }
-
   static auto assert_push_succeeded(
     cxxtrace_test::processor_local_mpsc_ring_queue_push_result push_result)
     -> void
@@ -1,4 +1,6 @@
 #include "event.h"
+#include "fake_counter_reader.h"
+#include "fake_cpu_time_reader.h"
 #include "gtest_scoped_trace.h"
 #include "nlohmann_json.h"
 #include "thread.h"
@@ -8,8 +10,15 @@
 #include <cxxtrace/chrome_trace_event_format.h>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/config.h>
+#include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/span_depth.h>
+#include <cxxtrace/event.h>
+#include <cxxtrace/hardware_counters.h>
+#include <cxxtrace/ring_queue_unsafe_storage.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/span.h>
+#include <cxxtrace/span_argument.h>
+#include <cxxtrace/thread_cpu_time.h>
 #include <cxxtrace/unbounded_storage.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -19,8 +28,8 @@
 #include <thread>
 #include <type_traits>
 
-#define CXXTRACE_SPAN(category, name)                                          \
-  CXXTRACE_SPAN_WITH_CONFIG(this->get_cxxtrace_config(), category, name)
+#define CXXTRACE_SPAN(category, ...)                                           \
+  CXXTRACE_SPAN_WITH_CONFIG(this->get_cxxtrace_config(), category, __VA_ARGS__)
 
 using testing::AnyOf;
 using testing::Eq;
@@ -433,6 +442,322 @@ TEST_F(test_chrome_trace_event_format,
   EXPECT_EQ(parsed.type(), nlohmann::json::value_t::object);
 }
 
+TEST_F(test_chrome_trace_event_format,
+       spans_with_hardware_counters_include_counter_deltas_as_args)
+{
+  using counter_clock_type =
+    cxxtrace::hardware_counter_clock<cxxtrace::fake_clock,
+                                     fake_counter_reader>;
+  auto counter_clock = counter_clock_type{};
+  counter_clock.counter_reader().increment = { 1000, 500, 7 };
+  auto storage = cxxtrace::unbounded_storage<counter_clock_type::sample>{};
+  auto config = cxxtrace::basic_config{ storage, counter_clock };
+
+  {
+    auto outer_span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "outer");
+    {
+      auto inner_span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "inner");
+    }
+  }
+
+  auto parsed =
+    this->write_snapshot_and_parse(storage.take_all_samples(counter_clock));
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 4);
+
+  EXPECT_EQ(get(trace_events.at(0), "ph"), "B");
+  EXPECT_EQ(get(trace_events.at(1), "ph"), "B");
+
+  auto inner_exit = trace_events.at(2);
+  EXPECT_EQ(get(inner_exit, "ph"), "E");
+  EXPECT_EQ(get(inner_exit, "name"), "inner");
+  EXPECT_EQ(get(get(inner_exit, "args"), "cycles"), 1000);
+  EXPECT_EQ(get(get(inner_exit, "args"), "instructions"), 500);
+  EXPECT_EQ(get(get(inner_exit, "args"), "llc_misses"), 7);
+
+  auto outer_exit = trace_events.at(3);
+  EXPECT_EQ(get(outer_exit, "ph"), "E");
+  EXPECT_EQ(get(outer_exit, "name"), "outer");
+  EXPECT_EQ(get(get(outer_exit, "args"), "cycles"), 3000);
+  EXPECT_EQ(get(get(outer_exit, "args"), "instructions"), 1500);
+  EXPECT_EQ(get(get(outer_exit, "args"), "llc_misses"), 21);
+}
+
+TEST_F(test_chrome_trace_event_format,
+       spans_with_thread_cpu_time_include_on_and_off_cpu_time)
+{
+  using cpu_time_clock_type =
+    cxxtrace::thread_cpu_time_clock<cxxtrace::fake_clock,
+                                    fake_cpu_time_reader>;
+  auto cpu_time_clock = cpu_time_clock_type{};
+  cpu_time_clock.clock().set_duration_between_samples(
+    std::chrono::nanoseconds{ 1000 });
+  cpu_time_clock.cpu_time_reader().increment = std::chrono::nanoseconds{ 300 };
+  auto storage = cxxtrace::unbounded_storage<cpu_time_clock_type::sample>{};
+  auto config = cxxtrace::basic_config{ storage, cpu_time_clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto parsed =
+    this->write_snapshot_and_parse(storage.take_all_samples(cpu_time_clock));
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 2);
+
+  auto enter = trace_events.at(0);
+  EXPECT_EQ(get(enter, "ph"), "B");
+  EXPECT_EQ(get(enter, "tts"), 0.0);
+  EXPECT_EQ(get(enter, "args"), nlohmann::json{});
+
+  auto exit = trace_events.at(1);
+  EXPECT_EQ(get(exit, "ph"), "E");
+  EXPECT_EQ(get(exit, "tts"), 0.3);
+  EXPECT_EQ(get(get(exit, "args"), "on_cpu_ns"), 300);
+  EXPECT_EQ(get(get(exit, "args"), "off_cpu_ns"), 700);
+}
+
+TEST_F(test_chrome_trace_event_format, span_arguments_are_args_of_begin_event)
+{
+  {
+    auto span = CXXTRACE_SPAN("category",
+                              "span",
+                              cxxtrace::span_argument{ "id", -42 },
+                              cxxtrace::span_argument{ "ratio", 0.25 },
+                              cxxtrace::span_argument{ "status", "ok" });
+  }
+
+  auto parsed = this->write_snapshot_and_parse();
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 2);
+
+  auto enter = trace_events.at(0);
+  EXPECT_EQ(get(enter, "ph"), "B");
+  auto args = get(enter, "args");
+  EXPECT_EQ(args.size(), 3);
+  EXPECT_EQ(get(args, "id"), -42);
+  EXPECT_EQ(get(args, "ratio"), 0.25);
+  EXPECT_EQ(get(args, "status"), "ok");
+
+  auto exit = trace_events.at(1);
+  EXPECT_EQ(get(exit, "ph"), "E");
+  EXPECT_EQ(get(exit, "args"), nlohmann::json{});
+}
+
+TEST_F(test_chrome_trace_event_format, discarded_samples_are_marked)
+{
+  auto storage = cxxtrace::ring_queue_unsafe_storage<4, clock_type::sample>{};
+  auto config = cxxtrace::basic_config{ storage, this->clock };
+  for (auto i = 0; i < 6; ++i) {
+    CXXTRACE_INSTANT_WITH_CONFIG(config, "category", "instant");
+  }
+
+  auto parsed =
+    this->write_snapshot_and_parse(storage.take_all_samples(this->clock));
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 5);
+  auto first_kept_event = trace_events.at(0);
+  EXPECT_EQ(get(first_kept_event, "name"), "instant");
+  auto loss = trace_events.at(4);
+  EXPECT_EQ(get(loss, "ph"), "i");
+  EXPECT_EQ(get(loss, "name"), "samples discarded");
+  EXPECT_EQ(get(loss, "s"), "g");
+  EXPECT_EQ(get(loss, "ts"), get(first_kept_event, "ts"));
+  EXPECT_EQ(get(get(loss, "args"), "discarded_records"), 2);
+}
+
+TEST_F(test_chrome_trace_event_format, events_have_matching_phases)
+{
+  auto& config = this->get_cxxtrace_config();
+  CXXTRACE_INSTANT_WITH_CONFIG(config, "category", "instant");
+  CXXTRACE_COUNTER_WITH_CONFIG(
+    config, "category", "counter", cxxtrace::span_argument{ "depth", 3 });
+  CXXTRACE_ASYNC_BEGIN_WITH_CONFIG(config, "category", "async", 0x2a);
+  CXXTRACE_ASYNC_END_WITH_CONFIG(config, "category", "async", 0x2a);
+  {
+    auto span = CXXTRACE_SPAN("category", "span");
+    CXXTRACE_FLOW_START_WITH_CONFIG(config, "category", "flow", 7);
+    CXXTRACE_FLOW_STEP_WITH_CONFIG(config, "category", "flow", 7);
+    CXXTRACE_FLOW_END_WITH_CONFIG(config, "category", "flow", 7);
+  }
+
+  auto parsed = this->write_snapshot_and_parse();
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 9);
+
+  auto instant = trace_events.at(0);
+  EXPECT_EQ(get(instant, "ph"), "i");
+  EXPECT_EQ(get(instant, "name"), "instant");
+  EXPECT_EQ(get(instant, "s"), "t");
+  EXPECT_EQ(get(instant, "id"), nlohmann::json{});
+
+  auto counter = trace_events.at(1);
+  EXPECT_EQ(get(counter, "ph"), "C");
+  EXPECT_EQ(get(get(counter, "args"), "depth"), 3);
+
+  EXPECT_EQ(get(trace_events.at(2), "ph"), "b");
+  EXPECT_EQ(get(trace_events.at(2), "id"), "0x2a");
+  EXPECT_EQ(get(trace_events.at(3), "ph"), "e");
+  EXPECT_EQ(get(trace_events.at(3), "id"), "0x2a");
+
+  EXPECT_EQ(get(trace_events.at(4), "ph"), "B");
+  EXPECT_EQ(get(trace_events.at(5), "ph"), "s");
+  EXPECT_EQ(get(trace_events.at(5), "id"), "0x7");
+  EXPECT_EQ(get(trace_events.at(6), "ph"), "t");
+  EXPECT_EQ(get(trace_events.at(6), "id"), "0x7");
+  EXPECT_EQ(get(trace_events.at(7), "ph"), "f");
+  EXPECT_EQ(get(trace_events.at(7), "id"), "0x7");
+  EXPECT_EQ(get(trace_events.at(7), "bp"), "e");
+  EXPECT_EQ(get(trace_events.at(8), "ph"), "E");
+}
+
+TEST_F(test_chrome_trace_event_format, complete_span_adds_complete_event)
+{
+  this->clock.set_duration_between_samples(std::chrono::nanoseconds{ 1500 });
+  {
+    auto span = CXXTRACE_COMPLETE_SPAN_WITH_CONFIG(
+      this->get_cxxtrace_config(), "category", "span");
+  }
+
+  auto parsed = this->write_snapshot_and_parse();
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 1);
+  auto event = trace_events.at(0);
+  EXPECT_EQ(get(event, "ph"), "X");
+  EXPECT_EQ(get(event, "cat"), "category");
+  EXPECT_EQ(get(event, "name"), "span");
+  EXPECT_EQ(get(event, "dur"), 1.5);
+}
+
+TEST_F(test_chrome_trace_event_format, next_phase_ends_and_begins_spans)
+{
+  this->clock.set_duration_between_samples(std::chrono::nanoseconds{ 1000 });
+  {
+    auto phases =
+      CXXTRACE_PHASES_WITH_CONFIG(this->get_cxxtrace_config(), "category");
+    phases.next("phase 1");
+    phases.next("phase 2");
+  }
+
+  auto parsed = this->write_snapshot_and_parse();
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 4);
+  EXPECT_EQ(get(trace_events.at(0), "ph"), "B");
+  EXPECT_EQ(get(trace_events.at(0), "name"), "phase 1");
+  EXPECT_EQ(get(trace_events.at(1), "ph"), "E");
+  EXPECT_EQ(get(trace_events.at(1), "name"), "phase 1");
+  EXPECT_EQ(get(trace_events.at(2), "ph"), "B");
+  EXPECT_EQ(get(trace_events.at(2), "name"), "phase 2");
+  EXPECT_EQ(get(trace_events.at(1), "ts"), get(trace_events.at(2), "ts"));
+  EXPECT_EQ(get(trace_events.at(3), "ph"), "E");
+  EXPECT_EQ(get(trace_events.at(3), "name"), "phase 2");
+  for (auto& event : trace_events) {
+    EXPECT_EQ(get(event, "cat"), "category");
+  }
+}
+
+TEST_F(test_chrome_trace_event_format,
+       complete_spans_with_thread_cpu_time_include_on_and_off_cpu_time)
+{
+  using cpu_time_clock_type =
+    cxxtrace::thread_cpu_time_clock<cxxtrace::fake_clock,
+                                    fake_cpu_time_reader>;
+  auto cpu_time_clock = cpu_time_clock_type{};
+  cpu_time_clock.clock().set_duration_between_samples(
+    std::chrono::nanoseconds{ 1000 });
+  cpu_time_clock.cpu_time_reader().increment = std::chrono::nanoseconds{ 300 };
+  auto storage = cxxtrace::unbounded_storage<cpu_time_clock_type::sample>{};
+  auto config = cxxtrace::basic_config{ storage, cpu_time_clock };
+
+  {
+    auto span = CXXTRACE_COMPLETE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto parsed =
+    this->write_snapshot_and_parse(storage.take_all_samples(cpu_time_clock));
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 1);
+
+  auto event = trace_events.at(0);
+  EXPECT_EQ(get(event, "ph"), "X");
+  EXPECT_EQ(get(event, "tts"), 0.0);
+  EXPECT_EQ(get(event, "dur"), 1.0);
+  EXPECT_EQ(get(event, "tdur"), 0.3);
+  EXPECT_EQ(get(get(event, "args"), "on_cpu_ns"), 300);
+  EXPECT_EQ(get(get(event, "args"), "off_cpu_ns"), 700);
+}
+
+TEST_F(test_chrome_trace_event_format,
+       span_exit_after_discarded_exit_matches_enter_at_its_depth)
+{
+  using counter_clock_type =
+    cxxtrace::hardware_counter_clock<cxxtrace::fake_clock,
+                                     fake_counter_reader>;
+  auto counter_clock = counter_clock_type{};
+  counter_clock.counter_reader().increment = { 1000, 500, 7 };
+  auto storage = cxxtrace::unbounded_storage<counter_clock_type::sample>{};
+  auto add_sample = [&](cxxtrace::czstring name,
+                        cxxtrace::sample_kind kind,
+                        cxxtrace::detail::recorded_span_depth depth) {
+    auto arguments =
+      cxxtrace::detail::sample_arguments<counter_clock_type::sample>{};
+    arguments.depth = depth;
+    storage.add_sample(
+      cxxtrace::detail::sample_site_local_data{ "category", name, kind },
+      counter_clock.query(),
+      arguments);
+  };
+  add_sample("outer", cxxtrace::sample_kind::enter_span, 0);
+  add_sample("inner", cxxtrace::sample_kind::enter_span, 1);
+  // inner's exit_span sample was discarded.
+  add_sample("outer", cxxtrace::sample_kind::exit_span, 0);
+
+  auto parsed =
+    this->write_snapshot_and_parse(storage.take_all_samples(counter_clock));
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 3);
+  auto outer_exit = trace_events.at(2);
+  EXPECT_EQ(get(outer_exit, "ph"), "E");
+  EXPECT_EQ(get(get(outer_exit, "args"), "cycles"), 2000);
+}
+
+TEST_F(test_chrome_trace_event_format,
+       span_exit_after_discarded_enter_does_not_match_outer_enter)
+{
+  using counter_clock_type =
+    cxxtrace::hardware_counter_clock<cxxtrace::fake_clock,
+                                     fake_counter_reader>;
+  auto counter_clock = counter_clock_type{};
+  counter_clock.counter_reader().increment = { 1000, 500, 7 };
+  auto storage = cxxtrace::unbounded_storage<counter_clock_type::sample>{};
+  auto add_sample = [&](cxxtrace::czstring name,
+                        cxxtrace::sample_kind kind,
+                        cxxtrace::detail::recorded_span_depth depth) {
+    auto arguments =
+      cxxtrace::detail::sample_arguments<counter_clock_type::sample>{};
+    arguments.depth = depth;
+    storage.add_sample(
+      cxxtrace::detail::sample_site_local_data{ "category", name, kind },
+      counter_clock.query(),
+      arguments);
+  };
+  add_sample("outer", cxxtrace::sample_kind::enter_span, 0);
+  // inner's enter_span sample was discarded.
+  add_sample("inner", cxxtrace::sample_kind::exit_span, 1);
+  add_sample("outer", cxxtrace::sample_kind::exit_span, 0);
+
+  auto parsed =
+    this->write_snapshot_and_parse(storage.take_all_samples(counter_clock));
+  auto trace_events = drop_metadata_events(get(parsed, "traceEvents"));
+  ASSERT_EQ(trace_events.size(), 3);
+  auto inner_exit = trace_events.at(1);
+  EXPECT_EQ(get(inner_exit, "ph"), "E");
+  EXPECT_EQ(get(inner_exit, "args"), nlohmann::json{});
+  auto outer_exit = trace_events.at(2);
+  EXPECT_EQ(get(outer_exit, "ph"), "E");
+  EXPECT_EQ(get(get(outer_exit, "args"), "cycles"), 2000);
+}
+
 // TODO(strager): Teach chrome_trace_event_writer to escape strings to avoid
 // these problems. This test documents the current behavior, not the desired
 // behavior.
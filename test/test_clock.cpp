@@ -1,12 +1,15 @@
+#include "clock_support.h"
 #include "cxxtrace_algorithm.h" // IWYU pragma: keep
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstddef>
 #include <cxxtrace/clock.h>
 #include <cxxtrace/clock_extra.h> // IWYU pragma: keep
 #include <cxxtrace/detail/have.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <iostream>
 #include <iterator>
 #include <ratio>
 #include <thread>
@@ -41,15 +44,30 @@ using test_clock_types = ::testing::Types<
 #if CXXTRACE_HAVE_MACH_TIME
   cxxtrace::apple_absolute_time_clock,
   cxxtrace::apple_approximate_time_clock,
+#endif
+#if defined(__x86_64__)
+  cxxtrace::x86_tsc_clock,
 #endif
   cxxtrace::fake_clock,
 #if CXXTRACE_HAVE_CLOCK_GETTIME
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC>,
   cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC>,
 #endif
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_BOOTTIME>,
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>,
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>,
+  cxxtrace::fastest_monotonic_clock,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_BOOTTIME>,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>,
+#endif
+  cxxtrace::compact_posix_gettimeofday_clock,
   cxxtrace::posix_gettimeofday_clock,
   cxxtrace::std_high_resolution_clock,
   cxxtrace::std_steady_clock,
-  cxxtrace::std_system_clock>;
+  cxxtrace::std_system_clock,
+  cxxtrace::ticker_approximate_time_clock>;
 TYPED_TEST_CASE(test_clock, test_clock_types, );
 
 TYPED_TEST(test_clock, clock_samples_are_comparable)
@@ -65,6 +83,27 @@ TYPED_TEST(test_clock, clock_samples_are_comparable)
                                bool>);
 }
 
+TYPED_TEST(test_clock, converting_many_samples_matches_converting_each_sample)
+{
+  using clock_type = typename TestFixture::clock_type;
+
+  if (!clock_is_supported<clock_type>()) {
+    std::cerr << "warning: this clock is not supported. skipping test...\n";
+    return;
+  }
+
+  auto clock = clock_type{};
+  auto samples = sample_clock_n(clock, 1000);
+  auto time_points = std::vector<cxxtrace::time_point>(
+    samples.size(), cxxtrace::time_point{ cxxtrace::uninitialized });
+  cxxtrace::detail::make_time_points(
+    clock, samples.data(), time_points.data(), samples.size());
+  for (auto i = std::size_t{ 0 }; i < samples.size(); ++i) {
+    EXPECT_EQ(time_points[i], clock.make_time_point(samples[i]))
+      << "i = " << i;
+  }
+}
+
 template<class Clock>
 class test_strictly_increasing_clock : public testing::Test
 {
@@ -115,12 +154,26 @@ using test_non_decreasing_clock_types = ::testing::Types<
 #if CXXTRACE_HAVE_MACH_TIME
   cxxtrace::apple_absolute_time_clock,
   cxxtrace::apple_approximate_time_clock,
+#endif
+#if defined(__x86_64__)
+  cxxtrace::x86_tsc_clock,
 #endif
   cxxtrace::fake_clock,
 #if CXXTRACE_HAVE_CLOCK_GETTIME
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC>,
   cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC>,
 #endif
-  cxxtrace::std_steady_clock>;
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_BOOTTIME>,
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>,
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>,
+  cxxtrace::fastest_monotonic_clock,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_BOOTTIME>,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>,
+#endif
+  cxxtrace::std_steady_clock,
+  cxxtrace::ticker_approximate_time_clock>;
 TYPED_TEST_CASE(test_non_decreasing_clock, test_non_decreasing_clock_types, );
 
 TYPED_TEST(test_non_decreasing_clock, clock_is_non_decreasing)
@@ -130,6 +183,11 @@ TYPED_TEST(test_non_decreasing_clock, clock_is_non_decreasing)
 
   static_assert(clock_type::traits.is_non_decreasing_per_thread());
 
+  if (!clock_is_supported<clock_type>()) {
+    std::cerr << "warning: this clock is not supported. skipping test...\n";
+    return;
+  }
+
   auto sample_count = 64 * 1024;
   auto iteration_count = 10;
 
@@ -147,6 +205,27 @@ TYPED_TEST(test_non_decreasing_clock, clock_is_non_decreasing)
   }
 }
 
+TYPED_TEST(test_non_decreasing_clock,
+           serialized_queries_are_ordered_with_other_queries)
+{
+  using clock_type = typename TestFixture::clock_type;
+
+  if (!clock_is_supported<clock_type>()) {
+    std::cerr << "warning: this clock is not supported. skipping test...\n";
+    return;
+  }
+
+  auto clock = clock_type{};
+  for (auto i = 0; i < 1000; ++i) {
+    auto before = clock.make_time_point(clock.query());
+    auto serialized =
+      clock.make_time_point(cxxtrace::detail::query_serialized(clock));
+    auto after = clock.make_time_point(clock.query());
+    EXPECT_LE(before, serialized);
+    EXPECT_LE(serialized, after);
+  }
+}
+
 template<class Clock>
 class test_real_clock : public testing::Test
 {
@@ -159,13 +238,28 @@ using test_real_clock_types = ::testing::Types<
   cxxtrace::apple_absolute_time_clock,
   cxxtrace::apple_approximate_time_clock,
 #endif
+#if defined(__x86_64__)
+  cxxtrace::x86_tsc_clock,
+#endif
 #if CXXTRACE_HAVE_CLOCK_GETTIME
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC>,
   cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC>,
 #endif
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_BOOTTIME>,
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>,
+  cxxtrace::compact_posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>,
+  cxxtrace::fastest_monotonic_clock,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_BOOTTIME>,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC_COARSE>,
+  cxxtrace::posix_clock_gettime_clock<CLOCK_MONOTONIC_RAW>,
+#endif
+  cxxtrace::compact_posix_gettimeofday_clock,
   cxxtrace::posix_gettimeofday_clock,
   cxxtrace::std_high_resolution_clock,
   cxxtrace::std_steady_clock,
-  cxxtrace::std_system_clock>;
+  cxxtrace::std_system_clock,
+  cxxtrace::ticker_approximate_time_clock>;
 TYPED_TEST_CASE(test_real_clock, test_real_clock_types, );
 
 TYPED_TEST(test_real_clock, clock_advances_within_decisecond_of_system_clock)
@@ -177,6 +271,11 @@ TYPED_TEST(test_real_clock, clock_advances_within_decisecond_of_system_clock)
   static constexpr auto iteration_count = 5;
   static constexpr auto tolerated_mismatches = 1;
 
+  if (!clock_is_supported<clock_type>()) {
+    std::cerr << "warning: this clock is not supported. skipping test...\n";
+    return;
+  }
+
   auto test_clock = clock_type{};
 
   auto test_clock_samples = std::vector<nanoseconds>{};
@@ -251,6 +350,95 @@ TEST(test_fake_clock,
               ElementsAre(813ns, 813ns + 1098ns, 813ns + 1098ns + 1098ns));
 }
 
+TEST(test_fake_clock, wall_clock_anchor_is_midpoint_of_bracketing_queries)
+{
+  auto clock = cxxtrace::fake_clock{};
+  clock.set_duration_between_samples(10ns);
+  clock.set_next_time_point(100ns);
+  auto wall_time_before = std::chrono::system_clock::now();
+  auto anchor = cxxtrace::measure_wall_clock_anchor(clock);
+  auto wall_time_after = std::chrono::system_clock::now();
+
+  EXPECT_EQ(anchor.clock_time, cxxtrace::time_point{ 105ns });
+  EXPECT_GE(anchor.wall_time, wall_time_before);
+  EXPECT_LE(anchor.wall_time, wall_time_after);
+  EXPECT_EQ(anchor.wall_time_of(cxxtrace::time_point{ 105ns + 3ms }),
+            anchor.wall_time + 3ms);
+}
+
+TEST(test_fake_clock, wall_clock_anchor_queries_clock_twice_per_bracket)
+{
+  auto clock = cxxtrace::fake_clock{};
+  clock.set_duration_between_samples(10ns);
+  clock.set_next_time_point(100ns);
+  cxxtrace::measure_wall_clock_anchor(clock, 8);
+  EXPECT_EQ(clock.make_time_point(clock.query()),
+            cxxtrace::time_point{ 100ns + 16 * 10ns });
+
+  clock.set_next_time_point(1000ns);
+  cxxtrace::measure_wall_clock_anchor(clock);
+  EXPECT_EQ(clock.make_time_point(clock.query()),
+            cxxtrace::time_point{
+              1000ns +
+              2 * cxxtrace::default_wall_clock_anchor_bracket_count * 10ns });
+}
+
+TEST(test_compact_clock, samples_are_64_bits)
+{
+  static_assert(sizeof(cxxtrace::compact_posix_gettimeofday_clock::sample) ==
+                8);
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+  static_assert(sizeof(cxxtrace::compact_posix_clock_gettime_clock<
+                       CLOCK_MONOTONIC>::sample) == 8);
+#endif
+}
+
+TEST(test_ticker_approximate_time_clock, clocks_share_one_published_time)
+{
+  auto clock_1 = cxxtrace::ticker_approximate_time_clock{ 1h };
+  auto clock_2 = cxxtrace::ticker_approximate_time_clock{ 1h };
+  // The hour-long period keeps the ticker from publishing between queries.
+  EXPECT_EQ(clock_1.query(), clock_2.query());
+}
+
+TEST(test_ticker_approximate_time_clock,
+     shortest_period_of_live_clocks_drives_ticker)
+{
+  auto slow_clock = cxxtrace::ticker_approximate_time_clock{ 1h };
+  auto initial_sample = slow_clock.query();
+  {
+    auto fast_clock = cxxtrace::ticker_approximate_time_clock{ 1ms };
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (slow_clock.query() == initial_sample &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_GT(slow_clock.query(), initial_sample);
+  }
+}
+
+TEST(test_ticker_approximate_time_clock, ticker_restarts_for_new_clocks)
+{
+  auto sample_before = cxxtrace::ticker_approximate_time_clock{}.query();
+  std::this_thread::sleep_for(5ms);
+  auto clock = cxxtrace::ticker_approximate_time_clock{};
+  EXPECT_GT(clock.query(), sample_before);
+}
+
+#if CXXTRACE_HAVE_LINUX_CLOCK_GETTIME_CLOCKS
+TEST(test_fastest_monotonic_clock, every_instance_chooses_the_same_clock)
+{
+  auto clock_1 = cxxtrace::fastest_monotonic_clock{};
+  auto clock_2 = cxxtrace::fastest_monotonic_clock{};
+  EXPECT_EQ(clock_1.clock_id(), clock_2.clock_id());
+  EXPECT_THAT(clock_1.clock_id(),
+              testing::AnyOf(CLOCK_BOOTTIME,
+                             CLOCK_MONOTONIC,
+                             CLOCK_MONOTONIC_COARSE,
+                             CLOCK_MONOTONIC_RAW));
+}
+#endif
+
 namespace {
 template<class Clock>
 auto
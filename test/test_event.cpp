@@ -0,0 +1,114 @@
+#include "test_span.h"
+#include <cstdint>
+#include <cxxtrace/event.h>
+#include <cxxtrace/sample.h>
+#include <cxxtrace/snapshot.h>
+#include <cxxtrace/span.h>
+#include <cxxtrace/span_argument.h>
+#include <gtest/gtest.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+#define CXXTRACE_CONFIG this->get_cxxtrace_config()
+
+namespace cxxtrace_test {
+template<class Storage>
+class test_event : public test_span<Storage>
+{};
+TYPED_TEST_CASE(test_event, test_span_types, );
+
+TYPED_TEST(test_event, instant_adds_one_sample)
+{
+  CXXTRACE_INSTANT_WITH_CONFIG(CXXTRACE_CONFIG, "category", "instant");
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 1);
+  auto sample = samples.at(0);
+  EXPECT_STREQ(sample.category(), "category");
+  EXPECT_STREQ(sample.name(), "instant");
+  EXPECT_EQ(sample.kind(), cxxtrace::sample_kind::instant);
+  EXPECT_EQ(sample.event_id(), std::nullopt);
+  EXPECT_TRUE(sample.arguments().empty());
+}
+
+TYPED_TEST(test_event, counter_records_values_as_arguments)
+{
+  CXXTRACE_COUNTER_WITH_CONFIG(CXXTRACE_CONFIG,
+                               "category",
+                               "queue",
+                               cxxtrace::span_argument{ "depth", 3 },
+                               cxxtrace::span_argument{ "load", 0.75 });
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 1);
+  auto sample = samples.at(0);
+  EXPECT_STREQ(sample.name(), "queue");
+  EXPECT_EQ(sample.kind(), cxxtrace::sample_kind::counter);
+  EXPECT_EQ(sample.arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "depth", std::int64_t{ 3 } },
+              { "load", 0.75 },
+            }));
+}
+
+TYPED_TEST(test_event, async_and_flow_samples_have_event_ids)
+{
+  using cxxtrace::sample_kind;
+
+  CXXTRACE_ASYNC_BEGIN_WITH_CONFIG(CXXTRACE_CONFIG, "category", "async", 1);
+  CXXTRACE_FLOW_START_WITH_CONFIG(CXXTRACE_CONFIG, "category", "flow", 2);
+  CXXTRACE_FLOW_STEP_WITH_CONFIG(CXXTRACE_CONFIG, "category", "flow", 2);
+  CXXTRACE_FLOW_END_WITH_CONFIG(CXXTRACE_CONFIG,
+                                "category",
+                                "flow",
+                                2,
+                                cxxtrace::span_argument{ "result", "ok" });
+  CXXTRACE_ASYNC_END_WITH_CONFIG(
+    CXXTRACE_CONFIG, "category", "async", 0xffffffffffffffffULL);
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 5);
+  EXPECT_EQ(samples.at(0).kind(), sample_kind::async_begin);
+  EXPECT_EQ(samples.at(0).event_id(), 1);
+  EXPECT_EQ(samples.at(1).kind(), sample_kind::flow_start);
+  EXPECT_EQ(samples.at(1).event_id(), 2);
+  EXPECT_EQ(samples.at(2).kind(), sample_kind::flow_step);
+  EXPECT_EQ(samples.at(2).event_id(), 2);
+  EXPECT_EQ(samples.at(3).kind(), sample_kind::flow_end);
+  EXPECT_EQ(samples.at(3).event_id(), 2);
+  EXPECT_EQ(samples.at(3).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "result", std::string{ "ok" } },
+            }));
+  EXPECT_EQ(samples.at(4).kind(), sample_kind::async_end);
+  EXPECT_EQ(samples.at(4).event_id(), 0xffffffffffffffffULL);
+}
+
+TYPED_TEST(test_event, events_are_ordered_with_spans)
+{
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(CXXTRACE_CONFIG, "category", "span");
+    CXXTRACE_INSTANT_WITH_CONFIG(CXXTRACE_CONFIG, "category", "instant");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 3);
+  EXPECT_EQ(samples.at(0).kind(), cxxtrace::sample_kind::enter_span);
+  EXPECT_EQ(samples.at(1).kind(), cxxtrace::sample_kind::instant);
+  EXPECT_EQ(samples.at(1).event_id(), std::nullopt);
+  EXPECT_EQ(samples.at(2).kind(), cxxtrace::sample_kind::exit_span);
+}
+
+TYPED_TEST(test_event, events_record_depth_of_enclosing_spans)
+{
+  CXXTRACE_INSTANT_WITH_CONFIG(CXXTRACE_CONFIG, "category", "outside");
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(CXXTRACE_CONFIG, "category", "span");
+    CXXTRACE_INSTANT_WITH_CONFIG(CXXTRACE_CONFIG, "category", "inside");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_STREQ(samples.at(0).name(), "outside");
+  EXPECT_EQ(samples.at(0).depth(), 0);
+  EXPECT_STREQ(samples.at(2).name(), "inside");
+  EXPECT_EQ(samples.at(2).depth(), 1);
+}
+}
@@ -0,0 +1,116 @@
+#include "fake_counter_reader.h"
+#include <cstdint>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/config.h>
+#include <cxxtrace/detail/have.h>
+#include <cxxtrace/hardware_counters.h>
+#include <cxxtrace/snapshot.h>
+#include <cxxtrace/span.h>
+#include <cxxtrace/unbounded_storage.h>
+#include <gtest/gtest.h>
+#include <iostream>
+
+using namespace std::chrono_literals;
+
+namespace cxxtrace_test {
+namespace {
+using fake_hardware_counter_clock =
+  cxxtrace::hardware_counter_clock<cxxtrace::fake_clock, fake_counter_reader>;
+}
+
+TEST(test_hardware_counter_clock, samples_include_time_and_counters)
+{
+  auto clock = fake_hardware_counter_clock{};
+  clock.clock().set_next_time_point(10ns);
+  clock.counter_reader().next_counters = { 100, 200, 3 };
+
+  auto sample = clock.query();
+  EXPECT_EQ(clock.make_time_point(sample), cxxtrace::time_point{ 10ns });
+  EXPECT_EQ(sample.counters.cycles, 100);
+  EXPECT_EQ(sample.counters.instructions, 200);
+  EXPECT_EQ(sample.counters.llc_misses, 3);
+}
+
+TEST(test_hardware_counter_clock, snapshot_samples_include_counters)
+{
+  auto clock = fake_hardware_counter_clock{};
+  clock.counter_reader().increment = { 1000, 500, 7 };
+  auto storage =
+    cxxtrace::unbounded_storage<fake_hardware_counter_clock::sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto snapshot = storage.take_all_samples(clock);
+  ASSERT_EQ(snapshot.size(), 2);
+  auto enter_counters = snapshot.at(0).counters();
+  auto exit_counters = snapshot.at(1).counters();
+  ASSERT_TRUE(enter_counters.has_value());
+  ASSERT_TRUE(exit_counters.has_value());
+  auto deltas = *exit_counters - *enter_counters;
+  EXPECT_EQ(deltas.cycles, 1000);
+  EXPECT_EQ(deltas.instructions, 500);
+  EXPECT_EQ(deltas.llc_misses, 7);
+}
+
+TEST(test_hardware_counter_clock, snapshot_samples_omit_unavailable_counters)
+{
+  auto clock = fake_hardware_counter_clock{};
+  auto& counter_reader = clock.counter_reader();
+  counter_reader.next_counters = cxxtrace::unavailable_hardware_counters;
+  counter_reader.increment = { 0, 0, 0 };
+  auto storage =
+    cxxtrace::unbounded_storage<fake_hardware_counter_clock::sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto snapshot = storage.take_all_samples(clock);
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_FALSE(snapshot.at(0).counters().has_value());
+  EXPECT_FALSE(snapshot.at(1).counters().has_value());
+}
+
+TEST(test_hardware_counter_clock, other_clocks_do_not_record_counters)
+{
+  auto clock = cxxtrace::fake_clock{};
+  auto storage = cxxtrace::unbounded_storage<cxxtrace::fake_clock::sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto snapshot = storage.take_all_samples(clock);
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_FALSE(snapshot.at(0).counters().has_value());
+  EXPECT_FALSE(snapshot.at(1).counters().has_value());
+}
+
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+TEST(test_perf_event_counter_reader, instructions_increase_while_running)
+{
+  if (!cxxtrace::perf_event_counter_reader::supported()) {
+    std::cerr << "warning: hardware counters are not supported. skipping "
+                 "test...\n";
+    return;
+  }
+
+  auto reader = cxxtrace::perf_event_counter_reader{};
+  auto before = reader.read();
+  volatile auto sum = std::uint64_t{ 0 };
+  for (auto i = 0; i < 100'000; ++i) {
+    sum = sum + i;
+  }
+  auto after = reader.read();
+
+  EXPECT_GE(after.cycles, before.cycles);
+  EXPECT_GT(after.instructions - before.instructions, 100'000);
+  EXPECT_GE(after.llc_misses, before.llc_misses);
+}
+#endif
+}
@@ -0,0 +1,85 @@
+#include <cstddef>
+#include <cxxtrace/interned_string.h>
+#include <cxxtrace/string.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cxxtrace_test {
+TEST(test_interned_string, interned_string_is_a_copy)
+{
+  auto string = std::string{ "hello world" };
+  auto interned = cxxtrace::intern_string(string);
+  EXPECT_NE(interned, string.data());
+  string.assign("goodbye");
+  EXPECT_STREQ(interned, "hello world");
+}
+
+TEST(test_interned_string, equal_strings_are_interned_to_same_pointer)
+{
+  auto first = cxxtrace::intern_string(std::string{ "equal" });
+  auto second = cxxtrace::intern_string(std::string{ "equal" });
+  EXPECT_EQ(first, second);
+}
+
+TEST(test_interned_string, different_strings_are_interned_to_different_pointers)
+{
+  auto hello = cxxtrace::intern_string("hello");
+  auto world = cxxtrace::intern_string("world");
+  auto empty = cxxtrace::intern_string("");
+  EXPECT_NE(hello, world);
+  EXPECT_NE(hello, empty);
+  EXPECT_STREQ(hello, "hello");
+  EXPECT_STREQ(world, "world");
+  EXPECT_STREQ(empty, "");
+}
+
+TEST(test_interned_string, strings_with_embedded_nulls_are_distinct)
+{
+  using namespace std::string_view_literals;
+  auto short_string = cxxtrace::intern_string("a"sv);
+  auto long_string = cxxtrace::intern_string("a\0b"sv);
+  EXPECT_NE(short_string, long_string);
+}
+
+TEST(test_interned_string, many_strings_are_interned_consistently)
+{
+  // Intern more strings than fit in one hash table or in a thread's cache.
+  auto string_count = 10000;
+  auto interned = std::vector<cxxtrace::czstring>{};
+  for (auto i = 0; i < string_count; ++i) {
+    interned.emplace_back(
+      cxxtrace::intern_string("string " + std::to_string(i)));
+  }
+  for (auto i = 0; i < string_count; ++i) {
+    auto string = "string " + std::to_string(i);
+    EXPECT_EQ(cxxtrace::intern_string(string), interned[i]) << string;
+    EXPECT_EQ(interned[i], string);
+  }
+}
+
+TEST(test_interned_string, threads_interning_same_strings_agree)
+{
+  auto string_count = 2000;
+  auto thread_count = 4;
+  auto interned = std::vector<std::vector<cxxtrace::czstring>>(thread_count);
+  auto threads = std::vector<std::thread>{};
+  for (auto thread_index = 0; thread_index < thread_count; ++thread_index) {
+    threads.emplace_back([&interned, string_count, thread_index] {
+      for (auto i = 0; i < string_count; ++i) {
+        interned[thread_index].emplace_back(cxxtrace::intern_string(
+          "thread string " + std::to_string(i)));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto thread_index = 1; thread_index < thread_count; ++thread_index) {
+    EXPECT_EQ(interned[thread_index], interned[0]);
+  }
+}
+}
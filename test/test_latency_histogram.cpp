@@ -0,0 +1,117 @@
+#include "latency_histogram.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <limits>
+
+namespace cxxtrace_test {
+TEST(test_latency_histogram, empty_histogram_has_zero_percentiles)
+{
+  auto histogram = latency_histogram{};
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.max(), 0);
+  EXPECT_EQ(histogram.percentile(50.0), 0);
+  EXPECT_EQ(histogram.percentile(100.0), 0);
+}
+
+TEST(test_latency_histogram, small_values_are_recorded_exactly)
+{
+  auto histogram = latency_histogram{};
+  for (auto value = 0; value < 64; ++value) {
+    histogram.record(value);
+  }
+  EXPECT_EQ(histogram.count(), 64);
+  EXPECT_EQ(histogram.max(), 63);
+  EXPECT_EQ(histogram.percentile(0.0), 0);
+  EXPECT_EQ(histogram.percentile(50.0), 31);
+  EXPECT_EQ(histogram.percentile(100.0), 63);
+}
+
+TEST(test_latency_histogram, percentile_of_single_value_is_that_value)
+{
+  for (auto value : { std::uint64_t{ 1 },
+                      std::uint64_t{ 1000 },
+                      std::uint64_t{ 123'456'789 },
+                      std::numeric_limits<std::uint64_t>::max() }) {
+    auto histogram = latency_histogram{};
+    histogram.record(value);
+    EXPECT_EQ(histogram.percentile(50.0), value);
+    EXPECT_EQ(histogram.percentile(99.9), value);
+    EXPECT_EQ(histogram.max(), value);
+  }
+}
+
+TEST(test_latency_histogram, largest_value_does_not_disturb_other_buckets)
+{
+  auto histogram = latency_histogram{};
+  histogram.record(std::numeric_limits<std::uint64_t>::max());
+  histogram.record(std::numeric_limits<std::uint64_t>::max() / 2 + 1);
+  for (auto i = 0; i < 8; ++i) {
+    histogram.record(10);
+  }
+
+  EXPECT_EQ(histogram.count(), 10);
+  EXPECT_EQ(histogram.max(), std::numeric_limits<std::uint64_t>::max());
+  EXPECT_EQ(histogram.percentile(50.0), 10);
+  EXPECT_EQ(histogram.percentile(80.0), 10);
+  EXPECT_GE(histogram.percentile(90.0),
+            std::numeric_limits<std::uint64_t>::max() / 2 + 1);
+  EXPECT_EQ(histogram.percentile(100.0),
+            std::numeric_limits<std::uint64_t>::max());
+}
+
+TEST(test_latency_histogram, large_values_have_small_relative_error)
+{
+  auto histogram = latency_histogram{};
+  for (auto value = std::uint64_t{ 1 }; value <= 100'000; ++value) {
+    histogram.record(value);
+  }
+
+  auto expect_near_upper_bound = [&](double percentile,
+                                     std::uint64_t expected) {
+    auto actual = histogram.percentile(percentile);
+    EXPECT_GE(actual, expected) << "percentile = " << percentile;
+    EXPECT_LE(actual, expected + expected / 32)
+      << "percentile = " << percentile;
+  };
+  expect_near_upper_bound(50.0, 50'000);
+  expect_near_upper_bound(99.0, 99'000);
+  expect_near_upper_bound(99.9, 99'900);
+  EXPECT_EQ(histogram.percentile(100.0), 100'000);
+}
+
+TEST(test_latency_histogram, tail_percentiles_find_rare_outliers)
+{
+  auto histogram = latency_histogram{};
+  for (auto i = 0; i < 998; ++i) {
+    histogram.record(20);
+  }
+  histogram.record(5'000);
+  histogram.record(90'000);
+
+  EXPECT_EQ(histogram.percentile(50.0), 20);
+  EXPECT_EQ(histogram.percentile(99.0), 20);
+  EXPECT_GE(histogram.percentile(99.9), 5'000);
+  EXPECT_LT(histogram.percentile(99.9), 90'000);
+  EXPECT_EQ(histogram.max(), 90'000);
+}
+
+TEST(test_latency_histogram, merge_combines_counts_and_max)
+{
+  auto a = latency_histogram{};
+  auto b = latency_histogram{};
+  a.record(10);
+  a.record(10);
+  b.record(30);
+  b.record(40);
+
+  a.merge(b);
+  EXPECT_EQ(a.count(), 4);
+  EXPECT_EQ(a.max(), 40);
+  EXPECT_EQ(a.percentile(50.0), 10);
+  EXPECT_EQ(a.percentile(75.0), 30);
+
+  a.reset();
+  EXPECT_EQ(a.count(), 0);
+  EXPECT_EQ(a.max(), 0);
+}
+}
@@ -3,16 +3,20 @@
 #include "reference_ring_queue.h"
 #include "ring_queue_wrapper.h"
 #include <cstddef> // IWYU pragma: keep
+#include <cstdint>
 #include <cxxtrace/detail/mpsc_ring_queue.h>
 #include <cxxtrace/detail/real_synchronization.h>
 #include <cxxtrace/detail/ring_queue.h>
 #include <cxxtrace/detail/spsc_ring_queue.h>
+#include <cxxtrace/dynamic_capacity.h>
+#include <cxxtrace/ring_queue_overflow_policy.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <initializer_list>
 #include <limits>
 #include <ostream>
 #include <signal.h>
+#include <type_traits>
 #include <vector>
 // IWYU pragma: no_include <algorithm>
 
@@ -45,6 +49,29 @@ template class ring_queue<point, 1024, std::size_t>;
 template class spsc_ring_queue<int, 1, int>;
 template class spsc_ring_queue<char, 1, signed char>;
 template class spsc_ring_queue<point, 1024, std::size_t>;
+
+template class mpsc_ring_queue<int, dynamic_capacity, int>;
+template class ring_queue<int, dynamic_capacity, int>;
+template class spsc_ring_queue<int, dynamic_capacity, int>;
+
+template class mpsc_ring_queue<int,
+                               1024,
+                               int,
+                               real_synchronization,
+                               ring_queue_overflow_policy::drop_newest>;
+template class spsc_ring_queue<int,
+                               1024,
+                               int,
+                               real_synchronization,
+                               ring_queue_overflow_policy::drop_newest>;
+
+// Writers should be able to push to a queue with the default index type
+// without overflowing the index.
+static_assert(
+  std::is_same_v<mpsc_ring_queue<int, 1>::size_type, std::uint64_t>);
+static_assert(std::is_same_v<ring_queue<int, 1>::size_type, std::uint64_t>);
+static_assert(
+  std::is_same_v<spsc_ring_queue<int, 1>::size_type, std::uint64_t>);
 }
 }
 
@@ -201,6 +228,47 @@ TYPED_TEST(test_ring_queue, overflow_causes_pop_to_return_only_newest_data)
   EXPECT_THAT(items, ElementsAre(20, 30, 40, 50));
 }
 
+TYPED_TEST(test_ring_queue, dynamic_capacity_is_rounded_up_to_power_of_two)
+{
+  using cxxtrace::dynamic_capacity;
+  EXPECT_EQ((RING_QUEUE<int, dynamic_capacity>{ 1 }.queue.get_capacity()), 1);
+  EXPECT_EQ((RING_QUEUE<int, dynamic_capacity>{ 5 }.queue.get_capacity()), 8);
+  EXPECT_EQ((RING_QUEUE<int, dynamic_capacity>{ 64 }.queue.get_capacity()),
+            64);
+}
+
+TYPED_TEST(test_ring_queue,
+           overflow_of_dynamic_capacity_queue_keeps_only_newest_data)
+{
+  auto queue = RING_QUEUE<int, cxxtrace::dynamic_capacity>{ 3 };
+  for (auto value : { 10, 20, 30, 40, 50, 60 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+
+  auto items = pop_all(queue);
+  EXPECT_THAT(items, ElementsAre(30, 40, 50, 60));
+}
+
+TYPED_TEST(test_ring_queue,
+           bulk_pushing_at_end_of_dynamic_capacity_ring_preserves_all_items)
+{
+  auto queue = RING_QUEUE<int, cxxtrace::dynamic_capacity>{ 8 };
+  queue.push(6, [](auto) noexcept->void{});
+  pop_all(queue);
+
+  queue.push(
+    4, [](auto data) noexcept->void {
+      data.set(0, 10);
+      data.set(1, 20);
+      data.set(2, 30);
+      data.set(3, 40);
+    });
+
+  auto written_values = pop_all(queue);
+  EXPECT_THAT(written_values, ElementsAre(10, 20, 30, 40));
+}
+
 template<class RingQueue>
 class test_ring_queue_against_reference : public testing::Test
 {
@@ -288,6 +356,52 @@ TYPED_TEST(test_ring_queue, overflowing_size_type_is_not_supported_yet)
     "Writer overflowed size_type");
 }
 
+TYPED_TEST(test_ring_queue, pop_reports_no_discarded_items_without_overflow)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  for (auto value : { 10, 20, 30, 40 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  EXPECT_THAT(items, SizeIs(4));
+}
+
+TYPED_TEST(test_ring_queue, pop_reports_items_discarded_by_overflow)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  for (auto value : { 10, 20, 30, 40, 50, 60 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 2);
+  EXPECT_THAT(items, ElementsAre(30, 40, 50, 60));
+}
+
+TYPED_TEST(test_ring_queue, pop_reports_items_discarded_since_previous_pop)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  auto push_values = [&](int count) {
+    for (auto i = 0; i < count; ++i) {
+      queue.push(
+        1, [i](auto data) noexcept->void { data.set(0, i); });
+    }
+  };
+  auto items = std::vector<int>{};
+
+  push_values(5);
+  EXPECT_EQ(queue.pop_all_into(items), 1);
+  push_values(3);
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  push_values(7);
+  EXPECT_EQ(queue.pop_all_into(items), 3);
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+}
+
 TYPED_TEST(test_ring_queue, reusing_queue_sink_keeps_all_items)
 {
   auto queue = RING_QUEUE<int, 64>{};
@@ -307,6 +421,205 @@ TYPED_TEST(test_ring_queue, reusing_queue_sink_keeps_all_items)
   ASSERT_THAT(items, ElementsAre(100, 200, 300));
 }
 
+template<class RingQueueFactory>
+class test_drop_newest_ring_queue : public test_ring_queue<RingQueueFactory>
+{};
+
+template<template<class T,
+                  std::size_t Capacity,
+                  class Index,
+                  class Sync,
+                  cxxtrace::ring_queue_overflow_policy Overflow>
+         class RingQueue>
+struct drop_newest_ring_queue_factory
+{
+  template<class T, std::size_t Capacity, class Index>
+  using ring_queue = ring_queue_wrapper<
+    RingQueue<T,
+              Capacity,
+              Index,
+              cxxtrace::detail::real_synchronization,
+              cxxtrace::ring_queue_overflow_policy::drop_newest>>;
+};
+
+using test_drop_newest_ring_queue_types = ::testing::Types<
+  drop_newest_ring_queue_factory<cxxtrace::detail::mpsc_ring_queue>,
+  drop_newest_ring_queue_factory<cxxtrace::detail::spsc_ring_queue>>;
+TYPED_TEST_CASE(test_drop_newest_ring_queue,
+                test_drop_newest_ring_queue_types, );
+
+TYPED_TEST(test_drop_newest_ring_queue, overflow_keeps_oldest_items)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  for (auto value : { 10, 20, 30, 40, 50, 60 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 2);
+  EXPECT_THAT(items, ElementsAre(10, 20, 30, 40));
+}
+
+TYPED_TEST(test_drop_newest_ring_queue, dropped_push_does_not_call_writer)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  queue.push(3, [](auto) noexcept->void{});
+  queue.push(1, [](auto) noexcept->void{});
+
+  auto called_writer = false;
+  queue.push(
+    1, [&called_writer](auto) noexcept->void { called_writer = true; });
+  EXPECT_FALSE(called_writer);
+}
+
+TYPED_TEST(test_drop_newest_ring_queue, popping_makes_room_for_new_items)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  for (auto value : { 10, 20, 30, 40 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+  pop_all(queue);
+
+  for (auto value : { 50, 60, 70, 80 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  EXPECT_THAT(items, ElementsAre(50, 60, 70, 80));
+}
+
+TYPED_TEST(test_drop_newest_ring_queue,
+           bulk_push_which_does_not_fit_is_dropped_entirely)
+{
+  auto queue = RING_QUEUE<int, 8>{};
+  queue.push(6, [](auto) noexcept->void{});
+  queue.push(
+    4, [](auto data) noexcept->void {
+      data.set(0, 10);
+      data.set(1, 20);
+      data.set(2, 30);
+      data.set(3, 40);
+    });
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 4);
+  EXPECT_THAT(items, SizeIs(6));
+
+  queue.push(
+    4, [](auto data) noexcept->void {
+      data.set(0, 10);
+      data.set(1, 20);
+      data.set(2, 30);
+      data.set(3, 40);
+    });
+  items.clear();
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  EXPECT_THAT(items, ElementsAre(10, 20, 30, 40));
+}
+
+TYPED_TEST(test_drop_newest_ring_queue, reset_forgets_dropped_items)
+{
+  auto queue = RING_QUEUE<int, 4>{};
+  queue.push(3, [](auto) noexcept->void{});
+  queue.push(3, [](auto) noexcept->void{});
+  queue.reset();
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  EXPECT_THAT(items, IsEmpty());
+}
+
+TEST(test_mpsc_ring_queue,
+     item_dropped_by_writer_lapping_slow_writer_does_not_stall_reader)
+{
+  using ring_queue =
+    ring_queue_wrapper<cxxtrace::detail::mpsc_ring_queue<int, 4>>;
+  auto queue = ring_queue{};
+  queue.push(
+    1, [&queue](auto data) noexcept->void {
+      // Lap this push while it is still writing. The push of 50 reuses this
+      // push's slot, so 50 is dropped.
+      for (auto value : { 20, 30, 40, 50 }) {
+        queue.push(
+          1, [value](auto data) noexcept->void { data.set(0, value); });
+      }
+      data.set(0, 10);
+    });
+  queue.push(
+    1, [](auto data) noexcept->void { data.set(0, 60); });
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 3);
+  EXPECT_THAT(items, ElementsAre(30, 40, 60));
+}
+
+TEST(test_mpsc_ring_queue,
+     reader_steps_past_dropped_item_while_slow_writer_is_writing)
+{
+  using ring_queue =
+    ring_queue_wrapper<cxxtrace::detail::mpsc_ring_queue<int, 4>>;
+  auto queue = ring_queue{};
+  auto items = std::vector<int>{};
+  queue.push(
+    1, [&](auto data) noexcept->void {
+      for (auto value : { 20, 30, 40, 50 }) {
+        queue.push(
+          1, [value](auto data) noexcept->void { data.set(0, value); });
+      }
+      EXPECT_EQ(queue.pop_all_into(items), 2);
+      EXPECT_THAT(items, ElementsAre(20, 30, 40));
+      data.set(0, 10);
+    });
+
+  items.clear();
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  EXPECT_THAT(items, IsEmpty());
+}
+
+TEST(test_mpsc_ring_queue,
+     push_which_fails_to_claim_any_slot_drops_every_item)
+{
+  using ring_queue =
+    ring_queue_wrapper<cxxtrace::detail::mpsc_ring_queue<int, 4>>;
+  auto queue = ring_queue{};
+  auto wrote_partial_push = false;
+  queue.push(
+    1, [&](auto data) noexcept->void {
+      for (auto value : { 20, 30, 40 }) {
+        queue.push(
+          1, [value](auto data) noexcept->void { data.set(0, value); });
+      }
+      // This push's first slot is still being written, but its second slot is
+      // free. Neither item should be written.
+      queue.push(
+        2, [&](auto data) noexcept->void {
+          wrote_partial_push = true;
+          data.set(0, 50);
+          data.set(1, 51);
+        });
+      data.set(0, 10);
+    });
+  EXPECT_FALSE(wrote_partial_push);
+  queue.push(
+    1, [](auto data) noexcept->void { data.set(0, 60); });
+
+  auto items = std::vector<int>{};
+  EXPECT_EQ(queue.pop_all_into(items), 5);
+  EXPECT_THAT(items, ElementsAre(40, 60));
+
+  // The dropped push's claimed slot can be claimed again.
+  for (auto value : { 70, 80, 90 }) {
+    queue.push(
+      1, [value](auto data) noexcept->void { data.set(0, value); });
+  }
+  items.clear();
+  EXPECT_EQ(queue.pop_all_into(items), 0);
+  EXPECT_THAT(items, ElementsAre(70, 80, 90));
+}
+
 namespace {
 template<class RingQueue>
 auto
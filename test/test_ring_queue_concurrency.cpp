@@ -37,26 +37,19 @@ assert_items_are_sequential(const std::experimental::pmr::vector<int>& items)
   -> void;
 }
 
-namespace cxxtrace {
-namespace detail {
+namespace cxxtrace_test {
+using sync = concurrency_test_synchronization;
+
 auto
-operator<<(std::ostream& out, mpsc_ring_queue_push_result x) -> std::ostream&
+operator<<(std::ostream& out, ring_queue_push_result x) -> std::ostream&
 {
   switch (x) {
-    case mpsc_ring_queue_push_result::pushed:
+    case ring_queue_push_result::pushed:
       out << "pushed";
       break;
-    case mpsc_ring_queue_push_result::not_pushed_due_to_contention:
-      out << "not_pushed_due_to_contention";
-      break;
   }
   return out;
 }
-}
-}
-
-namespace cxxtrace_test {
-using sync = concurrency_test_synchronization;
 
 auto
 operator<<(std::ostream& out, processor_local_mpsc_ring_queue_push_result x)
@@ -138,7 +131,7 @@ protected:
 
   template<class RQ = RingQueue>
   auto try_bulk_push_range(size_type begin, size_type end) noexcept ->
-    typename RQ::push_result
+    typename ring_queue_wrapper<RQ>::push_result
   {
     return this->queue.try_push(
       end - begin, [&](auto data) noexcept {
@@ -491,7 +484,7 @@ public:
   }
 
 private:
-  using push_result = typename RingQueue::push_result;
+  using push_result = typename ring_queue_wrapper<RingQueue>::push_result;
 
   auto producer_range(int thread_index) const noexcept
     -> std::pair<size_type, size_type>
@@ -520,9 +513,7 @@ private:
 
   constexpr auto subqueue_count() noexcept -> int
   {
-    if constexpr (std::is_same_v<
-                    push_result,
-                    cxxtrace::detail::mpsc_ring_queue_push_result>) {
+    if constexpr (std::is_same_v<push_result, ring_queue_push_result>) {
       return 1;
     } else if constexpr (std::is_same_v<
                            push_result,
@@ -546,6 +537,91 @@ private:
   std::array<std::optional<push_result>, max_threads> producer_push_results;
 };
 
+// Like pushing_is_atomic_or_fails_with_multiple_producers, but for ring queues
+// whose pushes never fail. If concurrent pushes together overflow such a
+// queue, a push might drop all of its items, and a push might overwrite the
+// other push's oldest items. Popped items must still be intact and in order,
+// and a push must never drop only its newest items.
+template<class RingQueue>
+class racing_overflowing_pushes_never_corrupt_items
+  : public ring_queue_relacy_test_base<RingQueue>
+{
+public:
+  using size_type = typename RingQueue::size_type;
+
+  explicit racing_overflowing_pushes_never_corrupt_items(
+    size_type producer_1_push_size,
+    size_type producer_2_push_size)
+    : producer_push_sizes{ producer_1_push_size, producer_2_push_size }
+  {}
+
+  auto run_thread(int thread_index) -> void
+  {
+    assert(thread_index < int(this->producer_push_sizes.size()));
+
+    auto [begin, end] = this->producer_range(thread_index);
+    this->bulk_push_range(begin, end);
+  }
+
+  auto tear_down() -> void
+  {
+    using std::experimental::pmr::vector;
+    auto buffer = std::array<std::byte, 1024>{};
+    auto memory = monotonic_buffer_resource{ buffer.data(), buffer.size() };
+
+    auto items = vector<int>{ &memory };
+    this->queue.pop_all_into(items);
+    this->log_items("items", items, CXXTRACE_HERE);
+    CXXTRACE_ASSERT(items.size() <= std::size_t{ this->capacity });
+
+    auto last_item_by_producer = std::array<std::optional<int>, max_threads>{};
+    for (auto item : items) {
+      auto producer = this->producer_of_item(item);
+      CXXTRACE_ASSERT(producer.has_value());
+      auto& last_item = last_item_by_producer[*producer];
+      CXXTRACE_ASSERT(!last_item.has_value() || *last_item + 1 == item);
+      last_item = item;
+    }
+    for (auto i = 0; i < max_threads; ++i) {
+      auto& last_item = last_item_by_producer[i];
+      if (last_item.has_value()) {
+        auto end = this->producer_range(i).second;
+        CXXTRACE_ASSERT(*last_item == utilities::item_at_index(end - 1));
+      }
+    }
+  }
+
+private:
+  using utilities = ring_queue_relacy_test_utilities<size_type>;
+
+  auto producer_range(int thread_index) const noexcept
+    -> std::pair<size_type, size_type>
+  {
+    auto begin = size_type{ 0 };
+    for (auto i = 0; i < thread_index; ++i) {
+      begin += this->producer_push_sizes[i];
+    }
+    return std::pair{ begin,
+                      begin + this->producer_push_sizes[thread_index] };
+  }
+
+  auto producer_of_item(int item) const noexcept -> std::optional<int>
+  {
+    for (auto i = 0; i < max_threads; ++i) {
+      auto [begin, end] = this->producer_range(i);
+      if (item >= utilities::item_at_index(begin) &&
+          item < utilities::item_at_index(end)) {
+        return i;
+      }
+    }
+    return std::nullopt;
+  }
+
+  static inline constexpr auto max_threads = 2;
+
+  std::array<size_type, max_threads> producer_push_sizes;
+};
+
 template<
   template<class T, std::size_t Capacity, class Index = int, class Sync = sync>
   class RingQueue>
@@ -637,14 +713,26 @@ register_multiple_producer_ring_queue_concurrency_tests() -> void
     constexpr auto producer_2_push_size = 3;
     constexpr auto size = 4;
     static_assert(producer_1_push_size + producer_2_push_size > size);
-    register_concurrency_test<
-      pushing_is_atomic_or_fails_with_multiple_producers<RingQueue<int, size>>>(
-      2,
-      concurrency_test_depth::full,
-      processor_count,
-      initial_push_size,
-      producer_1_push_size,
-      producer_2_push_size);
+    using push_result =
+      typename ring_queue_wrapper<RingQueue<int, size>>::push_result;
+    if constexpr (std::is_same_v<push_result, ring_queue_push_result>) {
+      static_assert(initial_push_size == 0);
+      register_concurrency_test<
+        racing_overflowing_pushes_never_corrupt_items<RingQueue<int, size>>>(
+        2,
+        concurrency_test_depth::shallow,
+        producer_1_push_size,
+        producer_2_push_size);
+    } else {
+      register_concurrency_test<
+        pushing_is_atomic_or_fails_with_multiple_producers<
+          RingQueue<int, size>>>(2,
+                                 concurrency_test_depth::full,
+                                 processor_count,
+                                 initial_push_size,
+                                 producer_1_push_size,
+                                 producer_2_push_size);
+    }
   }
 }
 
@@ -6,11 +6,11 @@
 #include "memory_resource.h"
 #include "processor_local_mpsc_ring_queue.h"
 #include "reduce.h"
+#include "ring_queue_wrapper.h"
 #include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstddef>
-#include <cxxtrace/detail/mpsc_ring_queue.h>
 #include <cxxtrace/detail/queue_sink.h> // IWYU pragma: keep
 #include <cxxtrace/detail/ring_queue.h>
 #include <experimental/memory_resource>
@@ -122,8 +122,8 @@ public:
     int subqueue_count,
     size_type initial_push_size,
     std::array<size_type, max_threads> producer_push_sizes,
-    std::array<std::optional<cxxtrace::detail::mpsc_ring_queue_push_result>,
-               max_threads> producer_push_results)
+    std::array<std::optional<ring_queue_push_result>, max_threads>
+      producer_push_results)
     : subqueue_count{ subqueue_count }
     , initial_push_size{ initial_push_size }
     , producer_push_sizes{ producer_push_sizes }
@@ -371,16 +371,10 @@ private:
     return result;
   }
 
-  static auto convert_push_result(
-    cxxtrace::detail::mpsc_ring_queue_push_result r) noexcept -> push_result
+  static auto convert_push_result(ring_queue_push_result) noexcept
+    -> push_result
   {
-    using cxxtrace::detail::mpsc_ring_queue_push_result;
-    switch (r) {
-      case mpsc_ring_queue_push_result::pushed:
-        return push_result::pushed;
-      case mpsc_ring_queue_push_result::not_pushed_due_to_contention:
-        return push_result::skipped;
-    }
+    return push_result::pushed;
   }
 
   static auto convert_push_result(
@@ -4,6 +4,10 @@
 #include "thread.h"
 #include <atomic>
 #include <chrono>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/detail/clock_skew.h>
+#include <cxxtrace/detail/processor.h>
+#include <cxxtrace/detail/snapshot_sample.h>
 #include <cxxtrace/mpsc_ring_queue_processor_local_storage.h>
 #include <cxxtrace/mpsc_ring_queue_storage.h>
 #include <cxxtrace/ring_queue_storage.h>
@@ -31,6 +35,8 @@
   }
 
 using namespace std::chrono_literals;
+using testing::ElementsAre;
+using testing::IsEmpty;
 using testing::UnorderedElementsAre;
 
 namespace cxxtrace_test {
@@ -220,4 +226,142 @@ TYPED_TEST(test_snapshot, take_all_samples_is_thread_safe)
   EXPECT_THAT(sample_names,
               UnorderedElementsAre("span 1", "span 1", "span 2", "span 2"));
 }
+
+TYPED_TEST(test_snapshot, snapshot_is_anchored_to_wall_clock)
+{
+  CXXTRACE_SAMPLE();
+  auto wall_time_before = std::chrono::system_clock::now();
+  auto snapshot = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  auto wall_time_after = std::chrono::system_clock::now();
+
+  ASSERT_TRUE(snapshot.clock_anchor().has_value());
+  auto anchor = *snapshot.clock_anchor();
+  EXPECT_GE(anchor.wall_time, wall_time_before);
+  EXPECT_LE(anchor.wall_time, wall_time_after);
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_LT(snapshot.at(1).timestamp(), anchor.clock_time);
+}
+
+template<class Storage>
+class test_snapshot_processor_local : public test_span<Storage>
+{};
+
+using test_snapshot_processor_local_types = ::testing::Types<
+  mpsc_ring_queue_processor_local_test_storage<1024, clock_sample>,
+  spsc_ring_queue_processor_local_test_storage<1024, clock_sample>>;
+TYPED_TEST_CASE(test_snapshot_processor_local,
+                test_snapshot_processor_local_types, );
+
+TYPED_TEST(test_snapshot_processor_local, clock_is_not_corrected_by_default)
+{
+  CXXTRACE_SAMPLE();
+  auto snapshot = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  EXPECT_THAT(snapshot.processor_clock_offsets(), IsEmpty());
+}
+
+TYPED_TEST(test_snapshot_processor_local,
+           measuring_clock_skew_records_offset_for_every_processor)
+{
+  this->get_cxxtrace_config().storage().measure_clock_skew(this->clock());
+
+  CXXTRACE_SAMPLE();
+  auto snapshot = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  EXPECT_EQ(snapshot.size(), 2);
+  // fake_clock is shared by all processors, so every processor's clock agrees
+  // with the reference processor's clock.
+  auto processor_count = cxxtrace::detail::get_maximum_processor_id() + 1;
+  EXPECT_THAT(snapshot.processor_clock_offsets(),
+              testing::AllOf(testing::SizeIs(processor_count),
+                             testing::Each(0ns)));
+}
+
+TEST(test_processor_clock_skew,
+     merging_corrects_processor_samples_before_ordering_them)
+{
+  using cxxtrace::time_point;
+  using cxxtrace::detail::snapshot_sample;
+
+  auto make_sample = [](cxxtrace::thread_id thread_id,
+                        std::chrono::nanoseconds timestamp) -> snapshot_sample {
+    return snapshot_sample{ {}, thread_id, time_point{ timestamp } };
+  };
+  auto timestamps = [](const std::vector<snapshot_sample>& samples) {
+    auto result = std::vector<std::chrono::nanoseconds>{};
+    for (const auto& sample : samples) {
+      result.emplace_back(sample.timestamp.nanoseconds_since_reference());
+    }
+    return result;
+  };
+
+  auto samples = std::vector<snapshot_sample>{};
+  samples.emplace_back(make_sample(1, 10ns));
+  samples.emplace_back(make_sample(1, 30ns));
+  cxxtrace::detail::merge_processor_samples(samples, 0, 0ns);
+
+  // The second processor's clock is 100ns ahead of the first processor's
+  // clock. Uncorrected, all of its samples would sort after the first
+  // processor's samples.
+  auto second_processor_begin = samples.size();
+  samples.emplace_back(make_sample(2, 120ns));
+  samples.emplace_back(make_sample(2, 140ns));
+  cxxtrace::detail::merge_processor_samples(
+    samples, second_processor_begin, 100ns);
+
+  EXPECT_THAT(timestamps(samples), ElementsAre(10ns, 20ns, 30ns, 40ns));
+  auto thread_ids = std::vector<cxxtrace::thread_id>{};
+  for (const auto& sample : samples) {
+    thread_ids.emplace_back(sample.thread_id);
+  }
+  EXPECT_THAT(thread_ids, ElementsAre(1, 2, 1, 2));
+}
+
+TEST(test_processor_clock_skew, merging_sorts_processor_samples)
+{
+  using cxxtrace::time_point;
+  using cxxtrace::detail::snapshot_sample;
+
+  auto make_sample = [](cxxtrace::thread_id thread_id,
+                        std::chrono::nanoseconds timestamp) -> snapshot_sample {
+    return snapshot_sample{ {}, thread_id, time_point{ timestamp } };
+  };
+
+  auto samples = std::vector<snapshot_sample>{};
+  samples.emplace_back(make_sample(1, 20ns));
+  samples.emplace_back(make_sample(1, 40ns));
+  cxxtrace::detail::merge_processor_samples(samples, 0, 0ns);
+
+  // Samples are added out of timestamp order, e.g. because a complete span is
+  // added after the spans nested within it.
+  auto second_processor_begin = samples.size();
+  samples.emplace_back(make_sample(2, 30ns));
+  samples.emplace_back(make_sample(3, 10ns));
+  samples.emplace_back(make_sample(4, 30ns));
+  cxxtrace::detail::merge_processor_samples(
+    samples, second_processor_begin, 0ns);
+
+  auto thread_ids = std::vector<cxxtrace::thread_id>{};
+  for (const auto& sample : samples) {
+    thread_ids.emplace_back(sample.thread_id);
+  }
+  EXPECT_THAT(thread_ids, ElementsAre(3, 1, 2, 4, 1));
+}
+
+TEST(test_processor_clock_skew, subtracting_offset_can_move_time_backward)
+{
+  using cxxtrace::time_point;
+  using cxxtrace::detail::snapshot_sample;
+
+  auto samples = std::vector<snapshot_sample>{};
+  samples.emplace_back(snapshot_sample{ {}, 1, time_point{ 5ns } });
+  samples.emplace_back(snapshot_sample{ {}, 1, time_point{ 50ns } });
+  cxxtrace::detail::subtract_clock_offset(
+    samples.data(), samples.data() + samples.size(), -25ns);
+  EXPECT_EQ(samples[0].timestamp, time_point{ 30ns });
+  EXPECT_EQ(samples[1].timestamp, time_point{ 75ns });
+
+  cxxtrace::detail::subtract_clock_offset(
+    samples.data(), samples.data() + samples.size(), 10ns);
+  EXPECT_EQ(samples[0].timestamp, time_point{ 20ns });
+  EXPECT_EQ(samples[1].timestamp, time_point{ 65ns });
+}
 }
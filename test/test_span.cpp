@@ -1,14 +1,40 @@
 #include "test_span.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <cxxtrace/clock.h>
+#include <cxxtrace/config.h>
+#include <cxxtrace/detail/sample.h>
+#include <cxxtrace/detail/sample_site.h>
+#include <cxxtrace/dynamic_capacity.h>
+#include <cxxtrace/interned_string.h>
+#include <cxxtrace/mpsc_ring_queue_storage.h>
+#include <cxxtrace/ring_queue_overflow_policy.h>
+#include <cxxtrace/ring_queue_storage.h>
+#include <cxxtrace/ring_queue_unsafe_storage.h>
 #include <cxxtrace/sample.h>
 #include <cxxtrace/snapshot.h>
 #include <cxxtrace/span.h>
+#include <cxxtrace/span_argument.h>
+#include <cxxtrace/thread.h>
+#include <cxxtrace/unbounded_unsafe_storage.h>
 #include <gtest/gtest.h>
+#include <initializer_list>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 // IWYU pragma: no_include <algorithm>
 // IWYU pragma: no_include <memory>
 
-#define CXXTRACE_SPAN(category, name)                                          \
-  CXXTRACE_SPAN_WITH_CONFIG(this->get_cxxtrace_config(), category, name)
+#define CXXTRACE_SPAN(category, ...)                                           \
+  CXXTRACE_SPAN_WITH_CONFIG(this->get_cxxtrace_config(), category, __VA_ARGS__)
+#define CXXTRACE_COMPLETE_SPAN(category, name)                                 \
+  CXXTRACE_COMPLETE_SPAN_WITH_CONFIG(                                          \
+    this->get_cxxtrace_config(), category, name)
+#define CXXTRACE_PHASES(category)                                              \
+  CXXTRACE_PHASES_WITH_CONFIG(this->get_cxxtrace_config(), category)
 
 namespace cxxtrace_test {
 TYPED_TEST(test_span, no_samples_exist_by_default)
@@ -151,4 +177,918 @@ TYPED_TEST(test_span, span_samples_include_timestamps)
   EXPECT_LE(timestamp_inside_span, span_end_timestamp);
   EXPECT_LE(span_end_timestamp, timestamp_after_span);
 }
+
+TYPED_TEST(test_span, span_samples_include_timestamps_which_are_far_apart)
+{
+  using namespace std::chrono_literals;
+
+  auto& clock = this->clock();
+  clock.set_next_time_point(1s);
+  {
+    auto span = CXXTRACE_SPAN("category", "span");
+    clock.set_next_time_point(1h);
+  }
+  clock.set_next_time_point(1000h);
+  {
+    auto span = CXXTRACE_SPAN("category", "span");
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_EQ(samples.at(0).timestamp(), cxxtrace::time_point{ 1s });
+  EXPECT_EQ(samples.at(1).timestamp(), cxxtrace::time_point{ 1h });
+  EXPECT_EQ(samples.at(2).timestamp(), cxxtrace::time_point{ 1000h });
+  EXPECT_EQ(samples.at(3).timestamp(), cxxtrace::time_point{ 1000h + 1ns });
+}
+
+TYPED_TEST(test_span, timestamps_of_many_samples_survive_several_snapshots)
+{
+  using namespace std::chrono_literals;
+
+  auto& clock = this->clock();
+  clock.set_duration_between_samples(1ms);
+  auto check_samples = [&](const cxxtrace::samples_snapshot& samples,
+                           std::chrono::nanoseconds first_time_point) {
+    using size_type = cxxtrace::samples_snapshot::size_type;
+    for (auto i = size_type{ 0 }; i < samples.size(); ++i) {
+      EXPECT_EQ(samples.at(i).timestamp(),
+                cxxtrace::time_point{ first_time_point + i * 1ms })
+        << "i = " << i;
+    }
+  };
+
+  clock.set_next_time_point(1s);
+  for (auto i = 0; i < 150; ++i) {
+    auto span = CXXTRACE_SPAN("category", "span");
+  }
+  auto samples_1 = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  clock.set_next_time_point(2s);
+  for (auto i = 0; i < 150; ++i) {
+    auto span = CXXTRACE_SPAN("category", "span");
+  }
+  auto samples_2 = cxxtrace::samples_snapshot{ this->take_all_samples() };
+
+  ASSERT_EQ(samples_1.size(), 300);
+  check_samples(samples_1, 1s);
+  ASSERT_EQ(samples_2.size(), 300);
+  check_samples(samples_2, 2s);
+}
+
+TYPED_TEST(test_span, span_samples_include_source_location_of_span)
+{
+  auto span_line = __LINE__ + 2;
+  {
+    auto span = CXXTRACE_SPAN("category", "span");
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 2);
+  for (auto i = cxxtrace::samples_snapshot::size_type{ 0 }; i < samples.size();
+       ++i) {
+    EXPECT_STREQ(samples.at(i).file(), __FILE__);
+    EXPECT_EQ(samples.at(i).line(), span_line);
+  }
+}
+
+TYPED_TEST(test_span, span_names_can_change_between_calls_from_one_site)
+{
+  for (auto name : { "first", "second", "first" }) {
+    auto span = CXXTRACE_SPAN("category", name);
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 6);
+  EXPECT_STREQ(samples.at(0).name(), "first");
+  EXPECT_STREQ(samples.at(1).name(), "first");
+  EXPECT_STREQ(samples.at(2).name(), "second");
+  EXPECT_STREQ(samples.at(3).name(), "second");
+  EXPECT_STREQ(samples.at(4).name(), "first");
+  EXPECT_STREQ(samples.at(5).name(), "first");
+  EXPECT_EQ(samples.at(4).kind(), cxxtrace::sample_kind::enter_span);
+  EXPECT_EQ(samples.at(5).kind(), cxxtrace::sample_kind::exit_span);
+}
+
+TYPED_TEST(test_span, span_category_can_change_between_calls_from_one_site)
+{
+  auto span_line = 0;
+  for (auto category : { "first", "second" }) {
+    // clang-format off
+    span_line = __LINE__; auto span = CXXTRACE_COMPLETE_SPAN(category, "span");
+    // clang-format on
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_STREQ(samples.at(0).category(), "first");
+  EXPECT_STREQ(samples.at(1).category(), "second");
+  for (auto i = cxxtrace::samples_snapshot::size_type{ 0 }; i < samples.size();
+       ++i) {
+    EXPECT_STREQ(samples.at(i).name(), "span");
+    EXPECT_EQ(samples.at(i).kind(), cxxtrace::sample_kind::complete_span);
+    EXPECT_STREQ(samples.at(i).file(), __FILE__);
+    EXPECT_EQ(samples.at(i).line(), span_line);
+  }
+}
+
+TYPED_TEST(test_span, span_can_be_named_with_interned_runtime_string)
+{
+  for (auto i = 0; i < 2; ++i) {
+    auto name = "span " + std::to_string(i);
+    auto span = CXXTRACE_SPAN("category", cxxtrace::intern_string(name));
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_STREQ(samples.at(0).name(), "span 0");
+  EXPECT_STREQ(samples.at(1).name(), "span 0");
+  EXPECT_STREQ(samples.at(2).name(), "span 1");
+  EXPECT_STREQ(samples.at(3).name(), "span 1");
+}
+
+TYPED_TEST(test_span, complete_span_adds_one_sample_at_scope_exit)
+{
+  auto samples_inside_span = [&] {
+    auto span = CXXTRACE_COMPLETE_SPAN("span category", "span name");
+    return cxxtrace::samples_snapshot{ this->take_all_samples() };
+  }();
+  EXPECT_EQ(samples_inside_span.size(), 0);
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 1);
+  auto sample = samples.at(0);
+  EXPECT_STREQ(sample.category(), "span category");
+  EXPECT_STREQ(sample.name(), "span name");
+  EXPECT_EQ(sample.kind(), cxxtrace::sample_kind::complete_span);
+  EXPECT_NE(sample.end_timestamp(), std::nullopt);
+}
+
+TYPED_TEST(test_span, complete_span_sample_includes_enter_and_exit_timestamps)
+{
+  auto& clock = this->clock();
+  auto timestamp_before_span = clock.make_time_point(clock.query());
+  auto timestamp_inside_span = [&] {
+    auto span = CXXTRACE_COMPLETE_SPAN("category", "span");
+    return clock.make_time_point(clock.query());
+  }();
+  auto timestamp_after_span = clock.make_time_point(clock.query());
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 1);
+  auto span_begin_timestamp = samples.at(0).timestamp();
+  auto span_end_timestamp = samples.at(0).end_timestamp();
+  ASSERT_TRUE(span_end_timestamp.has_value());
+  EXPECT_LE(timestamp_before_span, span_begin_timestamp);
+  EXPECT_LE(span_begin_timestamp, timestamp_inside_span);
+  EXPECT_LE(timestamp_inside_span, *span_end_timestamp);
+  EXPECT_LE(*span_end_timestamp, timestamp_after_span);
+}
+
+TYPED_TEST(test_span, nested_complete_span_is_within_enclosing_complete_span)
+{
+  {
+    auto span_1 = CXXTRACE_COMPLETE_SPAN("span category", "span name 1");
+    auto span_2 = CXXTRACE_COMPLETE_SPAN("span category", "span name 2");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 2);
+  // Processor-local storages order samples by timestamp. Other storages order
+  // samples as they were added, innermost complete span first.
+  auto outer_index = std::string{ samples.at(0).name() } == "span name 1"
+                       ? cxxtrace::samples_snapshot::size_type{ 0 }
+                       : cxxtrace::samples_snapshot::size_type{ 1 };
+  auto outer = samples.at(outer_index);
+  auto inner = samples.at(1 - outer_index);
+  EXPECT_STREQ(outer.name(), "span name 1");
+  EXPECT_STREQ(inner.name(), "span name 2");
+  EXPECT_LE(outer.timestamp(), inner.timestamp());
+  EXPECT_LE(*inner.end_timestamp(), *outer.end_timestamp());
+}
+
+TYPED_TEST(test_span, samples_record_depth_of_enclosing_spans)
+{
+  {
+    auto outer = CXXTRACE_SPAN("category", "outer");
+    {
+      auto inner = CXXTRACE_SPAN("category", "inner");
+    }
+    auto complete = CXXTRACE_COMPLETE_SPAN("category", "complete");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 5);
+  EXPECT_STREQ(samples.at(0).name(), "outer");
+  EXPECT_EQ(samples.at(0).depth(), 0);
+  EXPECT_STREQ(samples.at(1).name(), "inner");
+  EXPECT_EQ(samples.at(1).depth(), 1);
+  EXPECT_STREQ(samples.at(2).name(), "inner");
+  EXPECT_EQ(samples.at(2).depth(), 1);
+  EXPECT_STREQ(samples.at(3).name(), "complete");
+  EXPECT_EQ(samples.at(3).depth(), 1);
+  EXPECT_STREQ(samples.at(4).name(), "outer");
+  EXPECT_EQ(samples.at(4).depth(), 0);
+}
+
+TYPED_TEST(test_span, span_depth_is_restored_after_spans_exit)
+{
+  {
+    auto span_1 = CXXTRACE_SPAN("category", "span 1");
+    auto span_2 = CXXTRACE_COMPLETE_SPAN("category", "span 2");
+  }
+  this->take_all_samples();
+  {
+    auto span = CXXTRACE_SPAN("category", "span 3");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples.at(0).depth(), 0);
+  EXPECT_EQ(samples.at(1).depth(), 0);
+}
+
+TYPED_TEST(test_span, phases_add_one_sample_per_transition)
+{
+  using namespace std::chrono_literals;
+
+  auto& clock = this->clock();
+  {
+    auto phases = CXXTRACE_PHASES("category");
+    clock.set_next_time_point(1s);
+    phases.next("parse");
+    clock.set_next_time_point(2s);
+    phases.next("execute");
+    clock.set_next_time_point(3s);
+    phases.next("respond");
+    clock.set_next_time_point(4s);
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_EQ(samples.at(0).kind(), cxxtrace::sample_kind::enter_span);
+  EXPECT_STREQ(samples.at(0).name(), "parse");
+  EXPECT_EQ(samples.at(0).timestamp(), cxxtrace::time_point{ 1s });
+  EXPECT_EQ(samples.at(1).kind(), cxxtrace::sample_kind::next_phase);
+  EXPECT_STREQ(samples.at(1).name(), "execute");
+  EXPECT_EQ(samples.at(1).timestamp(), cxxtrace::time_point{ 2s });
+  EXPECT_EQ(samples.at(2).kind(), cxxtrace::sample_kind::next_phase);
+  EXPECT_STREQ(samples.at(2).name(), "respond");
+  EXPECT_EQ(samples.at(2).timestamp(), cxxtrace::time_point{ 3s });
+  EXPECT_EQ(samples.at(3).kind(), cxxtrace::sample_kind::exit_span);
+  EXPECT_STREQ(samples.at(3).name(), "respond");
+  EXPECT_EQ(samples.at(3).timestamp(), cxxtrace::time_point{ 4s });
+  for (auto i = 0; i < 4; ++i) {
+    EXPECT_STREQ(samples.at(i).category(), "category");
+  }
+}
+
+TYPED_TEST(test_span, phases_without_next_add_no_samples)
+{
+  {
+    auto phases = CXXTRACE_PHASES("category");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  EXPECT_EQ(samples.size(), 0);
+}
+
+TYPED_TEST(test_span, phases_record_depth_of_enclosing_spans)
+{
+  {
+    auto outer = CXXTRACE_SPAN("category", "outer");
+    auto phases = CXXTRACE_PHASES("category");
+    phases.next("phase 1");
+    {
+      auto inner = CXXTRACE_SPAN("category", "inner");
+    }
+    phases.next("phase 2");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 7);
+  EXPECT_STREQ(samples.at(1).name(), "phase 1");
+  EXPECT_EQ(samples.at(1).depth(), 1);
+  EXPECT_STREQ(samples.at(2).name(), "inner");
+  EXPECT_EQ(samples.at(2).depth(), 2);
+  EXPECT_STREQ(samples.at(4).name(), "phase 2");
+  EXPECT_EQ(samples.at(4).depth(), 1);
+  EXPECT_STREQ(samples.at(5).name(), "phase 2");
+  EXPECT_EQ(samples.at(5).depth(), 1);
+  EXPECT_STREQ(samples.at(6).name(), "outer");
+  EXPECT_EQ(samples.at(6).depth(), 0);
+}
+
+TYPED_TEST(test_span, phases_with_many_names_record_each_name)
+{
+  static constexpr const char* names[] = { "a", "b", "c", "d", "e",
+                                           "f", "g", "h", "i", "j" };
+  {
+    auto phases = CXXTRACE_PHASES("category");
+    for (auto round = 0; round < 2; ++round) {
+      for (auto* name : names) {
+        phases.next(name);
+      }
+    }
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 21);
+  for (auto i = 0; i < 20; ++i) {
+    EXPECT_STREQ(samples.at(i).name(), names[i % 10]);
+  }
+}
+
+TYPED_TEST(test_span, snapshot_reports_no_losses_if_no_samples_are_discarded)
+{
+  {
+    auto span = CXXTRACE_SPAN("category", "span");
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  EXPECT_TRUE(samples.losses().empty());
+  EXPECT_EQ(samples.discarded_record_count(), 0);
+}
+
+TYPED_TEST(test_span, span_records_arguments_with_enter_sample)
+{
+  {
+    auto span = CXXTRACE_SPAN("category",
+                              "span",
+                              cxxtrace::span_argument{ "id", 42 },
+                              cxxtrace::span_argument{ "ratio", 0.5 },
+                              cxxtrace::span_argument{ "status", "ok" });
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples.at(0).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "id", std::int64_t{ 42 } },
+              { "ratio", 0.5 },
+              { "status", std::string{ "ok" } },
+            }));
+  EXPECT_TRUE(samples.at(1).arguments().empty());
+}
+
+TYPED_TEST(test_span, arguments_are_attributed_to_their_own_span)
+{
+  auto long_string = std::string(100, 'x');
+  {
+    auto span_1 = CXXTRACE_SPAN(
+      "category", "span 1", cxxtrace::span_argument{ "text", long_string });
+    auto span_2 = CXXTRACE_SPAN("category", "span 2");
+    auto span_3 = CXXTRACE_SPAN(
+      "category", "span 3", cxxtrace::span_argument{ "count", -1 });
+  }
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 6);
+  EXPECT_STREQ(samples.at(0).name(), "span 1");
+  EXPECT_EQ(samples.at(0).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "text", long_string },
+            }));
+  EXPECT_STREQ(samples.at(1).name(), "span 2");
+  EXPECT_TRUE(samples.at(1).arguments().empty());
+  EXPECT_STREQ(samples.at(2).name(), "span 3");
+  EXPECT_EQ(samples.at(2).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "count", std::int64_t{ -1 } },
+            }));
+}
+
+TYPED_TEST(test_span, long_string_argument_is_truncated)
+{
+  auto long_string = std::string(cxxtrace::span_argument::max_string_size + 10,
+                                 'x');
+  {
+    auto span = CXXTRACE_SPAN(
+      "category", "span", cxxtrace::span_argument{ "text", long_string });
+  }
+  auto truncated_string =
+    long_string.substr(0, cxxtrace::span_argument::max_string_size);
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples.at(0).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "text", truncated_string },
+            }));
+}
+
+TEST(test_sample_site, interned_sites_are_found_by_index)
+{
+  using cxxtrace::detail::intern_sample_site_set;
+  using cxxtrace::detail::lookup_sample_site;
+
+  // Intern enough sets to need several chunks in the registry. Interned sets
+  // live forever, so their names must too.
+  static const auto names = [] {
+    auto names = std::vector<std::string>{};
+    for (auto i = 0; i < 100; ++i) {
+      names.emplace_back("site " + std::to_string(i));
+    }
+    return names;
+  }();
+  auto sets = std::vector<const cxxtrace::detail::sample_site_set*>{};
+  for (const auto& name : names) {
+    sets.emplace_back(
+      &intern_sample_site_set("category", name.c_str(), "file.cpp", 42));
+  }
+  for (const auto* set : sets) {
+    for (const auto& site : set->sites) {
+      EXPECT_EQ(&lookup_sample_site(site.index), &site);
+    }
+  }
+}
+
+TEST(test_sample_site, shared_records_with_64_bit_clock_are_16_bytes)
+{
+  using record = cxxtrace::detail::sample_record<
+    cxxtrace::detail::global_sample<std::uint64_t>>;
+  static_assert(sizeof(record) == 16);
+
+  auto site = cxxtrace::detail::sample_site_local_data{
+    "category", "name", cxxtrace::sample_kind::enter_span
+  };
+  auto sample = record::from_sample(
+    cxxtrace::detail::global_sample<std::uint64_t>{ site, 1234 },
+    cxxtrace::detail::thread_index{ 7 });
+  EXPECT_EQ(&sample.get_sample().site.site(), &site.site());
+  EXPECT_EQ(sample.get_sample().time_point, 1234);
+  EXPECT_EQ(sample.thread, cxxtrace::detail::thread_index{ 7 });
+}
+
+TEST(test_sample_site_cache, changed_name_reuses_first_interned_sites)
+{
+  auto cache = cxxtrace::detail::sample_site_cache{ "file.cpp", 42 };
+  auto first = cache.get("category", "first");
+  EXPECT_EQ(first.dynamic_category, nullptr);
+  EXPECT_EQ(first.dynamic_name, nullptr);
+  EXPECT_STREQ(first.set->name, "first");
+
+  auto second = cache.get("category", "second");
+  EXPECT_EQ(second.set, first.set);
+  EXPECT_EQ(second.dynamic_category, nullptr);
+  EXPECT_STREQ(second.dynamic_name, "second");
+
+  auto other_category = cache.get("other category", "first");
+  EXPECT_EQ(other_category.set, first.set);
+  EXPECT_STREQ(other_category.dynamic_category, "other category");
+  EXPECT_EQ(other_category.dynamic_name, nullptr);
+
+  auto first_again = cache.get("category", "first");
+  EXPECT_EQ(first_again.set, first.set);
+  EXPECT_EQ(first_again.dynamic_name, nullptr);
+}
+
+TEST(test_sample_site_cache, multi_cache_interns_each_entry_once)
+{
+  static constexpr const char* names[] = { "a", "b", "c", "d", "e",
+                                           "f", "g", "h", "i", "j" };
+  auto cache = cxxtrace::detail::multi_sample_site_cache{ "file.cpp", 42 };
+  auto sets = std::vector<const cxxtrace::detail::sample_site_set*>{};
+  for (auto i = std::size_t{ 0 }; i < std::size(names); ++i) {
+    auto sites = cache.get("category", names[i], i);
+    EXPECT_STREQ(sites.dynamic_name ? sites.dynamic_name : sites.set->name,
+                 names[i]);
+    sets.emplace_back(sites.set);
+  }
+  for (auto round = 0; round < 2; ++round) {
+    for (auto i = std::size_t{ 0 }; i < std::size(names); ++i) {
+      EXPECT_EQ(cache.get("category", names[i], i).set, sets[i]);
+    }
+  }
+}
+
+TEST(test_sample_site_cache, multi_cache_probes_past_colliding_hints)
+{
+  static constexpr const char* names[] = { "a", "b", "c", "d",
+                                           "e", "f", "g", "h" };
+  auto cache = cxxtrace::detail::multi_sample_site_cache{ "file.cpp", 42 };
+  for (auto* name : names) {
+    cache.get("category", name, 0);
+  }
+  for (auto round = 0; round < 2; ++round) {
+    for (auto* name : names) {
+      auto sites = cache.get("category", name, 0);
+      EXPECT_EQ(sites.dynamic_name, nullptr) << name;
+      EXPECT_STREQ(sites.set->name, name);
+    }
+  }
+
+  auto overflow = cache.get("category", "i", 0);
+  EXPECT_STREQ(overflow.dynamic_name, "i");
+}
+
+TEST(test_sample_site_cache, phases_with_varying_names_reuse_interned_sites)
+{
+  auto clock = cxxtrace_test::clock{};
+  // The phases below add 14 samples. Dynamic name records would overflow this
+  // storage and evict samples.
+  auto storage = cxxtrace::ring_queue_unsafe_storage<16, clock_sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+  auto record_phases = [&](bool skip_middle) -> void {
+    auto phases = CXXTRACE_PHASES_WITH_CONFIG(config, "category");
+    phases.next("first");
+    if (!skip_middle) {
+      phases.next("middle");
+    }
+    phases.next("last");
+  };
+  record_phases(false);
+  record_phases(true);
+  record_phases(false);
+  record_phases(true);
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 14);
+  EXPECT_STREQ(samples.at(0).name(), "first");
+  EXPECT_STREQ(samples.at(4).name(), "first");
+  EXPECT_STREQ(samples.at(5).name(), "last");
+  EXPECT_STREQ(samples.at(13).name(), "last");
+}
+
+TEST(test_sample_site_cache, dynamic_name_records_are_not_orphaned)
+{
+  using cxxtrace::sample_kind;
+
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::ring_queue_unsafe_storage<4, clock_sample>{};
+  auto cache = cxxtrace::detail::sample_site_cache{ "file.cpp", 42 };
+  for (auto* name : { "first", "second", "third", "first" }) {
+    auto sites = cache.get("category", name);
+    auto arguments = cxxtrace::detail::sample_arguments<clock_sample>{};
+    arguments.dynamic_category = sites.dynamic_category;
+    arguments.dynamic_name = sites.dynamic_name;
+    storage.add_sample(
+      sites.at(sample_kind::instant), clock.query(), arguments);
+  }
+
+  // The second and third samples each occupy two records (a sample record and
+  // a dynamic_name record). The fourth sample overwrites the second sample's
+  // sample record, orphaning its dynamic_name record.
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_STREQ(samples.at(0).name(), "third");
+  EXPECT_STREQ(samples.at(1).name(), "first");
+}
+
+TEST(test_span_arguments, overwritten_sample_does_not_leave_orphaned_arguments)
+{
+  using cxxtrace::sample_kind;
+
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::ring_queue_unsafe_storage<8, clock_sample>{};
+  auto arguments = std::array{ cxxtrace::span_argument{ "a", 1 },
+                               cxxtrace::span_argument{ "b", 2 } };
+  // Each sample occupies five records (a 16-byte sample record, then a name
+  // record and a value record for each argument), so the second sample
+  // overwrites the first sample and its first argument's name.
+  storage.add_sample(
+    cxxtrace::detail::sample_site_local_data{
+      "category", "first", sample_kind::enter_span },
+    clock.query(),
+    cxxtrace::detail::sample_arguments<clock_sample>{ arguments.data(), 2 });
+  storage.add_sample(
+    cxxtrace::detail::sample_site_local_data{
+      "category", "second", sample_kind::enter_span },
+    clock.query(),
+    cxxtrace::detail::sample_arguments<clock_sample>{ arguments.data(), 2 });
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 1);
+  EXPECT_STREQ(samples.at(0).name(), "second");
+  EXPECT_EQ(samples.at(0).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "a", std::int64_t{ 1 } },
+              { "b", std::int64_t{ 2 } },
+            }));
+}
+
+TEST(test_span_arguments, arguments_which_do_not_fit_in_ring_queue_are_dropped)
+{
+  using cxxtrace::sample_kind;
+
+  auto clock = cxxtrace_test::clock{};
+  // A sample with two arguments occupies five records, and a sample with three
+  // arguments occupies seven.
+  auto storage = cxxtrace::ring_queue_unsafe_storage<6, clock_sample>{};
+  auto arguments = std::array{ cxxtrace::span_argument{ "a", 1 },
+                               cxxtrace::span_argument{ "b", 2 },
+                               cxxtrace::span_argument{ "c", 3 } };
+  storage.add_sample(
+    cxxtrace::detail::sample_site_local_data{
+      "category", "span", sample_kind::enter_span },
+    clock.query(),
+    cxxtrace::detail::sample_arguments<clock_sample>{ arguments.data(), 3 });
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 1);
+  EXPECT_EQ(samples.at(0).arguments(),
+            (std::vector<cxxtrace::sample_argument>{
+              { "a", std::int64_t{ 1 } },
+              { "b", std::int64_t{ 2 } },
+            }));
+}
+
+TEST(test_span_timestamps,
+     overwritten_thread_local_samples_do_not_corrupt_remaining_timestamps)
+{
+  using cxxtrace::sample_kind;
+
+  auto clock = cxxtrace_test::clock{};
+  auto storage = ring_queue_thread_local_test_storage<16, clock_sample>{};
+  // Some of the overwritten records hold time bases of samples which remain
+  // in the queue. Such samples must be dropped rather than be given a wrong
+  // timestamp.
+  auto last_time_point = clock_sample{ 0 };
+  for (auto i = clock_sample{ 1 }; i <= 100; ++i) {
+    last_time_point = i * (clock_sample{ 1 } << 30);
+    storage.add_sample(cxxtrace::detail::sample_site_local_data{
+                         "category", "span", sample_kind::enter_span },
+                       last_time_point);
+  }
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_GE(samples.size(), 1);
+  EXPECT_LE(samples.size(), 16);
+  auto expected_time_point = last_time_point;
+  for (auto i = samples.size(); i-- > 0;) {
+    EXPECT_EQ(samples.at(i).timestamp(),
+              clock.make_time_point(expected_time_point))
+      << "i = " << i;
+    expected_time_point -= clock_sample{ 1 } << 30;
+  }
+  storage.reset();
+}
+
+TEST(test_span_depth, exit_samples_keep_depth_if_enter_samples_are_overwritten)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::ring_queue_unsafe_storage<4, clock_sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+  {
+    auto span_1 = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span 1");
+    auto span_2 = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span 2");
+    auto span_3 = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span 3");
+    auto span_4 = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span 4");
+  }
+
+  // Only the exit samples remain.
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_STREQ(samples.at(0).name(), "span 4");
+  EXPECT_EQ(samples.at(0).depth(), 3);
+  EXPECT_STREQ(samples.at(3).name(), "span 1");
+  EXPECT_EQ(samples.at(3).depth(), 0);
+}
+
+TEST(test_span_depth, spans_in_other_storage_do_not_affect_depth)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::ring_queue_unsafe_storage<16, clock_sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+  auto other_storage = cxxtrace::unbounded_unsafe_storage<clock_sample>{};
+  auto other_config = cxxtrace::basic_config{ other_storage, clock };
+  {
+    auto other_span =
+      CXXTRACE_SPAN_WITH_CONFIG(other_config, "category", "other span");
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+    auto other_inner_span =
+      CXXTRACE_SPAN_WITH_CONFIG(other_config, "category", "other inner span");
+  }
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples.at(0).depth(), 0);
+  EXPECT_EQ(samples.at(1).depth(), 0);
+  auto other_samples = other_storage.take_all_samples(clock);
+  ASSERT_EQ(other_samples.size(), 4);
+  EXPECT_STREQ(other_samples.at(1).name(), "other inner span");
+  EXPECT_EQ(other_samples.at(1).depth(), 1);
+}
+
+TEST(test_sample_loss, snapshot_reports_records_discarded_by_global_queue)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::ring_queue_unsafe_storage<4, clock_sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+  for (auto i = 0; i < 3; ++i) {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto samples = storage.take_all_samples(clock);
+  EXPECT_EQ(samples.size(), 4);
+  ASSERT_EQ(samples.losses().size(), 1);
+  EXPECT_EQ(samples.losses()[0].thread_id, std::nullopt);
+  EXPECT_EQ(samples.losses()[0].processor_id, std::nullopt);
+  EXPECT_EQ(samples.losses()[0].discarded_record_count, 2);
+  EXPECT_EQ(samples.discarded_record_count(), 2);
+
+  // Losses are reported once.
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+  samples = storage.take_all_samples(clock);
+  EXPECT_EQ(samples.size(), 2);
+  EXPECT_TRUE(samples.losses().empty());
+}
+
+TEST(test_sample_loss, snapshot_reports_records_discarded_by_thread_queue)
+{
+  using cxxtrace::sample_kind;
+
+  auto clock = cxxtrace_test::clock{};
+  auto storage = ring_queue_thread_local_test_storage<16, clock_sample>{};
+  for (auto i = clock_sample{ 1 }; i <= 100; ++i) {
+    storage.add_sample(cxxtrace::detail::sample_site_local_data{
+                         "category", "span", sample_kind::enter_span },
+                       i);
+  }
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.losses().size(), 1);
+  EXPECT_EQ(samples.losses()[0].thread_id, cxxtrace::get_current_thread_id());
+  EXPECT_EQ(samples.losses()[0].processor_id, std::nullopt);
+  // Every sample was either kept or discarded. (Discarded time_base records
+  // are counted too.)
+  EXPECT_GE(samples.losses()[0].discarded_record_count + samples.size(), 100);
+  storage.reset();
+}
+
+template<class Storage>
+class test_dynamic_capacity_storage : public testing::Test
+{};
+
+using test_dynamic_capacity_storage_types = ::testing::Types<
+  cxxtrace::mpsc_ring_queue_storage<cxxtrace::dynamic_capacity, clock_sample>,
+  cxxtrace::ring_queue_storage<cxxtrace::dynamic_capacity, clock_sample>,
+  cxxtrace::ring_queue_unsafe_storage<cxxtrace::dynamic_capacity,
+                                      clock_sample>>;
+TYPED_TEST_CASE(test_dynamic_capacity_storage,
+                test_dynamic_capacity_storage_types, );
+
+TYPED_TEST(test_dynamic_capacity_storage,
+           capacity_is_rounded_up_to_power_of_two)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = TypeParam{ 3 };
+  auto config = cxxtrace::basic_config{ storage, clock };
+  for (auto i = 0; i < 3; ++i) {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  // The capacity (3) is rounded up to 4, so the newest two spans are kept.
+  auto samples = storage.take_all_samples(clock);
+  EXPECT_EQ(samples.size(), 4);
+  EXPECT_EQ(samples.discarded_record_count(), 2);
+}
+
+TYPED_TEST(test_dynamic_capacity_storage, large_capacity_keeps_all_samples)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = TypeParam{ 1000 };
+  auto config = cxxtrace::basic_config{ storage, clock };
+  for (auto i = 0; i < 500; ++i) {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto samples = storage.take_all_samples(clock);
+  EXPECT_EQ(samples.size(), 1000);
+  EXPECT_EQ(samples.discarded_record_count(), 0);
+}
+
+template<class Storage>
+class test_dynamic_capacity_local_storage : public testing::Test
+{};
+
+using test_dynamic_capacity_local_storage_types = ::testing::Types<
+  mpsc_ring_queue_processor_local_test_storage<cxxtrace::dynamic_capacity,
+                                               clock_sample>,
+  ring_queue_thread_local_test_storage<cxxtrace::dynamic_capacity,
+                                       clock_sample>,
+  spsc_ring_queue_processor_local_test_storage<cxxtrace::dynamic_capacity,
+                                               clock_sample>,
+  spsc_ring_queue_thread_local_test_storage<cxxtrace::dynamic_capacity,
+                                            clock_sample>>;
+TYPED_TEST_CASE(test_dynamic_capacity_local_storage,
+                test_dynamic_capacity_local_storage_types, );
+
+// Thread-local queues are allocated when a thread first adds a sample, so
+// these tests add samples from a new thread.
+
+TYPED_TEST(test_dynamic_capacity_local_storage, small_capacity_discards_samples)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = TypeParam{ 3 };
+  auto config = cxxtrace::basic_config{ storage, clock };
+  std::thread{ [&] {
+    for (auto i = 0; i < 100; ++i) {
+      auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+    }
+  } }.join();
+
+  auto samples = storage.take_all_samples(clock);
+  EXPECT_LT(samples.size(), 200);
+  EXPECT_GT(samples.discarded_record_count(), 0);
+  storage.reset();
+}
+
+TYPED_TEST(test_dynamic_capacity_local_storage,
+           large_capacity_keeps_all_samples)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = TypeParam{ 2000 };
+  auto config = cxxtrace::basic_config{ storage, clock };
+  std::thread{ [&] {
+    for (auto i = 0; i < 500; ++i) {
+      auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+    }
+  } }.join();
+
+  auto samples = storage.take_all_samples(clock);
+  EXPECT_EQ(samples.size(), 1000);
+  EXPECT_EQ(samples.discarded_record_count(), 0);
+  storage.reset();
+}
+
+TEST(test_drop_newest_storage, snapshot_keeps_oldest_samples)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::mpsc_ring_queue_storage<
+    4,
+    clock_sample,
+    cxxtrace::ring_queue_overflow_policy::drop_newest>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "first");
+  }
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "second");
+  }
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "third");
+  }
+
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_STREQ(samples.at(0).name(), "first");
+  EXPECT_STREQ(samples.at(1).name(), "first");
+  EXPECT_STREQ(samples.at(2).name(), "second");
+  EXPECT_STREQ(samples.at(3).name(), "second");
+  EXPECT_EQ(samples.discarded_record_count(), 2);
+
+  // Taking samples makes room for new samples.
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "fourth");
+  }
+  samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_STREQ(samples.at(0).name(), "fourth");
+  EXPECT_EQ(samples.discarded_record_count(), 0);
+}
+
+TEST(test_complete_span, overwritten_complete_spans_are_never_partial)
+{
+  auto clock = cxxtrace_test::clock{};
+  auto storage = cxxtrace::ring_queue_unsafe_storage<4, clock_sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+  for (auto i = 0; i < 5; ++i) {
+    auto span = CXXTRACE_COMPLETE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  // Each complete span occupies two records, so two spans fit.
+  auto samples = storage.take_all_samples(clock);
+  ASSERT_EQ(samples.size(), 2);
+  for (auto i = cxxtrace::samples_snapshot::size_type{ 0 }; i < samples.size();
+       ++i) {
+    EXPECT_EQ(samples.at(i).kind(), cxxtrace::sample_kind::complete_span);
+    EXPECT_NE(samples.at(i).end_timestamp(), std::nullopt);
+  }
+}
+
+template<class Storage>
+class test_processor_local_span : public test_span<Storage>
+{};
+
+using test_processor_local_span_types = ::testing::Types<
+  mpsc_ring_queue_processor_local_test_storage<1024, clock_sample>,
+  spsc_ring_queue_processor_local_test_storage<1024, clock_sample>>;
+TYPED_TEST_CASE(test_processor_local_span,
+                test_processor_local_span_types, );
+
+TYPED_TEST(test_processor_local_span,
+           complete_spans_are_ordered_by_enter_timestamp)
+{
+  {
+    auto outer = CXXTRACE_COMPLETE_SPAN("category", "outer");
+    auto span = CXXTRACE_SPAN("category", "span");
+    auto inner = CXXTRACE_COMPLETE_SPAN("category", "inner");
+  }
+
+  auto samples = cxxtrace::samples_snapshot{ this->take_all_samples() };
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_STREQ(samples.at(0).name(), "outer");
+  EXPECT_EQ(samples.at(0).kind(), cxxtrace::sample_kind::complete_span);
+  EXPECT_STREQ(samples.at(1).name(), "span");
+  EXPECT_EQ(samples.at(1).kind(), cxxtrace::sample_kind::enter_span);
+  EXPECT_STREQ(samples.at(2).name(), "inner");
+  EXPECT_EQ(samples.at(2).kind(), cxxtrace::sample_kind::complete_span);
+  EXPECT_STREQ(samples.at(3).name(), "span");
+  EXPECT_EQ(samples.at(3).kind(), cxxtrace::sample_kind::exit_span);
+  for (auto i = cxxtrace::samples_snapshot::size_type{ 1 }; i < samples.size();
+       ++i) {
+    EXPECT_LE(samples.at(i - 1).timestamp(), samples.at(i).timestamp());
+  }
+}
 }
@@ -2,15 +2,18 @@
 #include "stringify.h" // IWYU pragma: keep
 #include "thread.h"
 #include <array>
+#include <cstddef>
 #include <cstring>
 #include <cxxtrace/detail/have.h>
 #include <cxxtrace/detail/thread.h>
+#include <cxxtrace/detail/thread_index.h>
 #include <cxxtrace/string.h>
 #include <cxxtrace/thread.h>
 #include <gtest/gtest.h>
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 // IWYU pragma: no_include "stringify_impl.h"
 
 #if CXXTRACE_HAVE_PTHREAD_GETNAME_NP || CXXTRACE_HAVE_PTHREAD_THREADID_NP
@@ -126,6 +129,85 @@ TEST(test_thread, thread_id_differs_on_different_live_threads)
   thread_2.join();
 }
 
+TEST(test_thread_index, current_thread_index_is_stable)
+{
+  auto index = cxxtrace::detail::get_current_thread_index();
+  EXPECT_EQ(cxxtrace::detail::get_current_thread_index(), index);
+  EXPECT_NE(index, cxxtrace::detail::unknown_thread_index);
+}
+
+TEST(test_thread_index, thread_index_maps_to_and_from_current_thread_id)
+{
+  auto id = cxxtrace::get_current_thread_id();
+  auto index = cxxtrace::detail::get_current_thread_index();
+  EXPECT_EQ(cxxtrace::detail::thread_id_of_index(index), id);
+  EXPECT_EQ(cxxtrace::detail::thread_index_of_id(id), index);
+}
+
+TEST(test_thread_index, thread_index_differs_on_different_threads)
+{
+  auto thread_1_index = cxxtrace::detail::thread_index{};
+  auto thread_1_id = cxxtrace::thread_id{};
+  std::thread{ [&] {
+    thread_1_index = cxxtrace::detail::get_current_thread_index();
+    thread_1_id = cxxtrace::get_current_thread_id();
+  } }.join();
+
+  auto thread_2_index = cxxtrace::detail::thread_index{};
+  auto thread_2_id = cxxtrace::thread_id{};
+  std::thread{ [&] {
+    thread_2_index = cxxtrace::detail::get_current_thread_index();
+    thread_2_id = cxxtrace::get_current_thread_id();
+  } }.join();
+
+  auto main_thread_index = cxxtrace::detail::get_current_thread_index();
+  // Even if the operating system reused thread_1's ID for thread_2, thread_1's
+  // index was released when thread_1 exited, and released indexes are not
+  // reused until every other index has been assigned.
+  EXPECT_NE(thread_1_index, thread_2_index);
+  EXPECT_NE(main_thread_index, thread_1_index);
+  EXPECT_NE(main_thread_index, thread_2_index);
+  EXPECT_EQ(cxxtrace::detail::thread_id_of_index(thread_1_index), thread_1_id);
+  EXPECT_EQ(cxxtrace::detail::thread_id_of_index(thread_2_index), thread_2_id);
+}
+
+TEST(test_thread_index, exited_thread_index_is_reused_after_others_are_assigned)
+{
+  auto exited_index = cxxtrace::detail::thread_index{};
+  auto exited_id = cxxtrace::thread_id{};
+  std::thread{ [&] {
+    exited_index = cxxtrace::detail::get_current_thread_index();
+    exited_id = cxxtrace::get_current_thread_id();
+  } }.join();
+
+  // Register fake thread IDs (which no real thread has) until exited_index is
+  // reused.
+  auto fake_indexes = std::vector<cxxtrace::detail::thread_index>{};
+  auto reused = false;
+  for (auto i = std::size_t{ 0 }; i < cxxtrace::detail::max_thread_index_count;
+       ++i) {
+    EXPECT_EQ(cxxtrace::detail::thread_id_of_index(exited_index), exited_id);
+    auto fake_id = static_cast<cxxtrace::thread_id>(-1 - static_cast<int>(i));
+    auto index = cxxtrace::detail::thread_index_of_id(fake_id);
+    ASSERT_NE(index, cxxtrace::detail::unknown_thread_index);
+    fake_indexes.emplace_back(index);
+    if (index == exited_index) {
+      EXPECT_EQ(cxxtrace::detail::thread_id_of_index(index), fake_id);
+      reused = true;
+      break;
+    }
+  }
+  EXPECT_TRUE(reused);
+  EXPECT_NE(cxxtrace::detail::get_current_thread_index(), exited_index);
+
+  for (auto index : fake_indexes) {
+    cxxtrace::detail::release_thread_index(index);
+  }
+  EXPECT_EQ(
+    cxxtrace::detail::thread_index_of_id(cxxtrace::get_current_thread_id()),
+    cxxtrace::detail::get_current_thread_index());
+}
+
 #if CXXTRACE_HAVE_MACH_THREAD && CXXTRACE_HAVE_PTHREAD_THREADID_NP
 TEST(test_thread_pthread_thread_id, current_thread_id_matches_mach_thread_id)
 {
@@ -0,0 +1,156 @@
+#include "fake_cpu_time_reader.h"
+#include <chrono>
+#include <cstdint>
+#include <cxxtrace/clock.h>
+#include <cxxtrace/config.h>
+#include <cxxtrace/detail/have.h>
+#include <cxxtrace/snapshot.h>
+#include <cxxtrace/span.h>
+#include <cxxtrace/thread_cpu_time.h>
+#include <cxxtrace/unbounded_storage.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace cxxtrace_test {
+namespace {
+using fake_thread_cpu_time_clock =
+  cxxtrace::thread_cpu_time_clock<cxxtrace::fake_clock, fake_cpu_time_reader>;
+
+auto
+burn_cpu(std::chrono::nanoseconds duration) -> void;
+}
+
+TEST(test_thread_cpu_time_clock, samples_include_time_and_cpu_time)
+{
+  auto clock = fake_thread_cpu_time_clock{};
+  clock.clock().set_next_time_point(10ns);
+  clock.cpu_time_reader().next_cpu_time = 4ns;
+
+  auto sample = clock.query();
+  EXPECT_EQ(clock.make_time_point(sample), cxxtrace::time_point{ 10ns });
+  EXPECT_EQ(sample.thread_cpu_time, 4ns);
+}
+
+TEST(test_thread_cpu_time_clock, snapshot_samples_include_cpu_time)
+{
+  auto clock = fake_thread_cpu_time_clock{};
+  clock.cpu_time_reader().next_cpu_time = 100ns;
+  clock.cpu_time_reader().increment = 50ns;
+  auto storage =
+    cxxtrace::unbounded_storage<fake_thread_cpu_time_clock::sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto snapshot = storage.take_all_samples(clock);
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_EQ(snapshot.at(0).thread_cpu_time(), 100ns);
+  EXPECT_EQ(snapshot.at(1).thread_cpu_time(), 150ns);
+}
+
+TEST(test_thread_cpu_time_clock, snapshot_samples_omit_unavailable_cpu_time)
+{
+  auto clock = fake_thread_cpu_time_clock{};
+  clock.cpu_time_reader().next_cpu_time = cxxtrace::unavailable_thread_cpu_time;
+  clock.cpu_time_reader().increment = 0ns;
+  auto storage =
+    cxxtrace::unbounded_storage<fake_thread_cpu_time_clock::sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto snapshot = storage.take_all_samples(clock);
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_FALSE(snapshot.at(0).thread_cpu_time().has_value());
+  EXPECT_FALSE(snapshot.at(1).thread_cpu_time().has_value());
+}
+
+TEST(test_thread_cpu_time_clock, other_clocks_do_not_record_cpu_time)
+{
+  auto clock = cxxtrace::fake_clock{};
+  auto storage = cxxtrace::unbounded_storage<cxxtrace::fake_clock::sample>{};
+  auto config = cxxtrace::basic_config{ storage, clock };
+
+  {
+    auto span = CXXTRACE_SPAN_WITH_CONFIG(config, "category", "span");
+  }
+
+  auto snapshot = storage.take_all_samples(clock);
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_FALSE(snapshot.at(0).thread_cpu_time().has_value());
+  EXPECT_FALSE(snapshot.at(1).thread_cpu_time().has_value());
+}
+
+#if CXXTRACE_HAVE_CLOCK_GETTIME
+template<class CpuTimeReader>
+class test_thread_cpu_time_reader : public testing::Test
+{
+public:
+  using reader_type = CpuTimeReader;
+};
+
+using test_thread_cpu_time_reader_types = ::testing::Types<
+#if CXXTRACE_HAVE_LINUX_PERF_EVENT
+  cxxtrace::perf_event_task_clock_reader,
+#endif
+  cxxtrace::posix_thread_cpu_time_reader>;
+TYPED_TEST_CASE(test_thread_cpu_time_reader,
+                test_thread_cpu_time_reader_types, );
+
+TYPED_TEST(test_thread_cpu_time_reader, cpu_time_advances_while_computing)
+{
+  using reader_type = typename TestFixture::reader_type;
+
+  if (!reader_type::supported()) {
+    std::cerr << "warning: this CPU time reader is not supported. skipping "
+                 "test...\n";
+    return;
+  }
+
+  auto reader = reader_type{};
+  auto before = reader.read();
+  burn_cpu(20ms);
+  auto after = reader.read();
+  // Allow for preemption by other processes.
+  EXPECT_GE(after - before, 5ms);
+  EXPECT_LT(after - before, 1s);
+}
+
+TYPED_TEST(test_thread_cpu_time_reader,
+           cpu_time_does_not_advance_while_sleeping)
+{
+  using reader_type = typename TestFixture::reader_type;
+
+  if (!reader_type::supported()) {
+    std::cerr << "warning: this CPU time reader is not supported. skipping "
+                 "test...\n";
+    return;
+  }
+
+  auto reader = reader_type{};
+  auto before = reader.read();
+  std::this_thread::sleep_for(100ms);
+  auto after = reader.read();
+  EXPECT_LT(after - before, 50ms);
+}
+#endif
+
+namespace {
+auto
+burn_cpu(std::chrono::nanoseconds duration) -> void
+{
+  auto end = std::chrono::steady_clock::now() + duration;
+  volatile auto counter = std::uint64_t{ 0 };
+  while (std::chrono::steady_clock::now() < end) {
+    counter = counter + 1;
+  }
+}
+}
+}